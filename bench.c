@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * CPU side micro-benchmarks for the helpers kmscube uses per frame.  These
+ * don't need a display, so they can be run anywhere the code builds:
+ *
+ *   kmscube-bench matrix [iterations]
+ *   kmscube-bench yuv [frames]
+ *   kmscube-bench pattern [frames]
+ *
+ * For the GPU side of the YUV conversion, compare with the gpu time
+ * kmscube reports for -M nv12-2img (shader) and nv12-1img (driver).
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esUtil.h"
+#include "pattern.h"
+#include "threadpool.h"
+#include "yuv.h"
+
+#define NSEC_PER_SEC (INT64_C(1000) * 1000 * 1000)
+
+/* results are accumulated here so the compiler can't drop the work: */
+static volatile GLfloat sink;
+
+static int64_t get_time_ns(void)
+{
+	struct timespec tv;
+	clock_gettime(CLOCK_MONOTONIC, &tv);
+	return tv.tv_nsec + tv.tv_sec * NSEC_PER_SEC;
+}
+
+static void report(const char *name, const char *impl, unsigned count, int64_t ns)
+{
+	printf("  %-10s %-6s %12.0f/s  (%.2f ns each)\n", name, impl,
+			(double)count * NSEC_PER_SEC / ns, (double)ns / count);
+}
+
+#define NUM_VECS 1024
+
+static void bench_transform(const char *impl, unsigned iterations,
+							const ESMatrix *m)
+{
+	static GLfloat vecs[NUM_VECS * 4];
+	int64_t start;
+	unsigned i;
+
+	for (i = 0; i < NUM_VECS * 4; i++)
+		vecs[i] = (GLfloat)(i % 7) - 3.0f;
+
+	start = get_time_ns();
+	for (i = 0; i < iterations / NUM_VECS + 1; i++) {
+		esMatrixTransform(m, vecs, vecs, NUM_VECS);
+		sink += vecs[i % NUM_VECS];
+	}
+	report("transform", impl, (iterations / NUM_VECS + 1) * NUM_VECS,
+			get_time_ns() - start);
+}
+
+static int bench_matrix(unsigned iterations)
+{
+	ESMatrix a, b, r;
+	int64_t start;
+	unsigned i;
+
+	printf("matrix: %u iterations\n", iterations);
+
+	esMatrixLoadIdentity(&a);
+	esFrustum(&a, -2.8f, +2.8f, -2.1f, +2.1f, 6.0f, 10.0f);
+
+	/* the per-frame modelview build, as done by the draw functions: */
+	start = get_time_ns();
+	for (i = 0; i < iterations; i++) {
+		esMatrixLoadIdentity(&b);
+		esTranslate(&b, 0.0f, 0.0f, -8.0f);
+		esRotate(&b, 45.0f + (0.25f * i), 1.0f, 0.0f, 0.0f);
+		esRotate(&b, 45.0f - (0.5f * i), 0.0f, 1.0f, 0.0f);
+		esRotate(&b, 10.0f + (0.15f * i), 0.0f, 0.0f, 1.0f);
+		sink += b.m[0][0];
+	}
+	report("rotate", "scalar", iterations * 3, get_time_ns() - start);
+
+	start = get_time_ns();
+	for (i = 0; i < iterations; i++) {
+		esMatrixMultiply(&r, &b, &a);
+		b.m[3][0] = r.m[0][0];
+		sink += r.m[3][3];
+	}
+	report("multiply", "scalar", iterations, get_time_ns() - start);
+
+	if (esSetSimd(GL_TRUE))
+		bench_transform("simd", iterations, &r);
+	esSetSimd(GL_FALSE);
+	bench_transform("scalar", iterations, &r);
+	esSetSimd(GL_TRUE);
+
+	return 0;
+}
+
+#define YUV_WIDTH 1920
+#define YUV_HEIGHT 1080
+
+static void bench_yuv_impl(const char *impl, unsigned frames,
+						   const struct yuv_image *images, unsigned num_images,
+						   uint8_t *dst, struct threadpool *pool)
+{
+	static const char *names[] = { "nv12", "i420", "yuyv" };
+	int64_t start;
+	unsigned i, j;
+
+	for (i = 0; i < num_images; i++) {
+		start = get_time_ns();
+		for (j = 0; j < frames; j++) {
+			yuv_to_xrgb(&images[i], YUV_BT709, YUV_LIMITED, dst,
+						YUV_WIDTH * 4, pool);
+			sink += dst[j % (YUV_WIDTH * YUV_HEIGHT * 4)];
+		}
+		report(names[images[i].format], impl, frames * YUV_WIDTH * YUV_HEIGHT,
+			   get_time_ns() - start);
+	}
+}
+
+static int bench_yuv(unsigned frames)
+{
+	const unsigned size = YUV_WIDTH * YUV_HEIGHT;
+	uint8_t *src = malloc(size * 2);
+	uint8_t *dst = malloc(size * 4);
+	struct threadpool *pool = threadpool_create(0);
+	char impl[16];
+	unsigned i;
+
+	if (!src || !dst || !pool) {
+		printf("yuv: out of memory\n");
+		return -1;
+	}
+
+	for (i = 0; i < size * 2; i++)
+		src[i] = i * 2654435761u >> 24;
+
+	/* fault the destination in up front, so it isn't measured: */
+	memset(dst, 0, size * 4);
+
+	const struct yuv_image images[] = {
+		{ YUV_NV12, YUV_WIDTH, YUV_HEIGHT,
+		  { src, src + size }, { YUV_WIDTH, YUV_WIDTH } },
+		{ YUV_I420, YUV_WIDTH, YUV_HEIGHT,
+		  { src, src + size, src + size * 5 / 4 },
+		  { YUV_WIDTH, YUV_WIDTH / 2, YUV_WIDTH / 2 } },
+		{ YUV_YUYV, YUV_WIDTH, YUV_HEIGHT, { src }, { YUV_WIDTH * 2 } },
+	};
+	const unsigned num_images = sizeof(images) / sizeof(images[0]);
+
+	printf("yuv: %u %ux%u frames to XRGB8888, per pixel\n",
+		   frames, YUV_WIDTH, YUV_HEIGHT);
+
+	if (yuv_set_simd(true)) {
+		bench_yuv_impl(yuv_simd_name(), frames, images, num_images, dst,
+					   NULL);
+		snprintf(impl, sizeof(impl), "%sx%u", yuv_simd_name(),
+				 threadpool_size(pool));
+		bench_yuv_impl(impl, frames, images, num_images, dst, pool);
+	}
+	yuv_set_simd(false);
+	bench_yuv_impl("scalar", frames, images, num_images, dst, NULL);
+	yuv_set_simd(true);
+
+	threadpool_destroy(pool);
+	free(dst);
+	free(src);
+
+	return 0;
+}
+
+#define PATTERN_WIDTH 3840
+#define PATTERN_HEIGHT 2160
+
+static void bench_pattern_impl(const char *impl, unsigned frames,
+							   const struct pattern_image *images, unsigned num_images,
+							   struct threadpool *pool)
+{
+	static const char *names[] = { "rgba", "nv12", "i420", "p010" };
+	static const char *patterns[] = { "bars", "zone", "grad" };
+	char name[32];
+	int64_t start;
+	unsigned i, j, p;
+
+	for (p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+		for (i = 0; i < num_images; i++) {
+			start = get_time_ns();
+			for (j = 0; j < frames; j++) {
+				pattern_fill(p, &images[i], YUV_BT709, YUV_LIMITED, j, pool);
+				sink += images[i].planes[0][j % PATTERN_WIDTH];
+			}
+			snprintf(name, sizeof(name), "%s-%s", patterns[p],
+					 names[images[i].format]);
+			report(name, impl, frames * PATTERN_WIDTH * PATTERN_HEIGHT,
+				   get_time_ns() - start);
+		}
+	}
+}
+
+static int bench_pattern(unsigned frames)
+{
+	const unsigned size = PATTERN_WIDTH * PATTERN_HEIGHT;
+	uint8_t *dst = malloc(size * 4);
+	struct threadpool *pool = threadpool_create(0);
+	char impl[16];
+
+	if (!dst || !pool) {
+		printf("pattern: out of memory\n");
+		return -1;
+	}
+
+	/* fault the destination in up front, so it isn't measured: */
+	memset(dst, 0, size * 4);
+
+	const struct pattern_image images[] = {
+		{ FRAME_RGBA, PATTERN_WIDTH, PATTERN_HEIGHT,
+		  { dst }, { PATTERN_WIDTH * 4 } },
+		{ FRAME_NV12, PATTERN_WIDTH, PATTERN_HEIGHT,
+		  { dst, dst + size }, { PATTERN_WIDTH, PATTERN_WIDTH } },
+		{ FRAME_I420, PATTERN_WIDTH, PATTERN_HEIGHT,
+		  { dst, dst + size, dst + size * 5 / 4 },
+		  { PATTERN_WIDTH, PATTERN_WIDTH / 2, PATTERN_WIDTH / 2 } },
+		{ FRAME_P010, PATTERN_WIDTH, PATTERN_HEIGHT,
+		  { dst, dst + size * 2 }, { PATTERN_WIDTH * 2, PATTERN_WIDTH * 2 } },
+	};
+	const unsigned num_images = sizeof(images) / sizeof(images[0]);
+
+	printf("pattern: %u %ux%u frames, per pixel\n",
+		   frames, PATTERN_WIDTH, PATTERN_HEIGHT);
+
+	bench_pattern_impl("1", frames, images, num_images, NULL);
+	snprintf(impl, sizeof(impl), "x%u", threadpool_size(pool));
+	bench_pattern_impl(impl, frames, images, num_images, pool);
+
+	threadpool_destroy(pool);
+	free(dst);
+
+	return 0;
+}
+
+static const struct {
+	const char *name;
+	int (*run)(unsigned iterations);
+	unsigned iterations;
+} benches[] = {
+	{ "matrix", bench_matrix, 10000000 },
+	{ "yuv", bench_yuv, 100 },
+	{ "pattern", bench_pattern, 30 },
+};
+
+static void usage(const char *name)
+{
+	unsigned i;
+
+	printf("Usage: %s [BENCH [ITERATIONS]]\n"
+			"\n"
+			"benchmarks:\n", name);
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+		printf("    %s (default %u iterations)\n", benches[i].name,
+				benches[i].iterations);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned i, iterations = 0;
+	int ret = 0, found = 0;
+
+	if (argc > 3) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	if (argc > 2)
+		iterations = strtoul(argv[2], NULL, 0);
+
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		if (argc > 1 && strcmp(argv[1], benches[i].name))
+			continue;
+		ret |= benches[i].run(iterations ? iterations : benches[i].iterations);
+		found = 1;
+	}
+
+	if (!found) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	return ret;
+}
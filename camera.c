@@ -0,0 +1,467 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+#include <linux/videodev2.h>
+
+#include "camera.h"
+#include "trace.h"
+
+/* requested, the driver may want more: */
+#define NUM_CAMERA_BUFFERS 4
+#define MAX_CAMERA_BUFFERS 16
+
+/* drawn frames to remember the capture time of until presented: */
+#define NUM_CAMERA_HISTORY 8
+#define CAMERA_REPORT_INTERVAL 120
+
+/* formats EGL can import, in order of preference: */
+static const struct {
+	uint32_t v4l2, drm;
+	unsigned planes;
+} camera_formats[] = {
+	{ V4L2_PIX_FMT_NV12,   DRM_FORMAT_NV12,     2 },
+	{ V4L2_PIX_FMT_YUYV,   DRM_FORMAT_YUYV,     1 },
+	{ V4L2_PIX_FMT_UYVY,   DRM_FORMAT_UYVY,     1 },
+	{ V4L2_PIX_FMT_XBGR32, DRM_FORMAT_XRGB8888, 1 },
+	{ V4L2_PIX_FMT_ABGR32, DRM_FORMAT_ARGB8888, 1 },
+};
+
+bool camera_enabled;
+
+struct camera_draw {
+	unsigned frame;
+	int64_t capture_ns;      /* 0 if drawn before */
+};
+
+static struct {
+	const struct egl *egl;
+	int fd;
+	EGLImage images[MAX_CAMERA_BUFFERS];
+	unsigned num_buffers;
+
+	/* shared with the capture thread: */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool quit;
+	int latest;              /* newest buffer not drawn yet, or -1 */
+	int64_t latest_ns;       /* and when it was captured */
+	uint32_t released;       /* drawn buffers to queue again, bitmask */
+	int wake_fd;             /* eventfd, kicks the thread out of poll() */
+	unsigned captured, dropped;
+	int64_t thread_cpu_ns;
+
+	/* main thread only: */
+	int shown;               /* buffer last handed out for drawing, or -1 */
+	unsigned draws;
+	struct camera_draw history[NUM_CAMERA_HISTORY];
+
+	/* since the last report: */
+	unsigned presents;
+	int64_t draw_ns;
+	int64_t latency_ns, latency_min, latency_max;
+	unsigned latencies;
+	int64_t report_ns, report_cpu_ns;
+	unsigned report_captured, report_dropped;
+} cam;
+
+static int xioctl(int fd, unsigned long request, void *arg)
+{
+	int ret;
+
+	do {
+		ret = ioctl(fd, request, arg);
+	} while (ret == -1 && errno == EINTR);
+
+	return ret;
+}
+
+static int queue_buffer(unsigned index)
+{
+	struct v4l2_buffer buf = {
+		.type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+		.memory = V4L2_MEMORY_MMAP,
+		.index = index,
+	};
+
+	if (xioctl(cam.fd, VIDIOC_QBUF, &buf)) {
+		printf("camera: could not queue buffer: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* CLOCK_MONOTONIC, like the presentation times: */
+static int64_t capture_time(const struct v4l2_buffer *buf)
+{
+	if ((buf->flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) !=
+			V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+		return get_time_ns();
+
+	return buf->timestamp.tv_sec * NSEC_PER_SEC +
+			buf->timestamp.tv_usec * 1000;
+}
+
+/* All VIDIOC_QBUF/DQBUF happen here, so none of them land in the render
+ * thread's draw time; it only hands buffers back through cam.released.
+ */
+static void * capture_thread(void *arg)
+{
+	struct pollfd pfd[2] = {
+		{ .fd = cam.fd, .events = POLLIN },
+		{ .fd = cam.wake_fd, .events = POLLIN },
+	};
+	/* all of them start out queued: */
+	unsigned queued = cam.num_buffers;
+
+	(void)arg;
+
+	pthread_mutex_lock(&cam.lock);
+	while (!cam.quit) {
+		struct v4l2_buffer buf = {
+			.type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+			.memory = V4L2_MEMORY_MMAP,
+		};
+		uint32_t released = cam.released;
+		struct timespec cpu;
+		bool dequeued = false;
+		uint64_t wakes;
+		int ret = 0;
+
+		cam.released = 0;
+		pthread_mutex_unlock(&cam.lock);
+
+		while (released) {
+			unsigned index = __builtin_ctz(released);
+
+			if (!queue_buffer(index))
+				queued++;
+			released &= ~(1u << index);
+		}
+
+		/* with nothing queued the camera would only report an error,
+		 * wait for a buffer to be handed back instead (and time out
+		 * now and then to notice quit):
+		 */
+		pfd[0].fd = queued ? cam.fd : -1;
+		if (poll(pfd, 2, 100) > 0) {
+			if (pfd[1].revents & POLLIN &&
+					read(cam.wake_fd, &wakes, sizeof(wakes)) < 0)
+				printf("camera: could not read wakeup: %s\n", strerror(errno));
+			if (pfd[0].revents) {
+				trace_begin("camera dequeue");
+				ret = xioctl(cam.fd, VIDIOC_DQBUF, &buf);
+				trace_end("camera dequeue");
+				dequeued = !ret;
+				if (dequeued)
+					queued--;
+			}
+		}
+		if (ret < 0 && errno != EINTR && errno != EAGAIN) {
+			printf("camera: could not dequeue buffer: %s\n", strerror(errno));
+			pthread_mutex_lock(&cam.lock);
+			break;
+		}
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+
+		pthread_mutex_lock(&cam.lock);
+		cam.thread_cpu_ns = cpu.tv_sec * NSEC_PER_SEC + cpu.tv_nsec;
+		if (!dequeued)
+			continue;
+
+		/* replaced before it was drawn: */
+		if (cam.latest >= 0) {
+			cam.released |= 1u << cam.latest;
+			cam.dropped++;
+		}
+		cam.latest = buf.index;
+		cam.latest_ns = capture_time(&buf);
+		cam.captured++;
+		pthread_cond_signal(&cam.cond);
+	}
+	pthread_mutex_unlock(&cam.lock);
+
+	return NULL;
+}
+
+int init_camera(const struct egl *egl, const char *device)
+{
+	struct v4l2_capability cap = {0};
+	struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+	struct v4l2_requestbuffers req = {
+		.count = NUM_CAMERA_BUFFERS,
+		.type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+		.memory = V4L2_MEMORY_MMAP,
+	};
+	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	uint32_t width, height, pitch, caps;
+	unsigned i, f, n = sizeof(camera_formats) / sizeof(camera_formats[0]);
+	int ret;
+
+	if (egl_check(egl, eglCreateImageKHR) ||
+	    egl_check(egl, eglDestroyImageKHR))
+		return -1;
+
+	cam.egl = egl;
+	cam.fd = open(device, O_RDWR | O_CLOEXEC);
+	if (cam.fd < 0) {
+		printf("could not open %s: %s\n", device, strerror(errno));
+		return -1;
+	}
+
+	if (xioctl(cam.fd, VIDIOC_QUERYCAP, &cap)) {
+		printf("%s is not a V4L2 device\n", device);
+		return -1;
+	}
+
+	caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ?
+			cap.device_caps : cap.capabilities;
+	if (!(caps & V4L2_CAP_VIDEO_CAPTURE) || !(caps & V4L2_CAP_STREAMING)) {
+		printf("%s is not a (single-planar) streaming capture device\n", device);
+		return -1;
+	}
+
+	if (xioctl(cam.fd, VIDIOC_G_FMT, &fmt)) {
+		printf("could not get camera format: %s\n", strerror(errno));
+		return -1;
+	}
+
+	/* keep the current size, the driver may substitute another format: */
+	for (f = 0; f < n; f++) {
+		fmt.fmt.pix.pixelformat = camera_formats[f].v4l2;
+		fmt.fmt.pix.field = V4L2_FIELD_NONE;
+		if (!xioctl(cam.fd, VIDIOC_S_FMT, &fmt) &&
+				fmt.fmt.pix.pixelformat == camera_formats[f].v4l2)
+			break;
+	}
+	if (f == n) {
+		printf("%s has no pixel format EGL can import\n", device);
+		return -1;
+	}
+
+	width = fmt.fmt.pix.width;
+	height = fmt.fmt.pix.height;
+	pitch = fmt.fmt.pix.bytesperline;
+
+	if (xioctl(cam.fd, VIDIOC_REQBUFS, &req) || req.count < 2 ||
+			req.count > MAX_CAMERA_BUFFERS) {
+		printf("could not allocate camera buffers: %s\n", strerror(errno));
+		return -1;
+	}
+	cam.num_buffers = req.count;
+
+	for (i = 0; i < cam.num_buffers; i++) {
+		struct v4l2_exportbuffer exp = {
+			.type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+			.index = i,
+			.flags = O_RDONLY | O_CLOEXEC,
+		};
+		/* NV12 chroma follows the luma in the same buffer: */
+		const uint32_t offsets[2] = { 0, pitch * height };
+		const uint32_t pitches[2] = { pitch, pitch };
+		int fds[2];
+
+		if (xioctl(cam.fd, VIDIOC_EXPBUF, &exp)) {
+			printf("could not export camera buffer: %s\n", strerror(errno));
+			return -1;
+		}
+
+		fds[0] = fds[1] = exp.fd;
+		cam.images[i] = create_dmabuf_image(egl, width, height,
+				camera_formats[f].drm, camera_formats[f].planes,
+				fds, offsets, pitches);
+		close(exp.fd);
+		if (cam.images[i] == EGL_NO_IMAGE_KHR) {
+			printf("could not import camera buffer\n");
+			return -1;
+		}
+
+		if (queue_buffer(i))
+			return -1;
+	}
+
+	if (xioctl(cam.fd, VIDIOC_STREAMON, &type)) {
+		printf("could not start camera: %s\n", strerror(errno));
+		return -1;
+	}
+
+	cam.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (cam.wake_fd < 0) {
+		printf("could not create camera eventfd: %s\n", strerror(errno));
+		return -1;
+	}
+
+	cam.latest = cam.shown = -1;
+	cam.report_ns = get_time_ns();
+	pthread_mutex_init(&cam.lock, NULL);
+	pthread_cond_init(&cam.cond, NULL);
+
+	ret = pthread_create(&cam.thread, NULL, capture_thread, NULL);
+	if (ret) {
+		printf("could not start capture thread: %s\n", strerror(ret));
+		return -1;
+	}
+
+	printf("Using camera %s (%s): %ux%u %.4s, %u buffers\n", device,
+			(const char *)cap.card, width, height,
+			(const char *)&camera_formats[f].v4l2, cam.num_buffers);
+
+	camera_enabled = true;
+
+	return 0;
+}
+
+EGLImage camera_frame(void)
+{
+	int64_t start = get_time_ns();
+	unsigned i = cam.draws++;
+	int64_t capture_ns = 0;
+	bool wake = false;
+
+	pthread_mutex_lock(&cam.lock);
+	if (cam.shown < 0 && cam.latest < 0) {
+		struct timespec timeout;
+
+		clock_gettime(CLOCK_REALTIME, &timeout);
+		timeout.tv_sec += 2;
+		while (cam.latest < 0) {
+			if (pthread_cond_timedwait(&cam.cond, &cam.lock, &timeout)) {
+				printf("camera: no frame after 2s\n");
+				break;
+			}
+		}
+	}
+	if (cam.latest >= 0) {
+		/* the previous draw has finished, the GPU is done with the
+		 * buffer it sampled, hand it back to be queued:
+		 */
+		if (cam.shown >= 0) {
+			cam.released |= 1u << cam.shown;
+			wake = true;
+		}
+		cam.shown = cam.latest;
+		capture_ns = cam.latest_ns;
+		cam.latest = -1;
+	}
+	pthread_mutex_unlock(&cam.lock);
+
+	if (wake && write(cam.wake_fd, &(uint64_t){1}, sizeof(uint64_t)) < 0)
+		printf("camera: could not wake capture thread: %s\n", strerror(errno));
+
+	cam.history[i % NUM_CAMERA_HISTORY].frame = i;
+	cam.history[i % NUM_CAMERA_HISTORY].capture_ns = capture_ns;
+	cam.draw_ns += get_time_ns() - start;
+
+	return cam.shown >= 0 ? cam.images[cam.shown] : EGL_NO_IMAGE_KHR;
+}
+
+static void camera_report(void)
+{
+	int64_t now = get_time_ns();
+	unsigned captured, dropped;
+	int64_t cpu_ns;
+
+	pthread_mutex_lock(&cam.lock);
+	captured = cam.captured - cam.report_captured;
+	dropped = cam.dropped - cam.report_dropped;
+	cpu_ns = cam.thread_cpu_ns - cam.report_cpu_ns;
+	cam.report_captured = cam.captured;
+	cam.report_dropped = cam.dropped;
+	cam.report_cpu_ns = cam.thread_cpu_ns;
+	pthread_mutex_unlock(&cam.lock);
+
+	printf("camera: %u captured, %u dropped", captured, dropped);
+	if (cam.latencies) {
+		printf(", capture to scanout %.2f ms (%.2f - %.2f)",
+				(double)cam.latency_ns / cam.latencies / 1000000.0,
+				(double)cam.latency_min / 1000000.0,
+				(double)cam.latency_max / 1000000.0);
+	}
+	printf(", cpu %.3f ms per frame + %.1f%% capture thread\n",
+			(double)cam.draw_ns / cam.presents / 1000000.0,
+			(double)cpu_ns * 100.0 / (now - cam.report_ns));
+
+	cam.report_ns = now;
+	cam.presents = 0;
+	cam.draw_ns = 0;
+	cam.latency_ns = 0;
+	cam.latencies = 0;
+}
+
+void camera_presented(unsigned i, int64_t ns)
+{
+	struct camera_draw *h = &cam.history[i % NUM_CAMERA_HISTORY];
+
+	/* only the first time a captured frame reaches the screen: */
+	if (h->frame == i && h->capture_ns) {
+		int64_t latency = ns - h->capture_ns;
+
+		if (!cam.latencies || latency < cam.latency_min)
+			cam.latency_min = latency;
+		if (!cam.latencies || latency > cam.latency_max)
+			cam.latency_max = latency;
+		cam.latency_ns += latency;
+		cam.latencies++;
+		h->capture_ns = 0;
+	}
+
+	if (++cam.presents == CAMERA_REPORT_INTERVAL)
+		camera_report();
+}
+
+void finish_camera(void)
+{
+	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	unsigned i;
+
+	if (!camera_enabled)
+		return;
+
+	pthread_mutex_lock(&cam.lock);
+	cam.quit = true;
+	pthread_mutex_unlock(&cam.lock);
+	pthread_join(cam.thread, NULL);
+
+	xioctl(cam.fd, VIDIOC_STREAMOFF, &type);
+	for (i = 0; i < cam.num_buffers; i++)
+		cam.egl->eglDestroyImageKHR(cam.egl->display, cam.images[i]);
+	close(cam.fd);
+	close(cam.wake_fd);
+
+	camera_enabled = false;
+}
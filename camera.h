@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _CAMERA_H
+#define _CAMERA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/* Live V4L2 capture for the video cube, without GStreamer: the device's
+ * buffers are exported with VIDIOC_EXPBUF and each is imported once as
+ * an EGLImage.  A capture thread dequeues filled buffers and requeues
+ * the ones the GPU is done with; the newest frame is always the one
+ * drawn, older ones not yet drawn are dropped.
+ *
+ * Capture to scanout latency (from the driver's buffer timestamp) and
+ * CPU cost are reported every 120 frames.  The vivid virtual driver
+ * works for testing.
+ */
+
+/* set once init_camera() succeeds: */
+extern bool camera_enabled;
+
+int init_camera(const struct egl *egl, const char *device);
+
+/* The newest captured frame, once the GPU is done with the previous
+ * frame's draw.  Waits for the first frame.
+ */
+EGLImage camera_frame(void);
+
+/* frame i reached the screen at ns: */
+void camera_presented(unsigned i, int64_t ns);
+
+void finish_camera(void);
+
+#endif /* _CAMERA_H */
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES3/gl3.h>
+
+#include "capture.h"
+#include "trace.h"
+
+/* Enough for a readback to complete while the next frames render, and
+ * for the writer to fall a little behind without holding up rendering:
+ */
+#define NUM_CAPTURE_SLOTS 3
+
+#define FNV1A_INIT  UINT64_C(0xcbf29ce484222325)
+#define FNV1A_PRIME UINT64_C(0x100000001b3)
+
+enum slot_state {
+	SLOT_FREE,
+	SLOT_PENDING,        /* readback issued, fence not signaled yet */
+	SLOT_QUEUED,         /* pixels available, waiting for the writer */
+	SLOT_DONE,           /* writer is finished with the pixels */
+};
+
+struct capture_slot {
+	enum slot_state state;
+	unsigned frame;
+	GLuint pbo;
+	GLsync fence;
+	GLubyte *pixels;     /* mapped PBO, or malloc'd without PBOs */
+};
+
+bool capture_enabled;
+
+static struct {
+	unsigned interval;
+	const char *dir;
+	int width, height;
+	bool pbo;
+
+	struct capture_slot slots[NUM_CAPTURE_SLOTS];
+	unsigned next;       /* slot the next readback goes into */
+	unsigned retire;     /* oldest pending slot */
+	unsigned pending;    /* readbacks in flight, from 'retire' on */
+	unsigned work;       /* next slot for the writer */
+
+	/* slot state is shared with the writer once queued: */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool quit;
+
+	/* writer only: */
+	uint64_t hash;       /* of all the frame hashes, in order */
+
+	/* stats, for finish_capture(): */
+	unsigned frames, stalls;
+	int64_t readback_ns;
+} cap;
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= FNV1A_PRIME;
+	}
+
+	return hash;
+}
+
+uint64_t write_frame(const char *path, const uint8_t *pixels,
+					 int width, int height, int stride, const int rgb[3])
+{
+	uint64_t hash = FNV1A_INIT;
+	uint8_t *row;
+	FILE *f = NULL;
+	int x, y;
+
+	row = malloc(width * 3);
+	if (!row)
+		return 0;
+
+	if (path) {
+		f = fopen(path, "wb");
+		if (!f)
+			printf("could not open %s: %s\n", path, strerror(errno));
+		else
+			fprintf(f, "P6\n%d %d\n255\n", width, height);
+	}
+
+	for (y = 0; y < height; y++, pixels += stride) {
+		for (x = 0; x < width; x++) {
+			row[x * 3 + 0] = pixels[x * 4 + rgb[0]];
+			row[x * 3 + 1] = pixels[x * 4 + rgb[1]];
+			row[x * 3 + 2] = pixels[x * 4 + rgb[2]];
+		}
+
+		hash = fnv1a(hash, row, width * 3);
+		if (f)
+			fwrite(row, 3, width, f);
+	}
+
+	if (f)
+		fclose(f);
+	free(row);
+
+	return hash;
+}
+
+/* GL reads back bottom-up RGBA: */
+static void capture_write(const struct capture_slot *slot)
+{
+	static const int rgb[3] = { 0, 1, 2 };
+	const int stride = cap.width * 4;
+	char path[PATH_MAX];
+	uint64_t hash;
+
+	if (cap.dir)
+		snprintf(path, sizeof(path), "%s/frame-%06u.ppm", cap.dir, slot->frame);
+
+	hash = write_frame(cap.dir ? path : NULL,
+					   slot->pixels + (size_t)(cap.height - 1) * stride,
+					   cap.width, cap.height, -stride, rgb);
+
+	printf("capture: frame %u hash %016" PRIx64 "\n", slot->frame, hash);
+	cap.hash = fnv1a(cap.hash, &hash, sizeof(hash));
+}
+
+static void *writer(void *arg)
+{
+	(void)arg;
+
+	trace_thread_name("capture");
+
+	pthread_mutex_lock(&cap.lock);
+	for (;;) {
+		struct capture_slot *slot = &cap.slots[cap.work];
+
+		if (slot->state == SLOT_QUEUED) {
+			pthread_mutex_unlock(&cap.lock);
+
+			trace_begin("write frame");
+			capture_write(slot);
+			trace_end("write frame");
+
+			pthread_mutex_lock(&cap.lock);
+			slot->state = SLOT_DONE;
+			cap.work = (cap.work + 1) % NUM_CAPTURE_SLOTS;
+			pthread_cond_broadcast(&cap.cond);
+			continue;
+		}
+
+		/* queued frames are still written after quit: */
+		if (cap.quit)
+			break;
+
+		pthread_cond_wait(&cap.cond, &cap.lock);
+	}
+	pthread_mutex_unlock(&cap.lock);
+
+	return NULL;
+}
+
+static void queue_slot(struct capture_slot *slot)
+{
+	if (cap.pbo) {
+		glDeleteSync(slot->fence);
+		slot->fence = NULL;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+		slot->pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+				(GLsizeiptr)cap.width * cap.height * 4, GL_MAP_READ_BIT);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	pthread_mutex_lock(&cap.lock);
+	slot->state = SLOT_QUEUED;
+	pthread_cond_broadcast(&cap.cond);
+	pthread_mutex_unlock(&cap.lock);
+}
+
+/* Hand completed readbacks to the writer, oldest first.  Only the oldest
+ * is waited for, and only if wait is set:
+ */
+static void retire_readbacks(bool wait)
+{
+	while (cap.pending) {
+		struct capture_slot *slot = &cap.slots[cap.retire];
+		GLenum status;
+
+		status = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+								  wait ? NSEC_PER_SEC : 0);
+		if (status == GL_TIMEOUT_EXPIRED) {
+			if (wait)
+				continue;
+			break;
+		}
+
+		queue_slot(slot);
+		cap.retire = (cap.retire + 1) % NUM_CAPTURE_SLOTS;
+		cap.pending--;
+		wait = false;
+	}
+}
+
+/* Get the slot the next readback goes into back.  This only blocks if
+ * the writer has fallen NUM_CAPTURE_SLOTS captures behind:
+ */
+static void reclaim_slot(struct capture_slot *slot)
+{
+	if (cap.pending && slot == &cap.slots[cap.retire])
+		retire_readbacks(true);
+
+	pthread_mutex_lock(&cap.lock);
+	if (slot->state == SLOT_QUEUED)
+		cap.stalls++;
+	while (slot->state == SLOT_QUEUED)
+		pthread_cond_wait(&cap.cond, &cap.lock);
+	pthread_mutex_unlock(&cap.lock);
+
+	if (slot->state == SLOT_DONE && cap.pbo) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot->pixels = NULL;
+	}
+
+	slot->state = SLOT_FREE;
+}
+
+void capture_frame(unsigned i)
+{
+	struct capture_slot *slot;
+	int64_t start;
+
+	if (cap.pbo)
+		retire_readbacks(false);
+
+	if (i % cap.interval)
+		return;
+
+	trace_begin("capture");
+	start = get_time_ns();
+
+	slot = &cap.slots[cap.next];
+	reclaim_slot(slot);
+	slot->frame = i;
+
+	if (cap.pbo) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+		glReadPixels(0, 0, cap.width, cap.height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot->state = SLOT_PENDING;
+		cap.pending++;
+	} else {
+		glReadPixels(0, 0, cap.width, cap.height, GL_RGBA, GL_UNSIGNED_BYTE,
+					 slot->pixels);
+		queue_slot(slot);
+	}
+
+	cap.next = (cap.next + 1) % NUM_CAPTURE_SLOTS;
+	cap.frames++;
+	cap.readback_ns += get_time_ns() - start;
+	trace_end("capture");
+}
+
+int init_capture(const struct egl *egl, int width, int height,
+				 unsigned interval, const char *dir)
+{
+	size_t size = (size_t)width * height * 4;
+	unsigned i;
+
+	cap.interval = interval ? interval : 1;
+	cap.dir = dir;
+	cap.width = width;
+	cap.height = height;
+	cap.pbo = egl->es3;
+	cap.hash = FNV1A_INIT;
+
+	if (!cap.pbo) {
+		printf("WARNING: no OpenGL ES 3.x context, capture readback is synchronous\n"
+			   "WARNING: and stalls every captured frame, timings are distorted\n");
+	}
+
+	for (i = 0; i < NUM_CAPTURE_SLOTS; i++) {
+		struct capture_slot *slot = &cap.slots[i];
+
+		if (cap.pbo) {
+			glGenBuffers(1, &slot->pbo);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+		} else {
+			slot->pixels = malloc(size);
+			if (!slot->pixels)
+				return -1;
+		}
+	}
+	if (cap.pbo)
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	pthread_mutex_init(&cap.lock, NULL);
+	pthread_cond_init(&cap.cond, NULL);
+	if (pthread_create(&cap.thread, NULL, writer, NULL)) {
+		printf("could not create capture thread\n");
+		return -1;
+	}
+
+	printf("capturing every %u frame(s)%s%s, %s readback\n", cap.interval,
+		   dir ? " to " : "", dir ? dir : "",
+		   cap.pbo ? "asynchronous PBO" : "synchronous");
+
+	capture_enabled = true;
+
+	return 0;
+}
+
+void finish_capture(void)
+{
+	unsigned i;
+
+	if (!capture_enabled)
+		return;
+
+	while (cap.pending)
+		retire_readbacks(true);
+
+	pthread_mutex_lock(&cap.lock);
+	cap.quit = true;
+	pthread_cond_broadcast(&cap.cond);
+	pthread_mutex_unlock(&cap.lock);
+	pthread_join(cap.thread, NULL);
+
+	for (i = 0; i < NUM_CAPTURE_SLOTS; i++)
+		reclaim_slot(&cap.slots[i]);
+
+	printf("capture: %u frames, %.3f ms readback per capture, "
+		   "%u stalls waiting for the writer, combined hash %016" PRIx64 "\n",
+		   cap.frames, cap.frames ?
+				(double)cap.readback_ns / cap.frames / 1000000.0 : 0.0,
+		   cap.stalls, cap.hash);
+
+	capture_enabled = false;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/* Frame capture for regression testing: every Nth frame is read back and
+ * handed to a background thread, which hashes it and optionally writes it
+ * out as a PPM file.
+ *
+ * With ES3 the readback goes through a ring of pixel buffer objects and
+ * is only mapped once its fence has signaled, a few frames later, so it
+ * doesn't stall the pipeline.  ES2 falls back to a synchronous
+ * glReadPixels().
+ */
+
+/* set once init_capture() succeeds: */
+extern bool capture_enabled;
+
+/* dir may be NULL to only print hashes */
+int init_capture(const struct egl *egl, int width, int height,
+				 unsigned interval, const char *dir);
+
+/* called after the scene is drawn, before anything is overlaid: */
+void capture_frame(unsigned i);
+
+/* wait for outstanding captures and print a summary: */
+void finish_capture(void);
+
+/* Hash a frame of 4 byte pixels with red, green and blue at the byte
+ * offsets in rgb[], and write it to path as a PPM unless path is NULL.
+ * Rows are stride bytes apart, negative for bottom-up.  The hash is
+ * FNV-1a of the PPM's pixel data.
+ */
+uint64_t write_frame(const char *path, const uint8_t *pixels,
+					 int width, int height, int stride, const int rgb[3]);
+
+#endif /* _CAPTURE_H */
@@ -22,16 +22,28 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#define _GNU_SOURCE
+
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <xf86drm.h>
 
+#include "camera.h"
+#include "capture.h"
 #include "common.h"
+#include "hud.h"
 #include "surface-manager.h"
+#include "trace.h"
 
 static bool has_ext(const char *extension_list, const char *ext)
 {
@@ -53,11 +65,126 @@ static bool has_ext(const char *extension_list, const char *ext)
 	}
 }
 
+bool gl_has_extension(const char *ext)
+{
+	return has_ext((const char *)glGetString(GL_EXTENSIONS), ext);
+}
+
+int verbose;
+int gles_version = 2;
+bool egl_no_config_context;
+
+static void init_program_cache(const struct egl *egl);
+static int init_egl_internal(struct egl *egl, const struct surfmgr *surfmgr);
+
+/* Does the DRM device node at path belong to the same device as fd? */
+static bool same_drm_device(drmDevicePtr dev, const char *path)
+{
+	drmDevicePtr other;
+	bool ret;
+	int fd;
+
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		return false;
+
+	ret = drmGetDevice(fd, &other) == 0;
+	close(fd);
+
+	if (!ret)
+		return false;
+
+	ret = drmDevicesEqual(dev, other);
+	drmFreeDevice(&other);
+
+	return ret;
+}
+
+/*
+ * Find the EGLDevice driving the DRM device we allocate surfaces on, by
+ * matching its primary or render node against the surface manager fd.
+ * Rendering on any other device would silently push every frame across
+ * the bus.
+ */
+static EGLDeviceEXT find_egl_device(struct egl *egl, int fd)
+{
+	static const EGLint node_attribs[] = {
+		EGL_DRM_DEVICE_FILE_EXT,
+		EGL_DRM_RENDER_NODE_FILE_EXT,
+	};
+	static const char *node_exts[] = {
+		"EGL_EXT_device_drm",
+		"EGL_EXT_device_drm_render_node",
+	};
+	EGLDeviceEXT *devices, device = EGL_NO_DEVICE_EXT;
+	EGLint num_devices = 0, i;
+	drmDevicePtr drm_dev;
+	unsigned j;
+
+	if (drmGetDevice(fd, &drm_dev)) {
+		printf("could not query DRM device: %s\n", strerror(errno));
+		return EGL_NO_DEVICE_EXT;
+	}
+
+	if (!egl->eglQueryDevicesEXT(0, NULL, &num_devices) || num_devices < 1) {
+		printf("No EGL devices present\n");
+		goto out;
+	}
+
+	devices = calloc(num_devices, sizeof(*devices));
+	if (!devices) {
+		printf("could not allocate %d EGL devices\n", num_devices);
+		goto out;
+	}
+	egl->eglQueryDevicesEXT(num_devices, devices, &num_devices);
+
+	for (i = 0; i < num_devices && device == EGL_NO_DEVICE_EXT; i++) {
+		const char *dev_exts =
+			egl->eglQueryDeviceStringEXT(devices[i], EGL_EXTENSIONS);
+
+		for (j = 0; j < ARRAY_SIZE(node_attribs); j++) {
+			const char *node;
+
+			if (!has_ext(dev_exts, node_exts[j]))
+				continue;
+
+			node = egl->eglQueryDeviceStringEXT(devices[i], node_attribs[j]);
+			if (node && same_drm_device(drm_dev, node)) {
+				printf("Using EGL device %d of %d (%s)\n",
+						i, num_devices, node);
+				device = devices[i];
+				break;
+			}
+		}
+	}
+
+	free(devices);
+
+	if (device == EGL_NO_DEVICE_EXT)
+		printf("No EGL device matches the requested DRM device\n");
+
+out:
+	drmFreeDevice(&drm_dev);
+	return device;
+}
+
 int init_egl(struct egl *egl, const struct surfmgr *surfmgr)
+{
+	int ret;
+
+	startup_begin(STARTUP_EGL);
+	ret = init_egl_internal(egl, surfmgr);
+	startup_end(STARTUP_EGL);
+
+	return ret;
+}
+
+static int init_egl_internal(struct egl *egl, const struct surfmgr *surfmgr)
 {
 	EGLint major, minor, n;
+	EGLConfig ctx_config;
 
-	static const EGLint context_attribs[] = {
+	EGLint context_attribs[] = {
 		EGL_CONTEXT_CLIENT_VERSION, 2,
 		EGL_NONE
 	};
@@ -106,6 +233,9 @@ int init_egl(struct egl *egl, const struct surfmgr *surfmgr)
 	get_proc_client(EGL_EXT_device_base, eglQueryDevicesEXT);
 	if (!egl->eglQueryDevicesEXT)
 		get_proc_client(EGL_EXT_device_enumeration, eglQueryDevicesEXT);
+	get_proc_client(EGL_EXT_device_base, eglQueryDeviceStringEXT);
+	if (!egl->eglQueryDeviceStringEXT)
+		get_proc_client(EGL_EXT_device_query, eglQueryDeviceStringEXT);
 
 	if (surfmgr->gbm) {
 		if (egl->eglGetPlatformDisplayEXT) {
@@ -117,26 +247,16 @@ int init_egl(struct egl *egl, const struct surfmgr *surfmgr)
 		}
 	} else {
 		EGLDeviceEXT device;
-		EGLint num_devices;
 
-		if (!egl->eglQueryDevicesEXT || !egl->eglGetPlatformDisplayEXT) {
+		if (!egl->eglQueryDevicesEXT || !egl->eglQueryDeviceStringEXT ||
+			!egl->eglGetPlatformDisplayEXT) {
 			printf("EGLDevice or EGL platforms not supported\n");
 			return -1;
 		}
 
-		/*
-		 * TODO: This should correlate the EGLDevices with the device
-		 * requested by the user some how, such as with the
-		 * EGL_DRM_DEVICE_FILE_EXT query from EGL_EXT_device_drm or a new UUID-
-		 * based mechanism similar to that used by GL_EXT_memory_objects.
-		 * Right now, the first available EGLDevice is used for simplicity.
-		 */
-		egl->eglQueryDevicesEXT(1, &device, &num_devices);
-
-		if (num_devices < 1) {
-			printf("No EGL devices present\n");
+		device = find_egl_device(egl, surfmgr->fd);
+		if (device == EGL_NO_DEVICE_EXT)
 			return -1;
-		}
 
 		egl->display = egl->eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT,
 													 device, NULL);
@@ -163,8 +283,10 @@ int init_egl(struct egl *egl, const struct surfmgr *surfmgr)
 	printf("EGL information:\n");
 	printf("  version: \"%s\"\n", eglQueryString(egl->display, EGL_VERSION));
 	printf("  vendor: \"%s\"\n", eglQueryString(egl->display, EGL_VENDOR));
-	printf("  client extensions: \"%s\"\n", egl_exts_client);
-	printf("  display extensions: \"%s\"\n", egl_exts_dpy);
+	if (verbose) {
+		printf("  client extensions: \"%s\"\n", egl_exts_client);
+		printf("  display extensions: \"%s\"\n", egl_exts_dpy);
+	}
 	printf("===================================\n");
 
 	if (!eglBindAPI(EGL_OPENGL_ES_API)) {
@@ -177,8 +299,34 @@ int init_egl(struct egl *egl, const struct surfmgr *surfmgr)
 		return -1;
 	}
 
-	egl->context = eglCreateContext(egl->display, egl->config,
-			EGL_NO_CONTEXT, context_attribs);
+	if (egl_no_config_context) {
+		egl->no_config = has_ext(egl_exts_dpy, "EGL_KHR_no_config_context");
+		if (!egl->no_config)
+			printf("no EGL_KHR_no_config_context, the context only fits its config\n");
+	}
+	ctx_config = egl->no_config ? EGL_NO_CONFIG_KHR : egl->config;
+
+	egl->context = EGL_NO_CONTEXT;
+	if (gles_version >= 3) {
+		EGLint renderable = 0;
+
+		eglGetConfigAttrib(egl->display, egl->config,
+						   EGL_RENDERABLE_TYPE, &renderable);
+		if (renderable & EGL_OPENGL_ES3_BIT_KHR) {
+			context_attribs[1] = 3;
+			egl->context = eglCreateContext(egl->display, ctx_config,
+					EGL_NO_CONTEXT, context_attribs);
+		}
+
+		if (egl->context == EGL_NO_CONTEXT) {
+			printf("no OpenGL ES 3.x context, falling back to 2.0\n");
+			context_attribs[1] = 2;
+		}
+	}
+
+	if (egl->context == EGL_NO_CONTEXT)
+		egl->context = eglCreateContext(egl->display, ctx_config,
+				EGL_NO_CONTEXT, context_attribs);
 	if (egl->context == NULL) {
 		printf("failed to create context\n");
 		return -1;
@@ -199,20 +347,38 @@ int init_egl(struct egl *egl, const struct surfmgr *surfmgr)
 	eglMakeCurrent(egl->display, egl->surface, egl->surface, egl->context);
 
 	gl_exts = (char *) glGetString(GL_EXTENSIONS);
+	if (sscanf((const char *)glGetString(GL_VERSION), "OpenGL ES %d.%d",
+			   &egl->gl_major, &egl->gl_minor) != 2) {
+		egl->gl_major = 2;
+		egl->gl_minor = 0;
+	}
+	egl->es3 = context_attribs[1] >= 3 && egl->gl_major >= 3;
+
 	printf("OpenGL ES 2.x information:\n");
 	printf("  version: \"%s\"\n", glGetString(GL_VERSION));
 	printf("  shading language version: \"%s\"\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
 	printf("  vendor: \"%s\"\n", glGetString(GL_VENDOR));
 	printf("  renderer: \"%s\"\n", glGetString(GL_RENDERER));
-	printf("  extensions: \"%s\"\n", gl_exts);
+	if (verbose)
+		printf("  extensions: \"%s\"\n", gl_exts);
 	printf("===================================\n");
 
 	get_proc_gl(GL_OES_EGL_image, glEGLImageTargetTexture2DOES);
+	get_proc_gl(GL_OES_EGL_image, glEGLImageTargetRenderbufferStorageOES);
 	get_proc_gl(GL_EXT_memory_object, glCreateMemoryObjectsEXT);
 	get_proc_gl(GL_EXT_memory_object, glMemoryObjectParameterivEXT);
 	get_proc_gl(GL_EXT_memory_object, glTexStorageMem2DEXT);
 	get_proc_gl(GL_EXT_memory_object_fd, glImportMemoryFdEXT);
 	get_proc_gl(GL_NVX_unix_allocator_import, glTexParametervNVX);
+	get_proc_gl(GL_OES_get_program_binary, glGetProgramBinaryOES);
+	get_proc_gl(GL_OES_get_program_binary, glProgramBinaryOES);
+	get_proc_gl(GL_EXT_disjoint_timer_query, glGenQueriesEXT);
+	get_proc_gl(GL_EXT_disjoint_timer_query, glBeginQueryEXT);
+	get_proc_gl(GL_EXT_disjoint_timer_query, glEndQueryEXT);
+	get_proc_gl(GL_EXT_disjoint_timer_query, glGetQueryObjectuivEXT);
+	get_proc_gl(GL_EXT_disjoint_timer_query, glGetQueryObjectui64vEXT);
+
+	init_program_cache(egl);
 
 	if (init_surfmgr_egl(surfmgr, egl)) {
         printf("Failed to initialize surface manager EGL and GL state\n");
@@ -222,11 +388,266 @@ int init_egl(struct egl *egl, const struct surfmgr *surfmgr)
 	return 0;
 }
 
-int create_program(const char *vs_src, const char *fs_src)
+/*
+ * Persistent program binary cache (GL_OES_get_program_binary).
+ *
+ * Programs are keyed by a hash of their shader sources, attribute
+ * locations and the driver (GL_RENDERER/GL_VERSION) and stored in
+ * $XDG_CACHE_HOME/kmscube.  On a
+ * hit create_program() returns an already linked program and
+ * link_program() becomes a no-op.  If the driver rejects a stale binary
+ * we fall back to compiling from source and refresh the cache entry.
+ */
+
+#define PROGRAM_CACHE_MAGIC 0x6b6d7362 /* 'kmsb' */
+#define MAX_CACHED_PROGRAMS 16
+
+struct program_cache_header {
+	uint32_t magic;
+	uint32_t format;
+	uint32_t length;
+};
+
+static struct {
+	PFNGLGETPROGRAMBINARYOESPROC glGetProgramBinaryOES;
+	PFNGLPROGRAMBINARYOESPROC glProgramBinaryOES;
+	char dir[256];
+	uint64_t driver_hash;
+
+	/* programs created by create_program() since last link_program(): */
+	struct {
+		GLuint program;
+		uint64_t key;
+		int loaded;
+	} programs[MAX_CACHED_PROGRAMS];
+	unsigned count;
+} cache;
+
+static uint64_t fnv1a(uint64_t hash, const char *str)
+{
+	while (str && *str) {
+		hash ^= (unsigned char)*str++;
+		hash *= 0x100000001b3ull;
+	}
+	/* separator, so that "ab"+"c" != "a"+"bc": */
+	hash ^= 0xff;
+	hash *= 0x100000001b3ull;
+	return hash;
+}
+
+static void init_program_cache(const struct egl *egl)
+{
+	const char *base = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	GLint formats = 0;
+
+	memset(&cache, 0, sizeof(cache));
+
+	if (!egl->glGetProgramBinaryOES || !egl->glProgramBinaryOES)
+		return;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+	if (formats < 1)
+		return;
+
+	if (base && base[0])
+		snprintf(cache.dir, sizeof(cache.dir), "%s/kmscube", base);
+	else if (home && home[0])
+		snprintf(cache.dir, sizeof(cache.dir), "%s/.cache/kmscube", home);
+	else
+		return;
+
+	/* create the directory (and $HOME/.cache) if needed: */
+	if (!base || !base[0]) {
+		char parent[256];
+		snprintf(parent, sizeof(parent), "%s/.cache", home);
+		mkdir(parent, 0700);
+	}
+	if (mkdir(cache.dir, 0700) && errno != EEXIST) {
+		cache.dir[0] = '\0';
+		return;
+	}
+
+	cache.driver_hash = fnv1a(0xcbf29ce484222325ull,
+			(const char *)glGetString(GL_RENDERER));
+	cache.driver_hash = fnv1a(cache.driver_hash,
+			(const char *)glGetString(GL_VERSION));
+
+	cache.glGetProgramBinaryOES = egl->glGetProgramBinaryOES;
+	cache.glProgramBinaryOES = egl->glProgramBinaryOES;
+}
+
+static void program_cache_path(char *path, size_t size, uint64_t key)
+{
+	snprintf(path, size, "%s/%016llx.bin", cache.dir,
+			 (unsigned long long)key);
+}
+
+static GLuint program_cache_load(uint64_t key)
+{
+	struct program_cache_header hdr;
+	char path[300];
+	GLuint program = 0;
+	GLint ret = 0;
+	void *binary;
+	FILE *f;
+
+	program_cache_path(path, sizeof(path), key);
+
+	f = fopen(path, "rb");
+	if (!f)
+		return 0;
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+		hdr.magic != PROGRAM_CACHE_MAGIC || !hdr.length) {
+		fclose(f);
+		return 0;
+	}
+
+	binary = malloc(hdr.length);
+	if (binary && fread(binary, hdr.length, 1, f) == 1) {
+		program = glCreateProgram();
+		cache.glProgramBinaryOES(program, hdr.format, binary, hdr.length);
+		glGetProgramiv(program, GL_LINK_STATUS, &ret);
+	}
+
+	free(binary);
+	fclose(f);
+
+	if (program && !ret) {
+		/* driver update, or otherwise incompatible: */
+		printf("discarding stale program binary %s\n", path);
+		glDeleteProgram(program);
+		unlink(path);
+		program = 0;
+	}
+
+	return program;
+}
+
+static void program_cache_store(GLuint program, uint64_t key)
+{
+	struct program_cache_header hdr = { .magic = PROGRAM_CACHE_MAGIC };
+	char path[300], tmp[310];
+	GLint length = 0;
+	GLenum format;
+	void *binary;
+	FILE *f;
+
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+	if (length <= 0)
+		return;
+
+	binary = malloc(length);
+	if (!binary)
+		return;
+
+	cache.glGetProgramBinaryOES(program, length, &length, &format, binary);
+	hdr.format = format;
+	hdr.length = length;
+
+	program_cache_path(path, sizeof(path), key);
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+
+	/* write to a temporary file first, so concurrent instances never
+	 * see a partial binary:
+	 */
+	f = fopen(tmp, "wb");
+	if (f) {
+		int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+				 fwrite(binary, length, 1, f) == 1;
+
+		if (fclose(f) == 0 && ok)
+			rename(tmp, path);
+		else
+			unlink(tmp);
+	}
+
+	free(binary);
+}
+
+static void program_cache_track(GLuint program, uint64_t key, int loaded)
+{
+	if (cache.count == MAX_CACHED_PROGRAMS)
+		return;
+
+	cache.programs[cache.count].program = program;
+	cache.programs[cache.count].key = key;
+	cache.programs[cache.count].loaded = loaded;
+	cache.count++;
+}
+
+/* returns the tracking slot of program, or -1 if it is not cached: */
+static int program_cache_find(GLuint program)
+{
+	unsigned i;
+
+	for (i = 0; i < cache.count; i++) {
+		if (cache.programs[i].program == program)
+			return i;
+	}
+
+	return -1;
+}
+
+static void program_cache_untrack(int idx)
+{
+	cache.programs[idx] = cache.programs[--cache.count];
+}
+
+static int create_program_internal(const char *vs_src, const char *fs_src,
+		const struct program_attrib *attribs, unsigned num_attribs);
+static int link_program_internal(unsigned program);
+
+int create_program(const char *vs_src, const char *fs_src,
+		const struct program_attrib *attribs, unsigned num_attribs)
+{
+	int ret;
+
+	startup_begin(STARTUP_SHADERS);
+	ret = create_program_internal(vs_src, fs_src, attribs, num_attribs);
+	startup_end(STARTUP_SHADERS);
+
+	return ret;
+}
+
+int link_program(unsigned program)
+{
+	int ret;
+
+	startup_begin(STARTUP_SHADERS);
+	ret = link_program_internal(program);
+	startup_end(STARTUP_SHADERS);
+
+	return ret;
+}
+
+static int create_program_internal(const char *vs_src, const char *fs_src,
+		const struct program_attrib *attribs, unsigned num_attribs)
 {
 	GLuint vertex_shader, fragment_shader, program;
+	uint64_t key = 0;
+	unsigned i;
 	GLint ret;
 
+	if (cache.dir[0]) {
+		key = fnv1a(fnv1a(cache.driver_hash, vs_src), fs_src);
+		/* the same sources linked with other locations are a
+		 * different binary:
+		 */
+		for (i = 0; i < num_attribs; i++) {
+			char index[16];
+
+			snprintf(index, sizeof(index), "%u", attribs[i].index);
+			key = fnv1a(fnv1a(key, attribs[i].name), index);
+		}
+		program = program_cache_load(key);
+		if (program) {
+			program_cache_track(program, key, 1);
+			return program;
+		}
+	}
+
 	vertex_shader = glCreateShader(GL_VERTEX_SHADER);
 
 	glShaderSource(vertex_shader, 1, &vs_src, NULL);
@@ -273,13 +694,26 @@ int create_program(const char *vs_src, const char *fs_src)
 	glAttachShader(program, vertex_shader);
 	glAttachShader(program, fragment_shader);
 
+	for (i = 0; i < num_attribs; i++)
+		glBindAttribLocation(program, attribs[i].index, attribs[i].name);
+
+	if (cache.dir[0])
+		program_cache_track(program, key, 0);
+
 	return program;
 }
 
-int link_program(unsigned program)
+static int link_program_internal(unsigned program)
 {
+	int idx = program_cache_find(program);
 	GLint ret;
 
+	if (idx >= 0 && cache.programs[idx].loaded) {
+		/* loaded from the cache, already linked: */
+		program_cache_untrack(idx);
+		return 0;
+	}
+
 	glLinkProgram(program);
 
 	glGetProgramiv(program, GL_LINK_STATUS, &ret);
@@ -295,9 +729,17 @@ int link_program(unsigned program)
 			printf("%s", log);
 		}
 
+		if (idx >= 0)
+			program_cache_untrack(idx);
+
 		return -1;
 	}
 
+	if (idx >= 0) {
+		program_cache_store(program, cache.programs[idx].key);
+		program_cache_untrack(idx);
+	}
+
 	return 0;
 }
 
@@ -317,3 +759,450 @@ EGLSyncKHR create_fence(const struct egl *egl, int fd)
 
 	return fence;
 }
+
+EGLImage create_dmabuf_image(const struct egl *egl, uint32_t width, uint32_t height,
+		uint32_t format, unsigned num_planes, const int *fds,
+		const uint32_t *offsets, const uint32_t *pitches)
+{
+	static const EGLint plane_fd_attr[MAX_DMABUF_PLANES] = {
+		EGL_DMA_BUF_PLANE0_FD_EXT,
+		EGL_DMA_BUF_PLANE1_FD_EXT,
+		EGL_DMA_BUF_PLANE2_FD_EXT,
+	};
+	static const EGLint plane_offset_attr[MAX_DMABUF_PLANES] = {
+		EGL_DMA_BUF_PLANE0_OFFSET_EXT,
+		EGL_DMA_BUF_PLANE1_OFFSET_EXT,
+		EGL_DMA_BUF_PLANE2_OFFSET_EXT,
+	};
+	static const EGLint plane_pitch_attr[MAX_DMABUF_PLANES] = {
+		EGL_DMA_BUF_PLANE0_PITCH_EXT,
+		EGL_DMA_BUF_PLANE1_PITCH_EXT,
+		EGL_DMA_BUF_PLANE2_PITCH_EXT,
+	};
+	/* Initialize the first 6 attributes with values that are
+	 * plane invariant (width, height, format) */
+	EGLint attr[6 + 6*MAX_DMABUF_PLANES + 1] = {
+		EGL_WIDTH, width,
+		EGL_HEIGHT, height,
+		EGL_LINUX_DRM_FOURCC_EXT, format
+	};
+	unsigned i;
+
+	if (num_planes > MAX_DMABUF_PLANES)
+		return EGL_NO_IMAGE_KHR;
+
+	for (i = 0; i < num_planes; i++) {
+		attr[6 + 6*i + 0] = plane_fd_attr[i];
+		attr[6 + 6*i + 1] = fds[i];
+		attr[6 + 6*i + 2] = plane_offset_attr[i];
+		attr[6 + 6*i + 3] = offsets[i];
+		attr[6 + 6*i + 4] = plane_pitch_attr[i];
+		attr[6 + 6*i + 5] = pitches[i];
+	}
+
+	attr[6 + 6*num_planes] = EGL_NONE;
+
+	return egl->eglCreateImageKHR(egl->display, EGL_NO_CONTEXT,
+			EGL_LINUX_DMA_BUF_EXT, NULL, attr);
+}
+
+int64_t get_time_ns(void)
+{
+	struct timespec tv;
+	clock_gettime(CLOCK_MONOTONIC, &tv);
+	return tv.tv_nsec + tv.tv_sec * NSEC_PER_SEC;
+}
+
+void set_projection(ESMatrix *projection, GLfloat extent, GLfloat aspect)
+{
+	esMatrixLoadIdentity(projection);
+	esFrustum(projection, -extent, +extent, -extent * aspect, +extent * aspect,
+			  6.0f, 10.0f);
+}
+
+static const char *startup_phase_names[STARTUP_NUM_PHASES] = {
+	[STARTUP_DRM]         = "DRM probing",
+	[STARTUP_SURFMGR]     = "surface manager",
+	[STARTUP_EGL]         = "EGL init",
+	[STARTUP_SHADERS]     = "shader compile",
+	[STARTUP_TEXTURES]    = "texture upload",
+	[STARTUP_FIRST_FRAME] = "first frame",
+};
+
+static struct {
+	int64_t start;                       /* first startup_begin() */
+	int64_t begin[STARTUP_NUM_PHASES];
+	int64_t total[STARTUP_NUM_PHASES];
+	/* phases in progress, innermost last; only that one is counted: */
+	enum startup_phase open[STARTUP_NUM_PHASES];
+	int depth;
+	int reported;
+} startup;
+
+/* Phases nest (shaders compiled during EGL init, for the PRIME copy),
+ * the outer one pauses while an inner one runs so nothing counts twice:
+ */
+void startup_begin(enum startup_phase phase)
+{
+	int64_t now = get_time_ns();
+
+	trace_begin(startup_phase_names[phase]);
+
+	if (startup.depth) {
+		enum startup_phase outer = startup.open[startup.depth - 1];
+
+		startup.total[outer] += now - startup.begin[outer];
+	}
+
+	assert(startup.depth < STARTUP_NUM_PHASES);
+	startup.open[startup.depth++] = phase;
+	startup.begin[phase] = now;
+	if (!startup.start)
+		startup.start = now;
+}
+
+void startup_end(enum startup_phase phase)
+{
+	int64_t now = get_time_ns();
+
+	startup.total[phase] += now - startup.begin[phase];
+	trace_end(startup_phase_names[phase]);
+
+	assert(startup.depth > 0 && startup.open[startup.depth - 1] == phase);
+	if (--startup.depth)
+		startup.begin[startup.open[startup.depth - 1]] = now;
+}
+
+/* Print the phase breakdown once, after the first frame hit the screen: */
+void startup_report(void)
+{
+	int i;
+
+	if (startup.reported)
+		return;
+
+	startup.reported = 1;
+
+	printf("===================================\n");
+	printf("Startup time:\n");
+	for (i = 0; i < STARTUP_NUM_PHASES; i++)
+		printf("  %-16s %8.3f ms\n", startup_phase_names[i],
+			   (double)startup.total[i] / 1000000.0);
+	printf("  %-16s %8.3f ms\n", "total",
+		   (double)(get_time_ns() - startup.start) / 1000000.0);
+	printf("===================================\n");
+}
+
+static const char *frame_phase_names[FRAME_NUM_PHASES] = {
+	[FRAME_UPDATE] = "update",
+	[FRAME_DRAW]   = "draw",
+	[FRAME_HUD]    = "hud",
+	[FRAME_SWAP]   = "swap",
+	[FRAME_WAIT]   = "wait",
+	[FRAME_COMMIT] = "commit",
+};
+
+#define FRAME_REPORT_INTERVAL 120
+
+static struct {
+	int64_t begin[FRAME_NUM_PHASES];
+	int64_t total[FRAME_NUM_PHASES];
+	unsigned frames;
+
+	/* for the HUD, the current frame only: */
+	int64_t cpu_ns;
+	int64_t last_present;
+	uint64_t last_gpu_ns;
+	/* not yet taken by gpu_time_sample(): */
+	uint64_t new_gpu_ns;
+
+	struct gpu_timer timer;
+} frame;
+
+void frame_begin(enum frame_phase phase)
+{
+	frame.begin[phase] = get_time_ns();
+}
+
+void frame_end(enum frame_phase phase)
+{
+	int64_t ns = get_time_ns() - frame.begin[phase];
+
+	frame.total[phase] += ns;
+	frame.cpu_ns += ns;
+}
+
+bool gpu_timer_init(struct gpu_timer *timer, const struct egl *egl)
+{
+	memset(timer, 0, sizeof(*timer));
+
+	if (!egl->glGenQueriesEXT || !egl->glGetQueryObjectui64vEXT)
+		return false;
+
+	egl->glGenQueriesEXT(GPU_TIMER_QUERIES, timer->queries);
+	timer->enabled = true;
+
+	return true;
+}
+
+uint64_t gpu_timer_begin(struct gpu_timer *timer, const struct egl *egl)
+{
+	unsigned q = timer->next;
+	GLuint64 ns = 0;
+
+	if (!timer->enabled)
+		return 0;
+
+	if (timer->pending[q]) {
+		GLuint available = 0;
+
+		egl->glGetQueryObjectuivEXT(timer->queries[q],
+				GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+		if (available) {
+			egl->glGetQueryObjectui64vEXT(timer->queries[q],
+					GL_QUERY_RESULT_EXT, &ns);
+			timer->total_ns += ns;
+			timer->samples++;
+		} else {
+			timer->dropped++;
+		}
+	}
+
+	egl->glBeginQueryEXT(GL_TIME_ELAPSED_EXT, timer->queries[q]);
+	timer->pending[q] = true;
+
+	return ns;
+}
+
+void gpu_timer_end(struct gpu_timer *timer, const struct egl *egl)
+{
+	if (!timer->enabled)
+		return;
+
+	egl->glEndQueryEXT(GL_TIME_ELAPSED_EXT);
+	timer->next = (timer->next + 1) % GPU_TIMER_QUERIES;
+}
+
+uint64_t gpu_time_sample(void)
+{
+	uint64_t ns = frame.new_gpu_ns;
+
+	frame.new_gpu_ns = 0;
+
+	return ns;
+}
+
+enum anim_clock anim_clock = ANIM_PRESENT;
+
+static struct {
+	int64_t period_ns;
+	int64_t start_ns;      /* predicted presentation of the first frame */
+	bool started;
+
+	/* last frame known to have reached the screen: */
+	int64_t present_ns;
+	unsigned present_frame;
+	bool presented;
+} anim = {
+	.period_ns = NSEC_PER_SEC / 60,
+};
+
+void init_anim_clock(int64_t period_ns)
+{
+	if (period_ns > 0)
+		anim.period_ns = period_ns;
+}
+
+void frame_presented(unsigned i, int64_t ns)
+{
+	anim.present_ns = ns;
+	anim.present_frame = i;
+	anim.presented = true;
+
+	if (camera_enabled)
+		camera_presented(i, ns);
+}
+
+int parse_anim_clock(const char *name)
+{
+	if (!strcmp(name, "present"))
+		return ANIM_PRESENT;
+	if (!strcmp(name, "frame"))
+		return ANIM_FRAME;
+	if (!strcmp(name, "fixed"))
+		return ANIM_FIXED;
+	return -1;
+}
+
+/* Frame i is expected on screen one refresh period after frame i - 1.
+ * If that is already in the past (frames missed their vblank, or nothing
+ * has been presented yet) the next vblank from now is the best guess, so
+ * the motion catches up instead of slowing down.
+ */
+static int64_t predict_present(unsigned i)
+{
+	int64_t now = get_time_ns();
+	int64_t ns = now;
+
+	if (anim.presented)
+		ns = anim.present_ns +
+			(int64_t)(i - anim.present_frame) * anim.period_ns;
+
+	if (ns <= now)
+		ns += ((now - ns) / anim.period_ns + 1) * anim.period_ns;
+
+	return ns;
+}
+
+static float anim_position(unsigned i, int64_t present_ns)
+{
+	int64_t ns;
+
+	switch (anim_clock) {
+	case ANIM_FRAME:
+		return i;
+	case ANIM_FIXED:
+		ns = (int64_t)i * anim.period_ns;
+		break;
+	case ANIM_PRESENT:
+	default:
+		if (!anim.started) {
+			anim.start_ns = present_ns;
+			anim.started = true;
+		}
+		ns = present_ns - anim.start_ns;
+		break;
+	}
+
+	return (double)ns * 60 / NSEC_PER_SEC;
+}
+
+void draw_frame(const struct egl *egl, unsigned i)
+{
+	draw_frame_at(egl, i, predict_present(i), true);
+}
+
+void draw_frame_at(const struct egl *egl, unsigned i, int64_t present_ns,
+				   bool update)
+{
+	float t = anim_position(i, present_ns);
+	uint64_t ns;
+
+	trace_instant("frame", i);
+
+	if (update && egl->update) {
+		trace_begin("update");
+		frame_begin(FRAME_UPDATE);
+		egl->update();
+		frame_end(FRAME_UPDATE);
+		trace_end("update");
+	}
+
+	trace_begin("draw");
+	frame_begin(FRAME_DRAW);
+	if (!frame.timer.enabled)
+		gpu_timer_init(&frame.timer, egl);
+	ns = gpu_timer_begin(&frame.timer, egl);
+	if (ns)
+		frame.last_gpu_ns = frame.new_gpu_ns = ns;
+	egl->draw(t);
+	gpu_timer_end(&frame.timer, egl);
+	frame_end(FRAME_DRAW);
+	trace_end("draw");
+
+	/* before the HUD, which shows timings and would never match: */
+	if (capture_enabled)
+		capture_frame(i);
+
+	if (hud_enabled && !hud_layered) {
+		trace_begin("hud");
+		frame_begin(FRAME_HUD);
+		draw_hud(egl);
+		frame_end(FRAME_HUD);
+		trace_end("hud");
+	}
+}
+
+/* Called once per frame, prints averages every FRAME_REPORT_INTERVAL: */
+void frame_report(void)
+{
+	int i;
+
+	if (hud_enabled) {
+		int64_t now = get_time_ns();
+
+		if (frame.last_present)
+			hud_sample(now - frame.last_present, frame.cpu_ns,
+					   frame.last_gpu_ns);
+		frame.last_present = now;
+		frame.last_gpu_ns = 0;
+	}
+	frame.cpu_ns = 0;
+
+	if (++frame.frames < FRAME_REPORT_INTERVAL)
+		return;
+
+	printf("frame:");
+	if (frame.timer.enabled) {
+		GLint disjoint = 0;
+
+		/* a disjoint operation (clock change, power state, ...) makes
+		 * the results since the last check meaningless:
+		 */
+		glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+		if (disjoint || !frame.timer.samples)
+			printf(" gpu    n/a   |");
+		else
+			printf(" gpu %7.3f ms |",
+				   (double)frame.timer.total_ns / frame.timer.samples / 1000000.0);
+	}
+	for (i = 0; i < FRAME_NUM_PHASES; i++) {
+		if (i == FRAME_HUD && !hud_enabled)
+			continue;
+		if (i == FRAME_UPDATE && !frame.total[i])
+			continue;
+		printf(" %s %.3f", frame_phase_names[i],
+			   (double)frame.total[i] / frame.frames / 1000000.0);
+	}
+	printf(" ms cpu");
+	if (frame.timer.dropped)
+		printf(" (%u gpu samples late)", frame.timer.dropped);
+	printf("\n");
+
+	memset(frame.total, 0, sizeof(frame.total));
+	frame.frames = 0;
+	frame.timer.total_ns = 0;
+	frame.timer.samples = 0;
+	frame.timer.dropped = 0;
+}
+
+unsigned frame_count;
+
+float render_scale = 1.0;
+
+static volatile sig_atomic_t quit;
+
+static void quit_handler(int sig)
+{
+	(void)sig;
+	quit = 1;
+}
+
+/* SIGINT/SIGTERM end the main loop instead of killing the process, so
+ * exit handlers (trace output) still run:
+ */
+void init_quit_handler(void)
+{
+	struct sigaction sa = {
+		.sa_handler = quit_handler,
+	};
+
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+}
+
+bool keep_running(unsigned frame)
+{
+	return !quit && (!frame_count || frame < frame_count);
+}
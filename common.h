@@ -24,6 +24,8 @@
 #ifndef _COMMON_H
 #define _COMMON_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include <GLES2/gl2.h>
@@ -34,6 +36,8 @@
 #include <gbm.h>
 #include <drm_fourcc.h>
 
+#include "esUtil.h"
+
 #ifdef HAVE_ALLOCATOR
 #include <allocator/allocator.h>
 #endif
@@ -81,6 +85,16 @@ EGLAPI EGLBoolean EGLAPIENTRY eglQueryDisplayAttribEXT (EGLDisplay dpy, EGLint a
 #endif
 #endif /* EGL_EXT_device_base */
 
+#ifndef EGL_EXT_device_drm
+#define EGL_EXT_device_drm 1
+#define EGL_DRM_DEVICE_FILE_EXT           0x3233
+#endif /* EGL_EXT_device_drm */
+
+#ifndef EGL_EXT_device_drm_render_node
+#define EGL_EXT_device_drm_render_node 1
+#define EGL_DRM_RENDER_NODE_FILE_EXT      0x3377
+#endif /* EGL_EXT_device_drm_render_node */
+
 #ifndef GL_EXT_memory_object
 #define GL_EXT_memory_object 1
 #define GL_TEXTURE_TILING_EXT             0x9580
@@ -162,6 +176,7 @@ struct gbm {
 struct allocation {
 	allocation_t *alloc;
 	struct drm_fb *fb;
+	uint32_t stride;    /* the set's, checked against the export */
 	GLuint memoryObject;
 	GLuint texture;
 	GLuint framebuffer;
@@ -172,12 +187,83 @@ struct allocator {
 
 	struct allocation allocations[2]; /* double-buffering */
 
+	/* layout of the capability set the allocations were created with: */
+	uint64_t modifier;
+	uint32_t stride;
+	GLint tiling;
+
 	uint32_t next_allocation;
 };
 #endif /* HAVE_ALLOCATOR */
 
+/* A ring of GL_TIME_ELAPSED_EXT queries, in the context that was current
+ * at gpu_timer_init().  Results are read back GPU_TIMER_QUERIES timings
+ * later, by which time they are normally available.  If one isn't, its
+ * sample is dropped rather than stalling the pipeline waiting for it.
+ */
+#define GPU_TIMER_QUERIES 4
+
+struct gpu_timer {
+	bool enabled;
+	GLuint queries[GPU_TIMER_QUERIES];
+	bool pending[GPU_TIMER_QUERIES];
+	unsigned next;
+
+	/* accumulated until the owner's report clears them: */
+	uint64_t total_ns;
+	unsigned samples, dropped;
+};
+
+#define NUM_PRIME_BUFFERS 3
+
+struct prime_buffer {
+	struct gbm_bo *bo;          /* linear, allocated on the render device */
+	struct drm_fb *fb;          /* the same memory imported into KMS */
+	EGLImage image;
+	GLuint renderbuffer, framebuffer;
+	int busy;                   /* between get_next_fb and release_fb */
+};
+
+/* PRIME offload: render in the render device's preferred (tiled) layout,
+ * then blit into linear buffers the display device can scan out:
+ */
+struct prime {
+	int drm_fd;
+	EGLContext context;         /* private context for the copy */
+	GLuint program, vbo;
+	GLint texture;
+
+	struct prime_buffer buffers[NUM_PRIME_BUFFERS];
+	struct prime_buffer *next;  /* last blitted, not yet handed to KMS */
+	uint32_t last;              /* index of the last blit target */
+
+	/* copy cost statistics: */
+	unsigned frames;
+	int64_t submit_ns, wait_ns;
+	bool waits;                 /* the CPU waits for the copy (legacy) */
+
+	/* GPU time of the copy, timer queries in its context: */
+	struct gpu_timer timer;
+};
+
+#define NUM_DUMB_BUFFERS 3
+
+/* Software rendering: CPU mapped dumb buffers, drawn into directly and
+ * scanned out as they are:
+ */
+struct dumb {
+	struct drm_dumb *buffers[NUM_DUMB_BUFFERS];
+	int busy[NUM_DUMB_BUFFERS];     /* between get_next_fb and release_fb */
+	uint32_t back;                  /* being drawn */
+	int next;                       /* finished, not yet handed to KMS */
+};
+
 struct surfmgr {
+	int fd; /* device the surfaces are allocated (and rendered) on */
+
 	const struct gbm * gbm;
+	const struct prime * prime;
+	const struct dumb * dumb;
 #ifdef HAVE_ALLOCATOR
 	const struct allocator * allocator;
 #endif
@@ -193,9 +279,11 @@ struct egl {
 
 	PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT;
 	PFNEGLQUERYDEVICESEXTPROC eglQueryDevicesEXT;
+	PFNEGLQUERYDEVICESTRINGEXTPROC eglQueryDeviceStringEXT;
 	PFNEGLCREATEIMAGEKHRPROC eglCreateImageKHR;
 	PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR;
 	PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES;
+	PFNGLEGLIMAGETARGETRENDERBUFFERSTORAGEOESPROC glEGLImageTargetRenderbufferStorageOES;
 	PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
 	PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
 	PFNEGLWAITSYNCKHRPROC eglWaitSyncKHR;
@@ -206,8 +294,35 @@ struct egl {
 	PFNGLTEXSTORAGEMEM2DEXTPROC glTexStorageMem2DEXT;
 	PFNGLIMPORTMEMORYFDEXTPROC glImportMemoryFdEXT;
 	PFNGLTEXPARAMETERVNVXPROC glTexParametervNVX;
-
-	void (*draw)(unsigned i);
+	PFNGLGETPROGRAMBINARYOESPROC glGetProgramBinaryOES;
+	PFNGLPROGRAMBINARYOESPROC glProgramBinaryOES;
+	PFNGLGENQUERIESEXTPROC glGenQueriesEXT;
+	PFNGLBEGINQUERYEXTPROC glBeginQueryEXT;
+	PFNGLENDQUERYEXTPROC glEndQueryEXT;
+	PFNGLGETQUERYOBJECTUIVEXTPROC glGetQueryObjectuivEXT;
+	PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT;
+
+	/* context version, as reported by GL_VERSION: */
+	int gl_major, gl_minor;
+	/* an ES 3.x context was requested and created: */
+	bool es3;
+	/* the context isn't tied to config, see egl_no_config_context: */
+	bool no_config;
+
+	/* t is the frame's position on the animation timeline, see
+	 * draw_frame():
+	 */
+	void (*draw)(float t);
+
+	/* optional, called before draw() to update the scene's inputs
+	 * (streamed textures), timed as a phase of its own:
+	 */
+	void (*update)(void);
+
+	/* optional, rebuilds the projection for an output with a different
+	 * aspect ratio (height / width) than the surface, see --outputs:
+	 */
+	void (*set_aspect)(float aspect);
 };
 
 static inline int __egl_check(void *ptr, const char *name)
@@ -222,10 +337,129 @@ static inline int __egl_check(void *ptr, const char *name)
 #define egl_check(egl, name) __egl_check((egl)->name, #name)
 
 int init_egl(struct egl *egl, const struct surfmgr *surfmgr);
-int create_program(const char *vs_src, const char *fs_src);
+
+/* a vertex attribute location, bound before the program is linked: */
+struct program_attrib {
+	GLuint index;
+	const char *name;
+};
+
+int create_program(const char *vs_src, const char *fs_src,
+		const struct program_attrib *attribs, unsigned num_attribs);
 int link_program(unsigned program);
 EGLSyncKHR create_fence(const struct egl *egl, int fd);
 
+/* import a (multi-planar) dmabuf as an EGLImage, the planes can share
+ * fds: */
+#define MAX_DMABUF_PLANES 3
+EGLImage create_dmabuf_image(const struct egl *egl, uint32_t width, uint32_t height,
+		uint32_t format, unsigned num_planes, const int *fds,
+		const uint32_t *offsets, const uint32_t *pitches);
+int64_t get_time_ns(void);
+
+/* the scenes' projection for an aspect ratio (height / width), showing
+ * +/- extent across the near plane:
+ */
+void set_projection(ESMatrix *projection, GLfloat extent, GLfloat aspect);
+bool gl_has_extension(const char *ext);
+
+/* print extension strings and other chatty details: */
+extern int verbose;
+
+/* requested OpenGL ES client version, 2 or 3: */
+extern int gles_version;
+
+/* create the context without a config (EGL_KHR_no_config_context) where
+ * supported, so it can also draw to surfaces with alpha (--layers):
+ */
+extern bool egl_no_config_context;
+
+/* time-to-first-frame profiling: */
+enum startup_phase {
+	STARTUP_DRM,         /* opening the device, probing connectors */
+	STARTUP_SURFMGR,     /* GBM / allocator surfaces */
+	STARTUP_EGL,         /* display, context and surface creation */
+	STARTUP_SHADERS,     /* program compile + link (or cache load) */
+	STARTUP_TEXTURES,    /* texture upload */
+	STARTUP_FIRST_FRAME, /* first draw through the first commit/flip */
+	STARTUP_NUM_PHASES,
+};
+
+void startup_begin(enum startup_phase phase);
+void startup_end(enum startup_phase phase);
+void startup_report(void);
+
+/* steady state per-frame profiling, CPU time per phase of the main loop
+ * plus GPU time of the scene's draw (GL_EXT_disjoint_timer_query):
+ */
+enum frame_phase {
+	FRAME_UPDATE,        /* texture streaming (--frames, --upload) */
+	FRAME_DRAW,          /* scene draw call submission */
+	FRAME_HUD,           /* performance overlay (--hud), or its layer */
+	FRAME_SWAP,          /* end of frame: fences, PRIME copy, next fb */
+	FRAME_WAIT,          /* waiting for the previous commit/flip */
+	FRAME_COMMIT,        /* atomic commit / page flip ioctl */
+	FRAME_NUM_PHASES,
+};
+
+void frame_begin(enum frame_phase phase);
+void frame_end(enum frame_phase phase);
+void draw_frame(const struct egl *egl, unsigned i);
+/* as draw_frame(), for a frame the caller expects on screen at present_ns,
+ * when several outputs with their own timing draw the same scene; update
+ * is for the one of them driving the scene's update():
+ */
+void draw_frame_at(const struct egl *egl, unsigned i, int64_t present_ns,
+				   bool update);
+void frame_report(void);
+/* GPU time of the scene's latest timed draw, 0 if none came back since
+ * the previous call (or there are no timer queries):
+ */
+uint64_t gpu_time_sample(void);
+
+/* false if there are no timer queries: */
+bool gpu_timer_init(struct gpu_timer *timer, const struct egl *egl);
+/* returns the time collected from GPU_TIMER_QUERIES timings back, 0 if
+ * it isn't in (or there is none yet):
+ */
+uint64_t gpu_timer_begin(struct gpu_timer *timer, const struct egl *egl);
+void gpu_timer_end(struct gpu_timer *timer, const struct egl *egl);
+
+/* What drives the animation.  The scenes animate from a position in
+ * units of 1/60th of a second, so at 60Hz all of these advance it by one
+ * per frame, as the original frame counter did:
+ */
+enum anim_clock {
+	ANIM_PRESENT,  /* predicted presentation time of the frame (default) */
+	ANIM_FRAME,    /* frame index, speed depends on the achieved frame rate */
+	ANIM_FIXED,    /* one refresh period per frame, for reproducible runs */
+};
+
+extern enum anim_clock anim_clock;
+
+/* refresh period of the mode being displayed: */
+void init_anim_clock(int64_t period_ns);
+/* frame i reached the screen at ns (CLOCK_MONOTONIC): */
+void frame_presented(unsigned i, int64_t ns);
+int parse_anim_clock(const char *name);
+
+/* number of frames to run for, 0 for until interrupted: */
+extern unsigned frame_count;
+
+/* Fraction of the mode's width and height the scene is drawn at, the
+ * plane scales it up to the whole screen (atomic only).  0 follows the
+ * GPU frame time instead:
+ */
+extern float render_scale;
+#define RENDER_SCALE_MIN 0.25f
+
+void init_quit_handler(void);
+bool keep_running(unsigned frame);
+
+#define NSEC_PER_SEC (INT64_C(1000) * USEC_PER_SEC)
+#define USEC_PER_SEC (INT64_C(1000) * MSEC_PER_SEC)
+#define MSEC_PER_SEC INT64_C(1000)
+
 enum mode {
 	SMOOTH,        /* smooth-shaded */
 	RGBA,          /* single-plane RGBA */
@@ -234,8 +468,34 @@ enum mode {
 	VIDEO,         /* video textured cube */
 };
 
+/* how cube-tex updates its textures, once per frame unless none: */
+enum tex_upload {
+	UPLOAD_NONE,         /* built-in image, uploaded once */
+	UPLOAD_MAP,          /* gbm_bo_map() of a ring of linear buffers */
+	UPLOAD_SUBIMAGE,     /* glTexSubImage2D() into GL-owned textures */
+	UPLOAD_DMABUF_SYNC,  /* persistent dmabuf mmap with DMA_BUF_IOCTL_SYNC */
+	UPLOAD_REIMPORT,     /* as dmabuf-sync, re-creating the EGLImage each time */
+};
+
+extern enum tex_upload tex_upload;
+int parse_tex_upload(const char *name);
+
+/* cube-tex frames generated by pattern.c instead of a file or the
+ * built-in image (--pattern):
+ */
+struct tex_pattern {
+	int pattern;                /* enum pattern, -1 for none */
+	int format;                 /* enum frame_format */
+	unsigned width, height;     /* 0 for the display size */
+};
+
+extern struct tex_pattern tex_pattern;
+
 const struct egl * init_cube_smooth(const struct surfmgr *surfmgr);
-const struct egl * init_cube_tex(const struct surfmgr *surfmgr, enum mode mode);
+struct frames;
+const struct egl * init_cube_tex(const struct surfmgr *surfmgr, enum mode mode,
+		struct frames *frames);
+const struct egl * init_cube_software(const struct surfmgr *surfmgr, enum mode mode);
 
 #ifdef HAVE_GST
 
@@ -244,16 +504,10 @@ struct decoder * video_init(const struct egl *egl, const struct gbm *gbm, const
 EGLImage video_frame(struct decoder *dec);
 void video_deinit(struct decoder *dec);
 
-const struct egl * init_cube_video(const struct surfmgr *surfmgr, const char *video);
-
-#else
-static inline const struct egl *
-init_cube_video(const struct surfmgr *surfmgr, const char *video)
-{
-	(void)surfmgr; (void)video;
-	printf("no GStreamer support!\n");
-	return NULL;
-}
 #endif
 
+/* textured with a decoded video, or live from a V4L2 camera: */
+const struct egl * init_cube_video(const struct surfmgr *surfmgr,
+		const char *video, const char *camera);
+
 #endif /* _COMMON_H */
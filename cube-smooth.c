@@ -24,19 +24,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <GLES3/gl3.h>
+
 #include "common.h"
 #include "esUtil.h"
+#include "geometry.h"
+#include "objects.h"
 
 
 struct {
 	struct egl egl;
 
 	GLfloat aspect;
+	ESMatrix projection;
+	struct objects *objects;
 
 	GLuint program;
 	GLint modelviewmatrix, modelviewprojectionmatrix, normalmatrix;
-	GLuint vbo;
-	GLuint positionsoffset, colorsoffset, normalsoffset;
+	struct geometry geometry;
+
+	/* ES3 path: */
+	GLuint vao;
+	struct objects_ubo ubo;
 } gl;
 
 static const GLfloat vVertices[] = {
@@ -173,7 +182,65 @@ static const char *fragment_shader_source =
 		"}                                  \n";
 
 
-static void draw_cube_smooth(unsigned i)
+/* ES3 variant: per object matrices come from a uniform block indexed by
+ * gl_InstanceID, so a batch of cubes is a single instanced draw.
+ */
+static const char *vertex_shader_source_es3 =
+		"#version 300 es                    \n"
+		"                                   \n"
+		"struct object {                    \n"
+		"    mat4 modelview;                \n"
+		"    mat4 modelviewprojection;      \n"
+		"    mat3 normal;                   \n"
+		"};                                 \n"
+		"                                   \n"
+		"layout(std140) uniform objectsBlock {\n"
+		"    object objects[%u];            \n"
+		"};                                 \n"
+		"                                   \n"
+		"in vec4 in_position;               \n"
+		"in vec3 in_normal;                 \n"
+		"in vec4 in_color;                  \n"
+		"\n"
+		"vec4 lightSource = vec4(2.0, 2.0, 20.0, 0.0);\n"
+		"                                   \n"
+		"out vec4 vVaryingColor;            \n"
+		"                                   \n"
+		"void main()                        \n"
+		"{                                  \n"
+		"    object o = objects[gl_InstanceID];\n"
+		"    gl_Position = o.modelviewprojection * in_position;\n"
+		"    vec3 vEyeNormal = o.normal * in_normal;\n"
+		"    vec4 vPosition4 = o.modelview * in_position;\n"
+		"    vec3 vPosition3 = vPosition4.xyz / vPosition4.w;\n"
+		"    vec3 vLightDir = normalize(lightSource.xyz - vPosition3);\n"
+		"    float diff = max(0.0, dot(vEyeNormal, vLightDir));\n"
+		"    vVaryingColor = vec4(diff * in_color.rgb, 1.0);\n"
+		"}                                  \n";
+
+static const char *fragment_shader_source_es3 =
+		"#version 300 es                    \n"
+		"precision mediump float;           \n"
+		"                                   \n"
+		"in vec4 vVaryingColor;             \n"
+		"out vec4 fragColor;                \n"
+		"                                   \n"
+		"void main()                        \n"
+		"{                                  \n"
+		"    fragColor = vVaryingColor;     \n"
+		"}                                  \n";
+
+static void draw_cube_geometry(void)
+{
+	draw_geometry(&gl.geometry);
+}
+
+static void draw_cube_instanced(unsigned count)
+{
+	draw_geometry_instanced(&gl.geometry, count);
+}
+
+static void draw_cube_smooth(float t)
 {
 	ESMatrix modelview;
 
@@ -181,19 +248,21 @@ static void draw_cube_smooth(unsigned i)
 	glClearColor(0.5, 0.5, 0.5, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT);
 
+	if (gl.objects) {
+		draw_objects(gl.objects, t, gl.modelviewmatrix,
+					 gl.modelviewprojectionmatrix, gl.normalmatrix,
+					 draw_cube_geometry);
+		return;
+	}
+
 	esMatrixLoadIdentity(&modelview);
 	esTranslate(&modelview, 0.0f, 0.0f, -8.0f);
-	esRotate(&modelview, 45.0f + (0.25f * i), 1.0f, 0.0f, 0.0f);
-	esRotate(&modelview, 45.0f - (0.5f * i), 0.0f, 1.0f, 0.0f);
-	esRotate(&modelview, 10.0f + (0.15f * i), 0.0f, 0.0f, 1.0f);
-
-	ESMatrix projection;
-	esMatrixLoadIdentity(&projection);
-	esFrustum(&projection, -2.8f, +2.8f, -2.8f * gl.aspect, +2.8f * gl.aspect, 6.0f, 10.0f);
+	esRotate(&modelview, 45.0f + (0.25f * t), 1.0f, 0.0f, 0.0f);
+	esRotate(&modelview, 45.0f - (0.5f * t), 0.0f, 1.0f, 0.0f);
+	esRotate(&modelview, 10.0f + (0.15f * t), 0.0f, 0.0f, 1.0f);
 
 	ESMatrix modelviewprojection;
-	esMatrixLoadIdentity(&modelviewprojection);
-	esMatrixMultiply(&modelviewprojection, &modelview, &projection);
+	esMatrixMultiply(&modelviewprojection, &modelview, &gl.projection);
 
 	float normal[9];
 	normal[0] = modelview.m[0][0];
@@ -210,37 +279,66 @@ static void draw_cube_smooth(unsigned i)
 	glUniformMatrix4fv(gl.modelviewprojectionmatrix, 1, GL_FALSE, &modelviewprojection.m[0][0]);
 	glUniformMatrix3fv(gl.normalmatrix, 1, GL_FALSE, normal);
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 4, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 8, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 12, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 16, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 20, 4);
+	draw_cube_geometry();
 }
 
-const struct egl * init_cube_smooth(const struct surfmgr *surfmgr)
+static void draw_cube_smooth_es3(float t)
 {
-	int ret;
+	ESMatrix modelview, modelviewprojection;
+	float normal[9];
 
-	ret = init_egl(&gl.egl, surfmgr);
-	if (ret)
-		return NULL;
+	/* clear the color buffer */
+	glClearColor(0.5, 0.5, 0.5, 1.0);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	if (gl.objects) {
+		draw_objects_instanced(gl.objects, t, draw_cube_instanced);
+		return;
+	}
+
+	esMatrixLoadIdentity(&modelview);
+	esTranslate(&modelview, 0.0f, 0.0f, -8.0f);
+	esRotate(&modelview, 45.0f + (0.25f * t), 1.0f, 0.0f, 0.0f);
+	esRotate(&modelview, 45.0f - (0.5f * t), 0.0f, 1.0f, 0.0f);
+	esRotate(&modelview, 10.0f + (0.15f * t), 0.0f, 0.0f, 1.0f);
 
-	gl.aspect = (GLfloat)(surfmgr->height) / (GLfloat)(surfmgr->width);
+	esMatrixMultiply(&modelviewprojection, &modelview, &gl.projection);
 
-	ret = create_program(vertex_shader_source, fragment_shader_source);
+	normal[0] = modelview.m[0][0];
+	normal[1] = modelview.m[0][1];
+	normal[2] = modelview.m[0][2];
+	normal[3] = modelview.m[1][0];
+	normal[4] = modelview.m[1][1];
+	normal[5] = modelview.m[1][2];
+	normal[6] = modelview.m[2][0];
+	normal[7] = modelview.m[2][1];
+	normal[8] = modelview.m[2][2];
+
+	pack_object_block(objects_ubo_block(&gl.ubo, 0), &modelview,
+					  &modelviewprojection, normal);
+	submit_objects_ubo(&gl.ubo, 1, draw_cube_instanced);
+}
+
+static const struct program_attrib program_attribs[] = {
+	{ 0, "in_position" },
+	{ 1, "in_normal" },
+	{ 2, "in_color" },
+};
+
+static int init_program(void)
+{
+	int ret;
+
+	ret = create_program(vertex_shader_source, fragment_shader_source,
+			program_attribs, ARRAY_SIZE(program_attribs));
 	if (ret < 0)
-		return NULL;
+		return -1;
 
 	gl.program = ret;
 
-	glBindAttribLocation(gl.program, 0, "in_position");
-	glBindAttribLocation(gl.program, 1, "in_normal");
-	glBindAttribLocation(gl.program, 2, "in_color");
-
 	ret = link_program(gl.program);
 	if (ret)
-		return NULL;
+		return -1;
 
 	glUseProgram(gl.program);
 
@@ -248,26 +346,101 @@ const struct egl * init_cube_smooth(const struct surfmgr *surfmgr)
 	gl.modelviewprojectionmatrix = glGetUniformLocation(gl.program, "modelviewprojectionMatrix");
 	gl.normalmatrix = glGetUniformLocation(gl.program, "normalMatrix");
 
+	return 0;
+}
+
+static int init_program_es3(void)
+{
+	char vs_src[2048];
+	GLuint block;
+	int ret;
+
+	ret = init_objects_ubo(&gl.ubo, 0, gl.objects ? gl.objects->count : 1);
+	if (ret) {
+		printf("failed to create uniform buffer\n");
+		return -1;
+	}
+
+	if (gl.objects)
+		gl.objects->ubo = &gl.ubo;
+
+	/* the array in the uniform block is sized to the batch: */
+	snprintf(vs_src, sizeof(vs_src), vertex_shader_source_es3, gl.ubo.batch);
+
+	ret = create_program(vs_src, fragment_shader_source_es3,
+			program_attribs, ARRAY_SIZE(program_attribs));
+	if (ret < 0)
+		return -1;
+
+	gl.program = ret;
+
+	ret = link_program(gl.program);
+	if (ret)
+		return -1;
+
+	block = glGetUniformBlockIndex(gl.program, "objectsBlock");
+	if (block == GL_INVALID_INDEX) {
+		printf("no objectsBlock uniform block\n");
+		return -1;
+	}
+	glUniformBlockBinding(gl.program, block, gl.ubo.binding);
+
+	glUseProgram(gl.program);
+
+	/* the vertex attribute setup in init_geometry() goes into the VAO: */
+	glGenVertexArrays(1, &gl.vao);
+	glBindVertexArray(gl.vao);
+
+	return 0;
+}
+
+/* the projection only depends on the aspect ratio: */
+static void set_aspect(float aspect)
+{
+	gl.aspect = aspect;
+	set_projection(&gl.projection, 2.8f, aspect);
+}
+
+const struct egl * init_cube_smooth(const struct surfmgr *surfmgr)
+{
+	const struct geometry_attrib attribs[] = {
+		{ 0, ATTRIB_POSITION, vVertices },
+		{ 1, ATTRIB_NORMAL, vNormals },
+		{ 2, ATTRIB_COLOR, vColors },
+	};
+	int ret;
+
+	ret = init_egl(&gl.egl, surfmgr);
+	if (ret)
+		return NULL;
+
+	set_aspect((GLfloat)(surfmgr->height) / (GLfloat)(surfmgr->width));
+
+	if (num_objects > 1) {
+		gl.objects = init_objects(num_objects, 2.8f, gl.aspect, &gl.projection);
+		if (!gl.objects)
+			return NULL;
+	}
+
+	if (gl.egl.es3)
+		ret = init_program_es3();
+	else
+		ret = init_program();
+	if (ret)
+		return NULL;
+
 	glViewport(0, 0, surfmgr->width, surfmgr->height);
 	glEnable(GL_CULL_FACE);
 
-	gl.positionsoffset = 0;
-	gl.colorsoffset = sizeof(vVertices);
-	gl.normalsoffset = sizeof(vVertices) + sizeof(vColors);
-	glGenBuffers(1, &gl.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, gl.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vVertices) + sizeof(vColors) + sizeof(vNormals), 0, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, gl.positionsoffset, sizeof(vVertices), &vVertices[0]);
-	glBufferSubData(GL_ARRAY_BUFFER, gl.colorsoffset, sizeof(vColors), &vColors[0]);
-	glBufferSubData(GL_ARRAY_BUFFER, gl.normalsoffset, sizeof(vNormals), &vNormals[0]);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(intptr_t)gl.positionsoffset);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(intptr_t)gl.normalsoffset);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(intptr_t)gl.colorsoffset);
-	glEnableVertexAttribArray(2);
-
-	gl.egl.draw = draw_cube_smooth;
+	ret = init_geometry(&gl.geometry, &gl.egl, attribs, 3,
+						sizeof(vVertices) / sizeof(vVertices[0]) / 3);
+	if (ret) {
+		printf("failed to create cube geometry\n");
+		return NULL;
+	}
+
+	gl.egl.draw = gl.egl.es3 ? draw_cube_smooth_es3 : draw_cube_smooth;
+	gl.egl.set_aspect = set_aspect;
 
 	return &gl.egl;
 }
@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "esUtil.h"
+#include "frames.h"
+#include "objects.h"
+#include "surface-manager.h"
+#include "swrender.h"
+#include "yuv.h"
+
+/* The smooth and textured cubes, drawn on the CPU by swrender with the
+ * vertex shaders of cube-smooth.c and cube-tex.c done in C, into the dumb
+ * buffers of the surface manager.  Nothing here touches EGL or GL.
+ */
+
+static struct {
+	struct egl egl;
+
+	const struct surfmgr *surfmgr;
+	struct swrender *sw;
+	bool textured;
+	struct frames *builtin; /* the RGBA frame is sampled in place */
+	uint32_t *rgb;          /* the NV12 frame, converted once */
+
+	GLfloat aspect;
+	ESMatrix projection;
+	struct objects *objects;
+
+	/* vVertices with w = 1, for esMatrixTransform(): */
+	GLfloat positions[24 * 4];
+} gl;
+
+static const GLfloat vVertices[] = {
+		// front
+		-1.0f, -1.0f, +1.0f,
+		+1.0f, -1.0f, +1.0f,
+		-1.0f, +1.0f, +1.0f,
+		+1.0f, +1.0f, +1.0f,
+		// back
+		+1.0f, -1.0f, -1.0f,
+		-1.0f, -1.0f, -1.0f,
+		+1.0f, +1.0f, -1.0f,
+		-1.0f, +1.0f, -1.0f,
+		// right
+		+1.0f, -1.0f, +1.0f,
+		+1.0f, -1.0f, -1.0f,
+		+1.0f, +1.0f, +1.0f,
+		+1.0f, +1.0f, -1.0f,
+		// left
+		-1.0f, -1.0f, -1.0f,
+		-1.0f, -1.0f, +1.0f,
+		-1.0f, +1.0f, -1.0f,
+		-1.0f, +1.0f, +1.0f,
+		// top
+		-1.0f, +1.0f, +1.0f,
+		+1.0f, +1.0f, +1.0f,
+		-1.0f, +1.0f, -1.0f,
+		+1.0f, +1.0f, -1.0f,
+		// bottom
+		-1.0f, -1.0f, -1.0f,
+		+1.0f, -1.0f, -1.0f,
+		-1.0f, -1.0f, +1.0f,
+		+1.0f, -1.0f, +1.0f,
+};
+
+static const GLfloat vColors[] = {
+		// front
+		0.0f,  0.0f,  1.0f, // blue
+		1.0f,  0.0f,  1.0f, // magenta
+		0.0f,  1.0f,  1.0f, // cyan
+		1.0f,  1.0f,  1.0f, // white
+		// back
+		1.0f,  0.0f,  0.0f, // red
+		0.0f,  0.0f,  0.0f, // black
+		1.0f,  1.0f,  0.0f, // yellow
+		0.0f,  1.0f,  0.0f, // green
+		// right
+		1.0f,  0.0f,  1.0f, // magenta
+		1.0f,  0.0f,  0.0f, // red
+		1.0f,  1.0f,  1.0f, // white
+		1.0f,  1.0f,  0.0f, // yellow
+		// left
+		0.0f,  0.0f,  0.0f, // black
+		0.0f,  0.0f,  1.0f, // blue
+		0.0f,  1.0f,  0.0f, // green
+		0.0f,  1.0f,  1.0f, // cyan
+		// top
+		0.0f,  1.0f,  1.0f, // cyan
+		1.0f,  1.0f,  1.0f, // white
+		0.0f,  1.0f,  0.0f, // green
+		1.0f,  1.0f,  0.0f, // yellow
+		// bottom
+		0.0f,  0.0f,  0.0f, // black
+		1.0f,  0.0f,  0.0f, // red
+		0.0f,  0.0f,  1.0f, // blue
+		1.0f,  0.0f,  1.0f  // magenta
+};
+
+static const GLfloat vNormals[] = {
+		// front
+		+0.0f, +0.0f, +1.0f, // forward
+		+0.0f, +0.0f, +1.0f, // forward
+		+0.0f, +0.0f, +1.0f, // forward
+		+0.0f, +0.0f, +1.0f, // forward
+		// back
+		+0.0f, +0.0f, -1.0f, // backward
+		+0.0f, +0.0f, -1.0f, // backward
+		+0.0f, +0.0f, -1.0f, // backward
+		+0.0f, +0.0f, -1.0f, // backward
+		// right
+		+1.0f, +0.0f, +0.0f, // right
+		+1.0f, +0.0f, +0.0f, // right
+		+1.0f, +0.0f, +0.0f, // right
+		+1.0f, +0.0f, +0.0f, // right
+		// left
+		-1.0f, +0.0f, +0.0f, // left
+		-1.0f, +0.0f, +0.0f, // left
+		-1.0f, +0.0f, +0.0f, // left
+		-1.0f, +0.0f, +0.0f, // left
+		// top
+		+0.0f, +1.0f, +0.0f, // up
+		+0.0f, +1.0f, +0.0f, // up
+		+0.0f, +1.0f, +0.0f, // up
+		+0.0f, +1.0f, +0.0f, // up
+		// bottom
+		+0.0f, -1.0f, +0.0f, // down
+		+0.0f, -1.0f, +0.0f, // down
+		+0.0f, -1.0f, +0.0f, // down
+		+0.0f, -1.0f, +0.0f  // down
+};
+
+static const GLfloat vTexCoords[] = {
+		//front
+		1.0f, 1.0f,
+		0.0f, 1.0f,
+		1.0f, 0.0f,
+		0.0f, 0.0f,
+		//back
+		1.0f, 1.0f,
+		0.0f, 1.0f,
+		1.0f, 0.0f,
+		0.0f, 0.0f,
+		//right
+		1.0f, 1.0f,
+		0.0f, 1.0f,
+		1.0f, 0.0f,
+		0.0f, 0.0f,
+		//left
+		1.0f, 1.0f,
+		0.0f, 1.0f,
+		1.0f, 0.0f,
+		0.0f, 0.0f,
+		//top
+		1.0f, 1.0f,
+		0.0f, 1.0f,
+		1.0f, 0.0f,
+		0.0f, 0.0f,
+		//bottom
+		1.0f, 0.0f,
+		0.0f, 0.0f,
+		1.0f, 1.0f,
+		0.0f, 1.0f,
+};
+
+/* each face is a 4 vertex strip: */
+static const uint16_t indices[] = {
+		0, 1, 2, 2, 1, 3,
+		4, 5, 6, 6, 5, 7,
+		8, 9, 10, 10, 9, 11,
+		12, 13, 14, 14, 13, 15,
+		16, 17, 18, 18, 17, 19,
+		20, 21, 22, 22, 21, 23,
+};
+
+static const GLfloat lightSource[3] = { 2.0f, 2.0f, 20.0f };
+
+static void draw_cube(const ESMatrix *modelview,
+					  const ESMatrix *modelviewprojection,
+					  const GLfloat normal[9])
+{
+	struct sw_vertex vertices[24];
+	GLfloat clip[24 * 4], eye[24 * 4];
+	unsigned i, j;
+
+	esMatrixTransform(modelviewprojection, gl.positions, clip, 24);
+	esMatrixTransform(modelview, gl.positions, eye, 24);
+
+	for (i = 0; i < 24; i++) {
+		struct sw_vertex *v = &vertices[i];
+		const GLfloat *n = &vNormals[i * 3];
+		GLfloat eyeNormal[3], lightDir[3], len, diff;
+
+		for (j = 0; j < 3; j++) {
+			eyeNormal[j] = n[0] * normal[j] + n[1] * normal[3 + j] +
+						   n[2] * normal[6 + j];
+			lightDir[j] = lightSource[j] - eye[i * 4 + j] / eye[i * 4 + 3];
+		}
+
+		len = sqrtf(lightDir[0] * lightDir[0] + lightDir[1] * lightDir[1] +
+					lightDir[2] * lightDir[2]);
+		diff = fmaxf(0.0f, (eyeNormal[0] * lightDir[0] +
+							eyeNormal[1] * lightDir[1] +
+							eyeNormal[2] * lightDir[2]) / len);
+
+		v->x = clip[i * 4 + 0];
+		v->y = clip[i * 4 + 1];
+		v->z = clip[i * 4 + 2];
+		v->w = clip[i * 4 + 3];
+
+		if (gl.textured) {
+			v->r = v->g = v->b = diff;
+			v->u = vTexCoords[i * 2 + 0];
+			v->v = vTexCoords[i * 2 + 1];
+		} else {
+			v->r = diff * vColors[i * 3 + 0];
+			v->g = diff * vColors[i * 3 + 1];
+			v->b = diff * vColors[i * 3 + 2];
+			v->u = v->v = 0.0f;
+		}
+	}
+
+	swrender_triangles(gl.sw, vertices, indices, ARRAY_SIZE(indices));
+}
+
+static void draw_cube_software(float t)
+{
+	ESMatrix modelview, modelviewprojection;
+	GLfloat normal[9];
+	unsigned i;
+
+	/* glClearColor(0.5, 0.5, 0.5, 1.0): */
+	swrender_begin(gl.sw, 0x808080);
+
+	if (gl.objects) {
+		update_objects(gl.objects, t);
+		for (i = 0; i < gl.objects->count; i++)
+			draw_cube(&gl.objects->modelview[i],
+					  &gl.objects->modelviewprojection[i],
+					  gl.objects->normal[i]);
+	} else {
+		esMatrixLoadIdentity(&modelview);
+		esTranslate(&modelview, 0.0f, 0.0f, -8.0f);
+		esRotate(&modelview, 45.0f + (0.25f * t), 1.0f, 0.0f, 0.0f);
+		esRotate(&modelview, 45.0f - (0.5f * t), 0.0f, 1.0f, 0.0f);
+		esRotate(&modelview, 10.0f + (0.15f * t), 0.0f, 0.0f, 1.0f);
+
+		esMatrixMultiply(&modelviewprojection, &modelview, &gl.projection);
+
+		normal[0] = modelview.m[0][0];
+		normal[1] = modelview.m[0][1];
+		normal[2] = modelview.m[0][2];
+		normal[3] = modelview.m[1][0];
+		normal[4] = modelview.m[1][1];
+		normal[5] = modelview.m[1][2];
+		normal[6] = modelview.m[2][0];
+		normal[7] = modelview.m[2][1];
+		normal[8] = modelview.m[2][2];
+
+		draw_cube(&modelview, &modelviewprojection, normal);
+	}
+
+	swrender_end(gl.sw, surfmgr_get_dumb_back(gl.surfmgr));
+}
+
+const struct egl * init_cube_software(const struct surfmgr *surfmgr,
+									  enum mode mode)
+{
+	const unsigned texw = 512, texh = 512;
+	unsigned i;
+
+	if (mode == VIDEO) {
+		printf("software rendering does not support video\n");
+		return NULL;
+	}
+
+	gl.surfmgr = surfmgr;
+	gl.textured = mode != SMOOTH;
+	gl.aspect = (GLfloat)(surfmgr->height) / (GLfloat)(surfmgr->width);
+
+	set_projection(&gl.projection, 2.8f, gl.aspect);
+
+	if (num_objects > 1) {
+		gl.objects = init_objects(num_objects, 2.8f, gl.aspect, &gl.projection);
+		if (!gl.objects)
+			return NULL;
+	}
+
+	for (i = 0; i < 24; i++) {
+		gl.positions[i * 4 + 0] = vVertices[i * 3 + 0];
+		gl.positions[i * 4 + 1] = vVertices[i * 3 + 1];
+		gl.positions[i * 4 + 2] = vVertices[i * 3 + 2];
+		gl.positions[i * 4 + 3] = 1.0f;
+	}
+
+	gl.sw = swrender_create(surfmgr->width, surfmgr->height, 0);
+	if (!gl.sw) {
+		printf("failed to create software renderer\n");
+		return NULL;
+	}
+
+	if (gl.textured) {
+		gl.builtin = frames_open_builtin(mode == RGBA ? FRAME_RGBA : FRAME_NV12);
+		if (!gl.builtin) {
+			printf("failed to load the built-in image\n");
+			return NULL;
+		}
+	}
+
+	if (mode == RGBA) {
+		swrender_texture(gl.sw, frames_next(gl.builtin), texw, texh,
+						 DRM_FORMAT_ABGR8888);
+	} else if (mode == NV12_2IMG || mode == NV12_1IMG) {
+		const uint8_t *nv12 = frames_next(gl.builtin);
+		const struct yuv_image img = {
+			.format = YUV_NV12,
+			.width = texw,
+			.height = texh,
+			.planes = { nv12, nv12 + texw * texh },
+			.strides = { texw, texw },
+		};
+
+		/* there is no separate chroma sampling to emulate, both
+		 * NV12 modes come out the same:
+		 */
+		gl.rgb = malloc(texw * texh * 4);
+		if (!gl.rgb) {
+			printf("failed to allocate texture\n");
+			return NULL;
+		}
+		yuv_to_xrgb(&img, YUV_BT601, YUV_LIMITED, (uint8_t *)gl.rgb,
+					texw * 4, NULL);
+		swrender_texture(gl.sw, gl.rgb, texw, texh, DRM_FORMAT_XRGB8888);
+	}
+
+	printf("Rendering in software, %ux%u tiles on %u threads\n",
+		   SW_TILE_SIZE, SW_TILE_SIZE, swrender_threads(gl.sw));
+
+	gl.egl.draw = draw_cube_software;
+
+	return &gl.egl;
+}
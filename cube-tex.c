@@ -22,18 +22,30 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <linux/dma-buf.h>
+#include <xf86drm.h>
 
 #include "common.h"
 #include "esUtil.h"
+#include "frames.h"
+#include "geometry.h"
+#include "objects.h"
+#include "pattern.h"
+#include "threadpool.h"
 
 
 struct {
 	struct egl egl;
 
 	GLfloat aspect;
+	ESMatrix projection;
+	struct objects *objects;
 	enum mode mode;
 	const struct gbm *gbm;
 
@@ -41,9 +53,7 @@ struct {
 	/* uniform handles: */
 	GLint modelviewmatrix, modelviewprojectionmatrix, normalmatrix;
 	GLint texture, textureuv;
-	GLuint vbo;
-	GLuint positionsoffset, texcoordsoffset, normalsoffset;
-	GLuint tex[2];
+	struct geometry geometry;
 } gl;
 
 const struct egl *egl = &gl.egl;
@@ -211,235 +221,281 @@ static const char *fragment_shader_source_2img =
 		"    gl_FragColor = vVaryingColor * (yuv * csc);\n"
 		"}                                              \n";
 
-static const uint32_t texw = 512, texh = 512;
+/* the same for plain textures filled with glTexSubImage2D(), chroma being
+ * uploaded as luminance-alpha:
+ */
+static const char *fragment_shader_source_1img_2d =
+		"precision mediump float;           \n"
+		"                                   \n"
+		"uniform sampler2D uTex;            \n"
+		"                                   \n"
+		"varying vec4 vVaryingColor;        \n"
+		"varying vec2 vTexCoord;            \n"
+		"                                   \n"
+		"void main()                        \n"
+		"{                                  \n"
+		"    gl_FragColor = vVaryingColor * texture2D(uTex, vTexCoord);\n"
+		"}                                  \n";
 
-static int get_fd_rgba(uint32_t *pstride)
-{
-	struct gbm_bo *bo;
-	void *map_data = NULL;
-	uint32_t stride;
-	extern const uint32_t raw_512x512_rgba[];
-	uint8_t *map, *src = (uint8_t *)raw_512x512_rgba;
-	int fd;
+static const char *fragment_shader_source_2img_2d =
+		"precision mediump float;                       \n"
+		"                                               \n"
+		"uniform sampler2D uTexY;                       \n"
+		"uniform sampler2D uTexUV;                      \n"
+		"                                               \n"
+		"varying vec4 vVaryingColor;                    \n"
+		"varying vec2 vTexCoord;                        \n"
+		"                                               \n"
+		"mat4 csc = mat4(1.0,  0.0,    1.402, -0.701,   \n"
+		"                1.0, -0.344, -0.714,  0.529,   \n"
+		"                1.0,  1.772,  0.0,   -0.886,   \n"
+		"                0.0,  0.0,    0.0,    0.0);    \n"
+		"                                               \n"
+		"void main()                                    \n"
+		"{                                              \n"
+		"    vec4 yuv;                                  \n"
+		"    yuv.x  = texture2D(uTexY,  vTexCoord).x;   \n"
+		"    yuv.yz = texture2D(uTexUV, vTexCoord).xw;  \n"
+		"    yuv.w  = 1.0;                              \n"
+		"    gl_FragColor = vVaryingColor * (yuv * csc);\n"
+		"}                                              \n";
 
-	/* NOTE: do not actually use GBM_BO_USE_WRITE since that gets us a dumb buffer: */
-	bo = gbm_bo_create(gl.gbm->dev, texw, texh, GBM_FORMAT_ABGR8888, GBM_BO_USE_LINEAR);
+/* buffers frames are copied into; a single one for the built-in image,
+ * and a ring when updating every frame so the copy doesn't wait on the
+ * GPU still sampling the last frames:
+ */
+#define NUM_TEX_SLOTS 4
+
+struct tex_slot {
+	/* RGBA, or Y and UV: */
+	struct gbm_bo *bo[2];
+	int fd[2];
+	uint32_t stride[2];
+	uint8_t *map[2];        /* persistent dmabuf mapping */
+	void *map_data[2];      /* gbm_bo_map() */
+	GLuint tex[2];
+};
 
-	map = gbm_bo_map(bo, 0, 0, texw, texh, GBM_BO_TRANSFER_WRITE, &stride, &map_data);
+static struct {
+	enum tex_upload upload;
+	struct frames *frames;
+	struct frames *builtin;         /* without --frames or --pattern */
+	enum frame_format format;
+	uint32_t width, height;
+	unsigned planes;
+	size_t frame_size;
+	GLenum target;
+
+	struct tex_slot slots[NUM_TEX_SLOTS];
+	unsigned num_slots, cur;
+
+	/* frames synthesized when not streaming from a file, and planes
+	 * generated or I420 chroma interleaved for glTexSubImage2D():
+	 */
+	uint8_t *synth, *staging[2];
+	unsigned synth_frame;
+
+	/* --pattern, generated straight into the buffers: */
+	int pattern;
+	unsigned pattern_frame;
+	struct threadpool *pool;
+
+	int64_t upload_ns;
+	unsigned uploads;
+} tex;
+
+enum tex_upload tex_upload = UPLOAD_NONE;
+struct tex_pattern tex_pattern = { .pattern = -1 };
+
+static const char *upload_names[] = {
+	[UPLOAD_NONE]        = "none",
+	[UPLOAD_MAP]         = "map",
+	[UPLOAD_SUBIMAGE]    = "subimage",
+	[UPLOAD_DMABUF_SYNC] = "dmabuf-sync",
+	[UPLOAD_REIMPORT]    = "reimport",
+};
 
-	for (uint32_t i = 0; i < texh; i++) {
-		memcpy(&map[stride * i], &src[texw * 4 * i], texw * 4);
+int parse_tex_upload(const char *name)
+{
+	for (unsigned i = UPLOAD_MAP; i < sizeof(upload_names) / sizeof(upload_names[0]); i++) {
+		if (strcmp(name, upload_names[i]) == 0)
+			return i;
 	}
-
-	gbm_bo_unmap(bo, map_data);
-
-	fd = gbm_bo_get_fd(bo);
-
-	/* we have the fd now, no longer need the bo: */
-	gbm_bo_destroy(bo);
-
-	*pstride = stride;
-
-	return fd;
+	return -1;
 }
 
-static int get_fd_y(uint32_t *pstride)
+static uint32_t plane_width(unsigned p)
 {
-	struct gbm_bo *bo;
-	void *map_data = NULL;
-	uint32_t stride;
-	extern const uint32_t raw_512x512_nv12[];
-	uint8_t *map, *src = (uint8_t *)raw_512x512_nv12;
-	int fd;
-
-	/* NOTE: do not actually use GBM_BO_USE_WRITE since that gets us a dumb buffer: */
-	bo = gbm_bo_create(gl.gbm->dev, texw, texh, GBM_FORMAT_R8, GBM_BO_USE_LINEAR);
+	return p ? tex.width / 2 : tex.width;
+}
 
-	map = gbm_bo_map(bo, 0, 0, texw, texh, GBM_BO_TRANSFER_WRITE, &stride, &map_data);
+static uint32_t plane_height(unsigned p)
+{
+	return p ? tex.height / 2 : tex.height;
+}
 
-	for (uint32_t i = 0; i < texh; i++) {
-		memcpy(&map[stride * i], &src[texw * i], texw);
+/* bytes per pixel: */
+static uint32_t plane_cpp(unsigned p)
+{
+	switch (tex.format) {
+	case FRAME_RGBA:
+		return 4;
+	case FRAME_P010:
+		return 2 * (p + 1);
+	default:
+		return p + 1;
 	}
+}
 
-	gbm_bo_unmap(bo, map_data);
+static uint32_t plane_fourcc(unsigned p)
+{
+	switch (tex.format) {
+	case FRAME_RGBA:
+		return DRM_FORMAT_ABGR8888;
+	case FRAME_P010:
+		return p ? DRM_FORMAT_GR1616 : DRM_FORMAT_R16;
+	default:
+		return p ? DRM_FORMAT_GR88 : DRM_FORMAT_R8;
+	}
+}
 
-	fd = gbm_bo_get_fd(bo);
+static GLenum plane_gl_format(unsigned p)
+{
+	if (tex.format == FRAME_RGBA)
+		return GL_RGBA;
+	return p ? GL_LUMINANCE_ALPHA : GL_LUMINANCE;
+}
 
-	/* we have the fd now, no longer need the bo: */
-	gbm_bo_destroy(bo);
+static const uint8_t * builtin_frame(void)
+{
+	/* a single frame, so always the same one: */
+	return frames_next(tex.builtin);
+}
 
-	*pstride = stride;
+/* Without a file, simulate a camera feed by scrolling the built-in image
+ * up by two rows a frame:
+ */
+static const uint8_t * next_synth_frame(void)
+{
+	const uint8_t *src = builtin_frame();
+	uint8_t *dst = tex.synth;
+	uint32_t rows = (tex.synth_frame++ * 2) % tex.height;
+
+	for (unsigned p = 0; p < tex.planes; p++) {
+		size_t pitch = plane_width(p) * plane_cpp(p);
+		size_t size = pitch * plane_height(p);
+		size_t shift = pitch * (p ? rows / 2 : rows);
+
+		memcpy(dst, src + shift, size - shift);
+		memcpy(dst + size - shift, src, shift);
+		src += size;
+		dst += size;
+	}
 
-	return fd;
+	return tex.synth;
 }
 
-static int get_fd_uv(uint32_t *pstride)
+static void set_tex_params(GLenum target)
 {
-	struct gbm_bo *bo;
-	void *map_data = NULL;
-	uint32_t stride;
-	extern const uint32_t raw_512x512_nv12[];
-	uint8_t *map, *src = &((uint8_t *)raw_512x512_nv12)[texw * texh];
-	int fd;
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
 
-	/* NOTE: do not actually use GBM_BO_USE_WRITE since that gets us a dumb buffer: */
-	bo = gbm_bo_create(gl.gbm->dev, texw/2, texh/2, GBM_FORMAT_GR88, GBM_BO_USE_LINEAR);
+/* binds the image to *t, creating the texture the first time: */
+static int import_tex(const EGLint *attr, GLuint *t)
+{
+	EGLImage img;
 
-	map = gbm_bo_map(bo, 0, 0, texw/2, texh/2, GBM_BO_TRANSFER_WRITE, &stride, &map_data);
+	img = egl->eglCreateImageKHR(egl->display, EGL_NO_CONTEXT,
+			EGL_LINUX_DMA_BUF_EXT, NULL, attr);
+	if (img == EGL_NO_IMAGE_KHR)
+		return -1;
 
-	for (uint32_t i = 0; i < texh/2; i++) {
-		memcpy(&map[stride * i], &src[texw * i], texw);
+	if (!*t) {
+		glGenTextures(1, t);
+		glBindTexture(GL_TEXTURE_EXTERNAL_OES, *t);
+		set_tex_params(GL_TEXTURE_EXTERNAL_OES);
+	} else {
+		glBindTexture(GL_TEXTURE_EXTERNAL_OES, *t);
 	}
+	egl->glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, img);
 
-	gbm_bo_unmap(bo, map_data);
-
-	fd = gbm_bo_get_fd(bo);
-
-	/* we have the fd now, no longer need the bo: */
-	gbm_bo_destroy(bo);
-
-	*pstride = stride;
+	egl->eglDestroyImageKHR(egl->display, img);
 
-	return fd;
+	return 0;
 }
 
-static int init_tex_rgba(void)
+static int import_tex_rgba(struct tex_slot *slot)
 {
-	uint32_t stride;
-	int fd = get_fd_rgba(&stride);
 	const EGLint attr[] = {
-		EGL_WIDTH, texw,
-		EGL_HEIGHT, texh,
+		EGL_WIDTH, tex.width,
+		EGL_HEIGHT, tex.height,
 		EGL_LINUX_DRM_FOURCC_EXT, DRM_FORMAT_ABGR8888,
-		EGL_DMA_BUF_PLANE0_FD_EXT, fd,
+		EGL_DMA_BUF_PLANE0_FD_EXT, slot->fd[0],
 		EGL_DMA_BUF_PLANE0_OFFSET_EXT, 0,
-		EGL_DMA_BUF_PLANE0_PITCH_EXT, stride,
+		EGL_DMA_BUF_PLANE0_PITCH_EXT, slot->stride[0],
 		EGL_NONE
 	};
-	EGLImage img;
-
-	glGenTextures(1, gl.tex);
 
-	img = egl->eglCreateImageKHR(egl->display, EGL_NO_CONTEXT,
-			EGL_LINUX_DMA_BUF_EXT, NULL, attr);
-	assert(img);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_EXTERNAL_OES, gl.tex[0]);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	egl->glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, img);
-
-	egl->eglDestroyImageKHR(egl->display, img);
-
-	return 0;
+	return import_tex(attr, &slot->tex[0]);
 }
 
-static int init_tex_nv12_2img(void)
+static int import_tex_nv12_2img(struct tex_slot *slot)
 {
-	uint32_t stride_y, stride_uv;
-	int fd_y = get_fd_y(&stride_y);
-	int fd_uv = get_fd_uv(&stride_uv);
 	const EGLint attr_y[] = {
-		EGL_WIDTH, texw,
-		EGL_HEIGHT, texh,
-		EGL_LINUX_DRM_FOURCC_EXT, DRM_FORMAT_R8,
-		EGL_DMA_BUF_PLANE0_FD_EXT, fd_y,
+		EGL_WIDTH, tex.width,
+		EGL_HEIGHT, tex.height,
+		EGL_LINUX_DRM_FOURCC_EXT, plane_fourcc(0),
+		EGL_DMA_BUF_PLANE0_FD_EXT, slot->fd[0],
 		EGL_DMA_BUF_PLANE0_OFFSET_EXT, 0,
-		EGL_DMA_BUF_PLANE0_PITCH_EXT, stride_y,
+		EGL_DMA_BUF_PLANE0_PITCH_EXT, slot->stride[0],
 		EGL_NONE
 	};
 	const EGLint attr_uv[] = {
-		EGL_WIDTH, texw/2,
-		EGL_HEIGHT, texh/2,
-		EGL_LINUX_DRM_FOURCC_EXT, DRM_FORMAT_GR88,
-		EGL_DMA_BUF_PLANE0_FD_EXT, fd_uv,
+		EGL_WIDTH, tex.width/2,
+		EGL_HEIGHT, tex.height/2,
+		EGL_LINUX_DRM_FOURCC_EXT, plane_fourcc(1),
+		EGL_DMA_BUF_PLANE0_FD_EXT, slot->fd[1],
 		EGL_DMA_BUF_PLANE0_OFFSET_EXT, 0,
-		EGL_DMA_BUF_PLANE0_PITCH_EXT, stride_uv,
+		EGL_DMA_BUF_PLANE0_PITCH_EXT, slot->stride[1],
 		EGL_NONE
 	};
-	EGLImage img_y, img_uv;
-
-	glGenTextures(2, gl.tex);
-
-	/* Y plane texture: */
-	img_y = egl->eglCreateImageKHR(egl->display, EGL_NO_CONTEXT,
-			EGL_LINUX_DMA_BUF_EXT, NULL, attr_y);
-	assert(img_y);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_EXTERNAL_OES, gl.tex[0]);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	egl->glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, img_y);
-
-	egl->eglDestroyImageKHR(egl->display, img_y);
-
-	/* UV plane texture: */
-	img_uv = egl->eglCreateImageKHR(egl->display, EGL_NO_CONTEXT,
-			EGL_LINUX_DMA_BUF_EXT, NULL, attr_uv);
-	assert(img_uv);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_EXTERNAL_OES, gl.tex[1]);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	egl->glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, img_uv);
-
-	egl->eglDestroyImageKHR(egl->display, img_uv);
 
-	return 0;
+	/* Y plane texture, then UV plane texture: */
+	return import_tex(attr_y, &slot->tex[0]) ||
+		import_tex(attr_uv, &slot->tex[1]);
 }
 
-static int init_tex_nv12_1img(void)
+static int import_tex_nv12_1img(struct tex_slot *slot)
 {
-	uint32_t stride_y, stride_uv;
-	int fd_y = get_fd_y(&stride_y);
-	int fd_uv = get_fd_uv(&stride_uv);
 	const EGLint attr[] = {
-		EGL_WIDTH, texw,
-		EGL_HEIGHT, texh,
-		EGL_LINUX_DRM_FOURCC_EXT, DRM_FORMAT_NV12,
-		EGL_DMA_BUF_PLANE0_FD_EXT, fd_y,
+		EGL_WIDTH, tex.width,
+		EGL_HEIGHT, tex.height,
+		EGL_LINUX_DRM_FOURCC_EXT, (tex.format == FRAME_P010) ?
+				DRM_FORMAT_P010 : DRM_FORMAT_NV12,
+		EGL_DMA_BUF_PLANE0_FD_EXT, slot->fd[0],
 		EGL_DMA_BUF_PLANE0_OFFSET_EXT, 0,
-		EGL_DMA_BUF_PLANE0_PITCH_EXT, stride_y,
-		EGL_DMA_BUF_PLANE1_FD_EXT, fd_uv,
+		EGL_DMA_BUF_PLANE0_PITCH_EXT, slot->stride[0],
+		EGL_DMA_BUF_PLANE1_FD_EXT, slot->fd[1],
 		EGL_DMA_BUF_PLANE1_OFFSET_EXT, 0,
-		EGL_DMA_BUF_PLANE1_PITCH_EXT, stride_uv,
+		EGL_DMA_BUF_PLANE1_PITCH_EXT, slot->stride[1],
 		EGL_NONE
 	};
-	EGLImage img;
-
-	glGenTextures(1, gl.tex);
-
-	img = egl->eglCreateImageKHR(egl->display, EGL_NO_CONTEXT,
-			EGL_LINUX_DMA_BUF_EXT, NULL, attr);
-	assert(img);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_EXTERNAL_OES, gl.tex[0]);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	egl->glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, img);
 
-	egl->eglDestroyImageKHR(egl->display, img);
-
-	return 0;
+	return import_tex(attr, &slot->tex[0]);
 }
 
-static int init_tex(enum mode mode)
+static int import_slot(enum mode mode, struct tex_slot *slot)
 {
 	switch (mode) {
 	case RGBA:
-		return init_tex_rgba();
+		return import_tex_rgba(slot);
 	case NV12_2IMG:
-		return init_tex_nv12_2img();
+		return import_tex_nv12_2img(slot);
 	case NV12_1IMG:
-		return init_tex_nv12_1img();
+		return import_tex_nv12_1img(slot);
 	case SMOOTH:
 	case VIDEO:
 		assert(!"unreachable");
@@ -448,27 +504,359 @@ static int init_tex(enum mode mode)
 	return -1;
 }
 
-static void draw_cube_tex(unsigned i)
+static int init_slot_buffers(struct tex_slot *slot)
 {
+	for (unsigned p = 0; p < tex.planes; p++) {
+		/* NOTE: do not actually use GBM_BO_USE_WRITE since that gets us a dumb buffer: */
+		slot->bo[p] = gbm_bo_create(gl.gbm->dev, plane_width(p), plane_height(p),
+				plane_fourcc(p), GBM_BO_USE_LINEAR);
+		if (!slot->bo[p])
+			return -1;
+
+		slot->fd[p] = gbm_bo_get_fd(slot->bo[p]);
+		slot->stride[p] = gbm_bo_get_stride(slot->bo[p]);
+		if (slot->fd[p] < 0)
+			return -1;
+
+		if (tex.upload != UPLOAD_DMABUF_SYNC && tex.upload != UPLOAD_REIMPORT)
+			continue;
+
+		slot->map[p] = mmap(NULL, slot->stride[p] * plane_height(p),
+				PROT_READ | PROT_WRITE, MAP_SHARED, slot->fd[p], 0);
+		if (slot->map[p] == MAP_FAILED) {
+			printf("could not map dmabuf: %s\n", strerror(errno));
+			slot->map[p] = NULL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int init_slot_textures(struct tex_slot *slot)
+{
+	for (unsigned p = 0; p < tex.planes; p++) {
+		GLenum format = plane_gl_format(p);
+
+		glGenTextures(1, &slot->tex[p]);
+		glBindTexture(GL_TEXTURE_2D, slot->tex[p]);
+		set_tex_params(GL_TEXTURE_2D);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, plane_width(p), plane_height(p),
+				0, format, GL_UNSIGNED_BYTE, NULL);
+	}
+
+	return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+static int init_slot(enum mode mode, struct tex_slot *slot)
+{
+	int ret;
+
+	if (tex.upload == UPLOAD_SUBIMAGE)
+		return init_slot_textures(slot);
+
+	ret = init_slot_buffers(slot) || import_slot(mode, slot);
+
+	/* only the persistent mappings need the dmabufs past the import: */
+	if (!slot->map[0]) {
+		for (unsigned p = 0; p < tex.planes; p++) {
+			if (slot->fd[p] >= 0)
+				close(slot->fd[p]);
+			slot->fd[p] = -1;
+		}
+	}
+
+	return ret;
+}
+
+static void tex_subimage(const struct tex_slot *slot, unsigned p, const void *src)
+{
+	GLenum format = plane_gl_format(p);
+
+	glBindTexture(GL_TEXTURE_2D, slot->tex[p]);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane_width(p), plane_height(p),
+			format, GL_UNSIGNED_BYTE, src);
+}
+
+static int dmabuf_sync(const struct tex_slot *slot, unsigned p, uint64_t flags)
+{
+	struct dma_buf_sync sync = { .flags = flags | DMA_BUF_SYNC_WRITE };
+
+	return drmIoctl(slot->fd[p], DMA_BUF_IOCTL_SYNC, &sync);
+}
+
+/* CPU access to plane p of a slot, until end_write(): */
+static uint8_t * begin_write(struct tex_slot *slot, unsigned p, uint32_t *stride)
+{
+	switch (tex.upload) {
+	case UPLOAD_SUBIMAGE:
+		*stride = plane_width(p) * plane_cpp(p);
+		return tex.staging[p];
+	case UPLOAD_DMABUF_SYNC:
+	case UPLOAD_REIMPORT:
+		/* waits for the GPU to finish reading the buffer, and
+		 * makes the mapping coherent where it needs to be:
+		 */
+		if (dmabuf_sync(slot, p, DMA_BUF_SYNC_START))
+			return NULL;
+		*stride = slot->stride[p];
+		return slot->map[p];
+	default:
+		return gbm_bo_map(slot->bo[p], 0, 0, plane_width(p), plane_height(p),
+				GBM_BO_TRANSFER_WRITE, stride, &slot->map_data[p]);
+	}
+}
+
+static void end_write(struct tex_slot *slot, unsigned p)
+{
+	switch (tex.upload) {
+	case UPLOAD_SUBIMAGE:
+		tex_subimage(slot, p, tex.staging[p]);
+		break;
+	case UPLOAD_DMABUF_SYNC:
+	case UPLOAD_REIMPORT:
+		dmabuf_sync(slot, p, DMA_BUF_SYNC_END);
+		break;
+	default:
+		gbm_bo_unmap(slot->bo[p], slot->map_data[p]);
+		break;
+	}
+}
+
+static int upload_plane(struct tex_slot *slot, unsigned p, const uint8_t *src)
+{
+	uint32_t pitch = plane_width(p) * plane_cpp(p);
+	uint32_t stride;
+	uint8_t *map;
+
+	/* packed rows go to GL as they are: */
+	if (tex.upload == UPLOAD_SUBIMAGE) {
+		tex_subimage(slot, p, src);
+		return 0;
+	}
+
+	map = begin_write(slot, p, &stride);
+	if (!map)
+		return -1;
+
+	for (uint32_t i = 0; i < plane_height(p); i++) {
+		memcpy(&map[stride * i], &src[pitch * i], pitch);
+	}
+
+	end_write(slot, p);
+
+	return 0;
+}
+
+/* I420 goes into the same Y and UV textures as NV12, interleaving the
+ * chroma planes on the way:
+ */
+static int upload_chroma(struct tex_slot *slot, const uint8_t *u, const uint8_t *v)
+{
+	uint32_t width = plane_width(1), height = plane_height(1);
+	uint32_t stride;
+	uint8_t *map;
+
+	map = begin_write(slot, 1, &stride);
+	if (!map)
+		return -1;
+
+	for (uint32_t i = 0; i < height; i++) {
+		uint8_t *dst = &map[stride * i];
+
+		for (uint32_t j = 0; j < width; j++) {
+			dst[2 * j + 0] = u[width * i + j];
+			dst[2 * j + 1] = v[width * i + j];
+		}
+	}
+
+	end_write(slot, 1);
+
+	return 0;
+}
+
+static int upload_frame(struct tex_slot *slot, const uint8_t *src)
+{
+	const uint32_t w = tex.width, h = tex.height;
+	int ret = -1;
+
+	switch (tex.format) {
+	case FRAME_RGBA:
+		ret = upload_plane(slot, 0, src);
+		break;
+	case FRAME_NV12:
+		ret = upload_plane(slot, 0, src) ||
+			upload_plane(slot, 1, &src[w * h]);
+		break;
+	case FRAME_I420:
+		ret = upload_plane(slot, 0, src) ||
+			upload_chroma(slot, &src[w * h], &src[w * h + w * h / 4]);
+		break;
+	case FRAME_P010:
+		ret = upload_plane(slot, 0, src) ||
+			upload_plane(slot, 1, &src[w * h * 2]);
+		break;
+	}
+
+	/* as when a camera hands over a new buffer for every frame: */
+	if (!ret && tex.upload == UPLOAD_REIMPORT)
+		ret = import_slot(gl.mode, slot);
+
+	return ret;
+}
+
+/* Generates the next pattern frame straight into the slot's planes: */
+static int generate_frame(struct tex_slot *slot)
+{
+	struct pattern_image dst = {
+		.format = tex.format,
+		.width = tex.width,
+		.height = tex.height,
+	};
+	/* what the shader, or EGL's default for nv12-1img, converts back: */
+	enum yuv_range range = (gl.mode == NV12_2IMG) ? YUV_FULL : YUV_LIMITED;
+	int ret = 0;
+
+	for (unsigned p = 0; p < tex.planes; p++) {
+		dst.planes[p] = begin_write(slot, p, &dst.strides[p]);
+		if (!dst.planes[p])
+			ret = -1;
+	}
+
+	if (!ret)
+		pattern_fill(tex.pattern, &dst, YUV_BT601, range,
+				tex.pattern_frame++, tex.pool);
+
+	for (unsigned p = 0; p < tex.planes; p++) {
+		if (dst.planes[p])
+			end_write(slot, p);
+	}
+
+	if (!ret && tex.upload == UPLOAD_REIMPORT)
+		ret = import_slot(gl.mode, slot);
+
+	return ret;
+}
+
+static int init_tex(enum mode mode)
+{
+	tex.planes = (tex.format == FRAME_RGBA) ? 1 : 2;
+	tex.frame_size = 0;
+	for (unsigned p = 0; p < tex.planes; p++)
+		tex.frame_size += (size_t)plane_width(p) * plane_height(p) * plane_cpp(p);
+	tex.num_slots = (tex.upload == UPLOAD_NONE) ? 1 : NUM_TEX_SLOTS;
+
+	if (tex.upload == UPLOAD_SUBIMAGE) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (unsigned p = 0; p < tex.planes; p++) {
+			if (tex.pattern < 0 && (p == 0 || tex.format != FRAME_I420))
+				continue;
+			tex.staging[p] = malloc(plane_width(p) * plane_height(p) * plane_cpp(p));
+			if (!tex.staging[p])
+				return -1;
+		}
+	}
+
+	if (tex.pattern >= 0) {
+		tex.pool = threadpool_create(0);
+		if (!tex.pool)
+			return -1;
+	} else if (!tex.frames && tex.upload != UPLOAD_NONE) {
+		tex.synth = malloc(tex.frame_size);
+		if (!tex.synth)
+			return -1;
+	}
+
+	for (unsigned i = 0; i < tex.num_slots; i++) {
+		tex.slots[i].fd[0] = tex.slots[i].fd[1] = -1;
+		if (init_slot(mode, &tex.slots[i]))
+			return -1;
+	}
+
+	/* the rest are uploaded as they are drawn: */
+	if (tex.upload == UPLOAD_NONE)
+		return upload_frame(&tex.slots[0], builtin_frame());
+
+	return 0;
+}
+
+static void update_cube_tex(void)
+{
+	int64_t start;
+	int ret;
+
+	if (tex.pattern >= 0) {
+		start = get_time_ns();
+		tex.cur = (tex.cur + 1) % tex.num_slots;
+		ret = generate_frame(&tex.slots[tex.cur]);
+	} else {
+		const uint8_t *src = tex.frames ? frames_next(tex.frames) : next_synth_frame();
+
+		start = get_time_ns();
+		tex.cur = (tex.cur + 1) % tex.num_slots;
+		ret = upload_frame(&tex.slots[tex.cur], src);
+	}
+	if (ret)
+		printf("failed to upload frame\n");
+
+	tex.upload_ns += get_time_ns() - start;
+	if (++tex.uploads < 120)
+		return;
+
+	if (tex.pattern >= 0)
+		printf("%s %ux%u %s, ", pattern_name(tex.pattern), tex.width,
+				tex.height, frames_format_name(tex.format));
+	printf("upload (%s): %.3f ms per frame, %.0f MB/s",
+			upload_names[tex.upload],
+			(double)tex.upload_ns / tex.uploads / 1000000.0,
+			(double)tex.frame_size * tex.uploads * 1000.0 / tex.upload_ns);
+	if (tex.frames)
+		printf(", %u readahead stalls", tex.frames->stalls);
+	printf("\n");
+
+	tex.upload_ns = 0;
+	tex.uploads = 0;
+}
+
+static void draw_cube_geometry(void)
+{
+	draw_geometry(&gl.geometry);
+}
+
+static void draw_cube_tex(float t)
+{
+	const struct tex_slot *slot = &tex.slots[tex.cur];
 	ESMatrix modelview;
 
 	/* clear the color buffer */
 	glClearColor(0.5, 0.5, 0.5, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT);
 
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(tex.target, slot->tex[0]);
+	glUniform1i(gl.texture, 0); /* '0' refers to texture unit 0. */
+
+	if (gl.mode == NV12_2IMG) {
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(tex.target, slot->tex[1]);
+		glUniform1i(gl.textureuv, 1);
+	}
+
+	if (gl.objects) {
+		draw_objects(gl.objects, t, gl.modelviewmatrix,
+					 gl.modelviewprojectionmatrix, gl.normalmatrix,
+					 draw_cube_geometry);
+		return;
+	}
+
 	esMatrixLoadIdentity(&modelview);
 	esTranslate(&modelview, 0.0f, 0.0f, -8.0f);
-	esRotate(&modelview, 45.0f + (0.25f * i), 1.0f, 0.0f, 0.0f);
-	esRotate(&modelview, 45.0f - (0.5f * i), 0.0f, 1.0f, 0.0f);
-	esRotate(&modelview, 10.0f + (0.15f * i), 0.0f, 0.0f, 1.0f);
-
-	ESMatrix projection;
-	esMatrixLoadIdentity(&projection);
-	esFrustum(&projection, -2.8f, +2.8f, -2.8f * gl.aspect, +2.8f * gl.aspect, 6.0f, 10.0f);
+	esRotate(&modelview, 45.0f + (0.25f * t), 1.0f, 0.0f, 0.0f);
+	esRotate(&modelview, 45.0f - (0.5f * t), 0.0f, 1.0f, 0.0f);
+	esRotate(&modelview, 10.0f + (0.15f * t), 0.0f, 0.0f, 1.0f);
 
 	ESMatrix modelviewprojection;
-	esMatrixLoadIdentity(&modelviewprojection);
-	esMatrixMultiply(&modelviewprojection, &modelview, &projection);
+	esMatrixMultiply(&modelviewprojection, &modelview, &gl.projection);
 
 	float normal[9];
 	normal[0] = modelview.m[0][0];
@@ -484,23 +872,32 @@ static void draw_cube_tex(unsigned i)
 	glUniformMatrix4fv(gl.modelviewmatrix, 1, GL_FALSE, &modelview.m[0][0]);
 	glUniformMatrix4fv(gl.modelviewprojectionmatrix, 1, GL_FALSE, &modelviewprojection.m[0][0]);
 	glUniformMatrix3fv(gl.normalmatrix, 1, GL_FALSE, normal);
-	glUniform1i(gl.texture, 0); /* '0' refers to texture unit 0. */
 
-	if (gl.mode == NV12_2IMG)
-		glUniform1i(gl.textureuv, 1);
+	draw_cube_geometry();
+}
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 4, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 8, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 12, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 16, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 20, 4);
+/* the projection only depends on the aspect ratio: */
+static void set_aspect(float aspect)
+{
+	gl.aspect = aspect;
+	set_projection(&gl.projection, 2.8f, aspect);
 }
 
-const struct egl * init_cube_tex(const struct surfmgr *surfmgr, enum mode mode)
+static const struct program_attrib program_attribs[] = {
+	{ 0, "in_position" },
+	{ 1, "in_normal" },
+	{ 2, "in_TexCoord" },
+};
+
+const struct egl * init_cube_tex(const struct surfmgr *surfmgr, enum mode mode,
+		struct frames *frames)
 {
-	const char *fragment_shader_source = (mode == NV12_2IMG) ?
-			fragment_shader_source_2img : fragment_shader_source_1img;
+	const char *fragment_shader_source;
+	const struct geometry_attrib attribs[] = {
+		{ 0, ATTRIB_POSITION, vVertices },
+		{ 1, ATTRIB_NORMAL, vNormals },
+		{ 2, ATTRIB_TEXCOORD, vTexCoords },
+	};
 	int ret;
 
 	if (!surfmgr->gbm) {
@@ -508,6 +905,59 @@ const struct egl * init_cube_tex(const struct surfmgr *surfmgr, enum mode mode)
 		return NULL;
 	}
 
+	tex.pattern = tex_pattern.pattern;
+	if (frames) {
+		tex.frames = frames;
+		tex.format = frames->format;
+		tex.width = frames->width;
+		tex.height = frames->height;
+		tex.upload = (tex_upload == UPLOAD_NONE) ? UPLOAD_MAP : tex_upload;
+	} else if (tex.pattern >= 0) {
+		/* I420 goes into the same Y and UV buffers as NV12: */
+		tex.format = (tex_pattern.format == FRAME_I420) ?
+				FRAME_NV12 : tex_pattern.format;
+		tex.width = tex_pattern.width ? tex_pattern.width : (uint32_t)surfmgr->width;
+		tex.height = tex_pattern.height ? tex_pattern.height : (uint32_t)surfmgr->height;
+		if (tex.format != FRAME_RGBA) {
+			tex.width &= ~1;
+			tex.height &= ~1;
+		}
+		tex.upload = (tex_upload == UPLOAD_NONE) ? UPLOAD_MAP : tex_upload;
+	} else {
+		tex.format = (mode == RGBA) ? FRAME_RGBA : FRAME_NV12;
+		tex.width = tex.height = 512;
+		tex.upload = tex_upload;
+		tex.builtin = frames_open_builtin(tex.format);
+		if (!tex.builtin) {
+			printf("failed to load the built-in image\n");
+			return NULL;
+		}
+	}
+
+	if ((tex.format == FRAME_RGBA) != (mode == RGBA)) {
+		printf("%s frames can't be drawn in this mode\n",
+				tex.format == FRAME_RGBA ? "RGBA" : "YUV");
+		return NULL;
+	}
+
+	if (tex.upload == UPLOAD_SUBIMAGE) {
+		if (mode == NV12_1IMG) {
+			printf("subimage uploads need a texture per plane, use nv12-2img\n");
+			return NULL;
+		}
+		if (tex.format == FRAME_P010) {
+			printf("subimage uploads can't do 16 bit planes, use map\n");
+			return NULL;
+		}
+		tex.target = GL_TEXTURE_2D;
+		fragment_shader_source = (mode == NV12_2IMG) ?
+				fragment_shader_source_2img_2d : fragment_shader_source_1img_2d;
+	} else {
+		tex.target = GL_TEXTURE_EXTERNAL_OES;
+		fragment_shader_source = (mode == NV12_2IMG) ?
+				fragment_shader_source_2img : fragment_shader_source_1img;
+	}
+
 	ret = init_egl(&gl.egl, surfmgr);
 	if (ret)
 		return NULL;
@@ -517,20 +967,23 @@ const struct egl * init_cube_tex(const struct surfmgr *surfmgr, enum mode mode)
 	    egl_check(&gl.egl, eglDestroyImageKHR))
 		return NULL;
 
-	gl.aspect = (GLfloat)(surfmgr->height) / (GLfloat)(surfmgr->width);
+	set_aspect((GLfloat)(surfmgr->height) / (GLfloat)(surfmgr->width));
+
+	if (num_objects > 1) {
+		gl.objects = init_objects(num_objects, 2.8f, gl.aspect, &gl.projection);
+		if (!gl.objects)
+			return NULL;
+	}
 	gl.mode = mode;
 	gl.gbm = surfmgr->gbm;
 
-	ret = create_program(vertex_shader_source, fragment_shader_source);
+	ret = create_program(vertex_shader_source, fragment_shader_source,
+			program_attribs, ARRAY_SIZE(program_attribs));
 	if (ret < 0)
 		return NULL;
 
 	gl.program = ret;
 
-	glBindAttribLocation(gl.program, 0, "in_position");
-	glBindAttribLocation(gl.program, 1, "in_normal");
-	glBindAttribLocation(gl.program, 2, "in_color");
-
 	ret = link_program(gl.program);
 	if (ret)
 		return NULL;
@@ -550,30 +1003,25 @@ const struct egl * init_cube_tex(const struct surfmgr *surfmgr, enum mode mode)
 	glViewport(0, 0, surfmgr->width, surfmgr->height);
 	glEnable(GL_CULL_FACE);
 
-	gl.positionsoffset = 0;
-	gl.texcoordsoffset = sizeof(vVertices);
-	gl.normalsoffset = sizeof(vVertices) + sizeof(vTexCoords);
-
-	glGenBuffers(1, &gl.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, gl.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vVertices) + sizeof(vTexCoords) + sizeof(vNormals), 0, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, gl.positionsoffset, sizeof(vVertices), &vVertices[0]);
-	glBufferSubData(GL_ARRAY_BUFFER, gl.texcoordsoffset, sizeof(vTexCoords), &vTexCoords[0]);
-	glBufferSubData(GL_ARRAY_BUFFER, gl.normalsoffset, sizeof(vNormals), &vNormals[0]);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(intptr_t)gl.positionsoffset);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(intptr_t)gl.normalsoffset);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)(intptr_t)gl.texcoordsoffset);
-	glEnableVertexAttribArray(2);
+	ret = init_geometry(&gl.geometry, &gl.egl, attribs, 3,
+						sizeof(vVertices) / sizeof(vVertices[0]) / 3);
+	if (ret) {
+		printf("failed to create cube geometry\n");
+		return NULL;
+	}
 
+	startup_begin(STARTUP_TEXTURES);
 	ret = init_tex(mode);
+	startup_end(STARTUP_TEXTURES);
 	if (ret) {
 		printf("failed to initialize EGLImage texture\n");
 		return NULL;
 	}
 
 	gl.egl.draw = draw_cube_tex;
+	gl.egl.set_aspect = set_aspect;
+	if (tex.upload != UPLOAD_NONE)
+		gl.egl.update = update_cube_tex;
 
 	return &gl.egl;
 }
@@ -28,13 +28,17 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "camera.h"
 #include "common.h"
 #include "esUtil.h"
+#include "objects.h"
 
 struct {
 	struct egl egl;
 
 	GLfloat aspect;
+	ESMatrix projection;
+	struct objects *objects;
 	const struct gbm *gbm;
 
 	GLuint program, blit_program;
@@ -45,10 +49,13 @@ struct {
 	GLuint positionsoffset, texcoordsoffset, normalsoffset;
 	GLuint tex;
 
-	/* video decoder: */
+#ifdef HAVE_GST
+	/* video decoder, unless the frames come from a camera: */
 	struct decoder *decoder;
 	int filenames_count, idx;
 	const char *filenames[32];
+#endif
+	EGLImage frame;
 
 	EGLSyncKHR last_fence;
 } gl;
@@ -220,7 +227,17 @@ static const char *fragment_shader_source =
 		"}                                  \n";
 
 
-static void draw_cube_video(unsigned i)
+static void draw_cube_geometry(void)
+{
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glDrawArrays(GL_TRIANGLE_STRIP, 4, 4);
+	glDrawArrays(GL_TRIANGLE_STRIP, 8, 4);
+	glDrawArrays(GL_TRIANGLE_STRIP, 12, 4);
+	glDrawArrays(GL_TRIANGLE_STRIP, 16, 4);
+	glDrawArrays(GL_TRIANGLE_STRIP, 20, 4);
+}
+
+static void draw_cube_video(float t)
 {
 	ESMatrix modelview;
 	EGLImage frame;
@@ -231,25 +248,39 @@ static void draw_cube_video(unsigned i)
 		gl.last_fence = NULL;
 	}
 
-	frame = video_frame(gl.decoder);
-	if (!frame) {
-		/* end of stream */
-		glDeleteTextures(1, &gl.tex);
-		glGenTextures(1, &gl.tex);
-		video_deinit(gl.decoder);
-		gl.idx = (gl.idx + 1) % gl.filenames_count;
-		gl.decoder = video_init(&gl.egl, gl.gbm, gl.filenames[gl.idx]);
+	if (camera_enabled) {
+		frame = camera_frame();
+	} else {
+#ifdef HAVE_GST
+		frame = video_frame(gl.decoder);
+		if (!frame) {
+			/* end of stream */
+			glDeleteTextures(1, &gl.tex);
+			glGenTextures(1, &gl.tex);
+			video_deinit(gl.decoder);
+			gl.idx = (gl.idx + 1) % gl.filenames_count;
+			gl.decoder = video_init(&gl.egl, gl.gbm, gl.filenames[gl.idx]);
+		}
+#else
+		frame = EGL_NO_IMAGE_KHR;
+#endif
 	}
 
 	glUseProgram(gl.blit_program);
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_EXTERNAL_OES, gl.tex);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	egl->glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, frame);
+	/* the camera's images are imported once, only rebind when a new
+	 * frame arrived:
+	 */
+	if (frame && (!camera_enabled || frame != gl.frame)) {
+		glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		egl->glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, frame);
+	}
+	gl.frame = frame;
 
 	/* clear the color buffer */
 	glClearColor(0.5, 0.5, 0.5, 1.0);
@@ -260,20 +291,23 @@ static void draw_cube_video(unsigned i)
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
 	glUseProgram(gl.program);
+	glUniform1i(gl.texture, 0); /* '0' refers to texture unit 0. */
+
+	if (gl.objects) {
+		draw_objects(gl.objects, t, gl.modelviewmatrix,
+					 gl.modelviewprojectionmatrix, gl.normalmatrix,
+					 draw_cube_geometry);
+		goto out;
+	}
 
 	esMatrixLoadIdentity(&modelview);
 	esTranslate(&modelview, 0.0f, 0.0f, -8.0f);
-	esRotate(&modelview, 45.0f + (0.25f * i), 1.0f, 0.0f, 0.0f);
-	esRotate(&modelview, 45.0f - (0.5f * i), 0.0f, 1.0f, 0.0f);
-	esRotate(&modelview, 10.0f + (0.15f * i), 0.0f, 0.0f, 1.0f);
-
-	ESMatrix projection;
-	esMatrixLoadIdentity(&projection);
-	esFrustum(&projection, -2.1f, +2.1f, -2.1f * gl.aspect, +2.1f * gl.aspect, 6.0f, 10.0f);
+	esRotate(&modelview, 45.0f + (0.25f * t), 1.0f, 0.0f, 0.0f);
+	esRotate(&modelview, 45.0f - (0.5f * t), 0.0f, 1.0f, 0.0f);
+	esRotate(&modelview, 10.0f + (0.15f * t), 0.0f, 0.0f, 1.0f);
 
 	ESMatrix modelviewprojection;
-	esMatrixLoadIdentity(&modelviewprojection);
-	esMatrixMultiply(&modelviewprojection, &modelview, &projection);
+	esMatrixMultiply(&modelviewprojection, &modelview, &gl.projection);
 
 	float normal[9];
 	normal[0] = modelview.m[0][0];
@@ -289,23 +323,35 @@ static void draw_cube_video(unsigned i)
 	glUniformMatrix4fv(gl.modelviewmatrix, 1, GL_FALSE, &modelview.m[0][0]);
 	glUniformMatrix4fv(gl.modelviewprojectionmatrix, 1, GL_FALSE, &modelviewprojection.m[0][0]);
 	glUniformMatrix3fv(gl.normalmatrix, 1, GL_FALSE, normal);
-	glUniform1i(gl.texture, 0); /* '0' refers to texture unit 0. */
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 4, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 8, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 12, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 16, 4);
-	glDrawArrays(GL_TRIANGLE_STRIP, 20, 4);
+	draw_cube_geometry();
 
+out:
 	gl.last_fence = egl->eglCreateSyncKHR(egl->display, EGL_SYNC_FENCE_KHR, NULL);
 }
 
+/* the projection only depends on the aspect ratio: */
+static void set_aspect(float aspect)
+{
+	gl.aspect = aspect;
+	set_projection(&gl.projection, 2.1f, aspect);
+}
+
+static const struct program_attrib blit_attribs[] = {
+	{ 0, "in_position" },
+	{ 1, "in_TexCoord" },
+};
+
+static const struct program_attrib program_attribs[] = {
+	{ 0, "in_position" },
+	{ 1, "in_TexCoord" },
+	{ 2, "in_normal" },
+};
+
 const struct egl * init_cube_video(const struct surfmgr *surfmgr,
-                                   const char *filenames)
+                                   const char *filenames, const char *camera)
 {
-	char *fnames, *s;
-	int ret, i = 0;
+	int ret;
 
 	if (!surfmgr->gbm) {
 		printf("video support currently requires GBM\n");
@@ -322,50 +368,68 @@ const struct egl * init_cube_video(const struct surfmgr *surfmgr,
 	    egl_check(egl, eglClientWaitSyncKHR))
 		return NULL;
 
-	fnames = strdup(filenames);
-	while ((s = strstr(fnames, ","))) {
+	if (camera) {
+		if (init_camera(&gl.egl, camera)) {
+			printf("cannot start camera capture\n");
+			return NULL;
+		}
+	} else {
+#ifdef HAVE_GST
+		char *fnames, *s;
+		int i = 0;
+
+		fnames = strdup(filenames);
+		while ((s = strstr(fnames, ","))) {
+			gl.filenames[i] = fnames;
+			s[0] = '\0';
+			fnames = &s[1];
+			i++;
+		}
 		gl.filenames[i] = fnames;
-		s[0] = '\0';
-		fnames = &s[1];
-		i++;
+		gl.filenames_count = ++i;
+
+		gl.decoder = video_init(&gl.egl, surfmgr->gbm, gl.filenames[gl.idx]);
+		if (!gl.decoder) {
+			printf("cannot create video decoder\n");
+			return NULL;
+		}
+#else
+		(void)filenames;
+		printf("no GStreamer support!\n");
+		return NULL;
+#endif
 	}
-	gl.filenames[i] = fnames;
-	gl.filenames_count = ++i;
 
-	gl.decoder = video_init(&gl.egl, surfmgr->gbm, gl.filenames[gl.idx]);
-	if (!gl.decoder) {
-		printf("cannot create video decoder\n");
-		return NULL;
+	set_aspect((GLfloat)(surfmgr->height) / (GLfloat)(surfmgr->width));
+
+	if (num_objects > 1) {
+		gl.objects = init_objects(num_objects, 2.1f, gl.aspect, &gl.projection);
+		if (!gl.objects)
+			return NULL;
 	}
 
-	gl.aspect = (GLfloat)(surfmgr->height) / (GLfloat)(surfmgr->width);
 	gl.gbm = surfmgr->gbm;
 
-	ret = create_program(blit_vs, blit_fs);
+	ret = create_program(blit_vs, blit_fs,
+			blit_attribs, ARRAY_SIZE(blit_attribs));
 	if (ret < 0)
 		return NULL;
 
 	gl.blit_program = ret;
 
-	glBindAttribLocation(gl.blit_program, 0, "in_position");
-	glBindAttribLocation(gl.blit_program, 1, "in_TexCoord");
-
 	ret = link_program(gl.blit_program);
 	if (ret)
 		return NULL;
 
 	gl.blit_texture = glGetUniformLocation(gl.blit_program, "uTex");
 
-	ret = create_program(vertex_shader_source, fragment_shader_source);
+	ret = create_program(vertex_shader_source, fragment_shader_source,
+			program_attribs, ARRAY_SIZE(program_attribs));
 	if (ret < 0)
 		return NULL;
 
 	gl.program = ret;
 
-	glBindAttribLocation(gl.program, 0, "in_position");
-	glBindAttribLocation(gl.program, 1, "in_TexCoord");
-	glBindAttribLocation(gl.program, 2, "in_normal");
-
 	ret = link_program(gl.program);
 	if (ret)
 		return NULL;
@@ -398,6 +462,7 @@ const struct egl * init_cube_video(const struct surfmgr *surfmgr,
 	glGenTextures(1, &gl.tex);
 
 	gl.egl.draw = draw_cube_video;
+	gl.egl.set_aspect = set_aspect;
 
 	return &gl.egl;
 }
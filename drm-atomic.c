@@ -23,6 +23,8 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <math.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -30,7 +32,10 @@
 
 #include "common.h"
 #include "drm-common.h"
+#include "probes.h"
 #include "surface-manager.h"
+#include "trace.h"
+#include "writeback.h"
 
 #define VOID2U64(x) ((uint64_t)(unsigned long)(x))
 
@@ -38,10 +43,90 @@ static struct drm drm = {
 	.kms_out_fence_fd = -1,
 };
 
-static int add_connector_property(drmModeAtomicReq *req, uint32_t obj_id,
-					const char *name, uint64_t value)
+#define MAX_OUTPUTS 8
+#define OUTPUT_REPORT_FRAMES 120
+
+/* With --outputs, every connected connector gets a crtc, plane and GBM
+ * swapchain of its own.  The first one is the connector/crtc/plane the
+ * single output path uses, rendering to the surface manager's surface:
+ */
+struct output {
+	uint32_t connector_id, crtc_id, plane_id;
+	drmModeModeInfo mode;
+	struct plane *plane;
+	struct crtc *crtc;
+	struct connector *connector;
+
+	struct gbm_surface *gbm_surface;
+	EGLSurface surface;
+	struct drm_fb *fb;         /* on screen */
+	struct drm_fb *next_fb;    /* committed, waiting for the flip */
+
+	/* since the last report: */
+	unsigned frames, missed;
+	int64_t render_ns, commit_ns;
+	int64_t report_ns;
+
+	unsigned last_sequence;
+	int64_t last_flip_ns;
+};
+
+/* Outputs with the same timing are committed together, in one atomic
+ * request, and render their next frame once all of them flipped:
+ */
+struct output_group {
+	int outputs[MAX_OUTPUTS];
+	int count;
+	int64_t period_ns;
+
+	unsigned frame;
+	int pending;               /* flips still outstanding */
+	int64_t present_ns;        /* when the last frame hit the screen */
+};
+
+static struct output outputs[MAX_OUTPUTS];
+static int num_outputs;
+static struct output_group groups[MAX_OUTPUTS];
+static int num_groups;
+
+#define MAX_LAYERS 4
+
+/* The plane and swapchain behind each layer added by add_layer(): */
+struct layer_plane {
+	struct layer *layer;
+	uint32_t plane_id;
+	struct plane *plane;
+	uint32_t format;            /* layer->format, if it can be drawn */
+	int64_t blend_mode;         /* "Pre-multiplied", or -1 to leave it */
+
+	struct gbm_surface *gbm_surface;
+	EGLSurface surface;
+	struct drm_fb *fb;          /* committed last */
+	struct drm_fb *next_fb;     /* drawn, goes out with the next commit */
+	struct drm_fb *retired_fb;  /* replaced by the last commit */
+};
+
+static struct layer_plane layers[MAX_LAYERS];
+static int num_layers;
+
+/* With --render-scale the scene only draws the bottom left part of each
+ * buffer, where GL's viewport origin is, and the plane scales that up to
+ * the whole crtc.  The buffers stay full size, so the scale can change
+ * from one frame to the next:
+ */
+#define RENDER_SCALE_STEP (1.0f / 32)
+
+static struct {
+	float scale;               /* drawn at */
+	float target;              /* wanted from the next frame on */
+	float min;                 /* lowest the plane is known to take */
+	uint32_t width, height;    /* drawn, at scale */
+	int64_t budget_ns;         /* GPU time to aim for, with auto */
+} render;
+
+static int add_connector_property(drmModeAtomicReq *req, const struct connector *obj,
+					uint32_t obj_id, const char *name, uint64_t value)
 {
-	struct connector *obj = drm.connector;
 	unsigned int i;
 	int prop_id = 0;
 
@@ -60,10 +145,9 @@ static int add_connector_property(drmModeAtomicReq *req, uint32_t obj_id,
 	return drmModeAtomicAddProperty(req, obj_id, prop_id, value);
 }
 
-static int add_crtc_property(drmModeAtomicReq *req, uint32_t obj_id,
-				const char *name, uint64_t value)
+static int add_crtc_property(drmModeAtomicReq *req, const struct crtc *obj,
+				uint32_t obj_id, const char *name, uint64_t value)
 {
-	struct crtc *obj = drm.crtc;
 	unsigned int i;
 	int prop_id = -1;
 
@@ -82,10 +166,9 @@ static int add_crtc_property(drmModeAtomicReq *req, uint32_t obj_id,
 	return drmModeAtomicAddProperty(req, obj_id, prop_id, value);
 }
 
-static int add_plane_property(drmModeAtomicReq *req, uint32_t obj_id,
-				const char *name, uint64_t value)
+static int add_plane_property(drmModeAtomicReq *req, const struct plane *obj,
+				uint32_t obj_id, const char *name, uint64_t value)
 {
-	struct plane *obj = drm.plane;
 	unsigned int i;
 	int prop_id = -1;
 
@@ -105,52 +188,170 @@ static int add_plane_property(drmModeAtomicReq *req, uint32_t obj_id,
 	return drmModeAtomicAddProperty(req, obj_id, prop_id, value);
 }
 
+static bool plane_property_settable(const struct plane *obj, const char *name)
+{
+	unsigned int i;
+
+	for (i = 0 ; i < obj->props->count_props ; i++) {
+		if (strcmp(obj->props_info[i]->name, name) == 0)
+			return !(obj->props_info[i]->flags & DRM_MODE_PROP_IMMUTABLE);
+	}
+
+	return false;
+}
+
+/* The value of the enum property name called value_name, or -1 if the
+ * plane has no such (settable) property or value:
+ */
+static int64_t plane_enum_value(const struct plane *obj, const char *name,
+				const char *value_name)
+{
+	unsigned int i;
+	int j;
+
+	for (i = 0 ; i < obj->props->count_props ; i++) {
+		const drmModePropertyRes *prop = obj->props_info[i];
+
+		if (strcmp(prop->name, name) || (prop->flags & DRM_MODE_PROP_IMMUTABLE))
+			continue;
+
+		for (j = 0; j < prop->count_enums; j++) {
+			if (strcmp(prop->enums[j].name, value_name) == 0)
+				return prop->enums[j].value;
+		}
+	}
+
+	return -1;
+}
+
+static bool plane_has_format(const struct plane *obj, uint32_t format)
+{
+	uint32_t i;
+
+	for (i = 0; i < obj->plane->count_formats; i++) {
+		if (obj->plane->formats[i] == format)
+			return true;
+	}
+
+	return false;
+}
+
+static void add_layer_properties(drmModeAtomicReq *req,
+				 const struct layer_plane *l)
+{
+	const struct layer *layer = l->layer;
+
+	add_plane_property(req, l->plane, l->plane_id, "FB_ID", l->next_fb->fb_id);
+	add_plane_property(req, l->plane, l->plane_id, "CRTC_ID", drm.crtc_id);
+	add_plane_property(req, l->plane, l->plane_id, "SRC_X", layer->src_x << 16);
+	add_plane_property(req, l->plane, l->plane_id, "SRC_Y", layer->src_y << 16);
+	add_plane_property(req, l->plane, l->plane_id, "SRC_W", layer->src_w << 16);
+	add_plane_property(req, l->plane, l->plane_id, "SRC_H", layer->src_h << 16);
+	add_plane_property(req, l->plane, l->plane_id, "CRTC_X", layer->crtc_x);
+	add_plane_property(req, l->plane, l->plane_id, "CRTC_Y", layer->crtc_y);
+	add_plane_property(req, l->plane, l->plane_id, "CRTC_W", layer->crtc_w);
+	add_plane_property(req, l->plane, l->plane_id, "CRTC_H", layer->crtc_h);
+
+	if (plane_property_settable(l->plane, "zpos"))
+		add_plane_property(req, l->plane, l->plane_id, "zpos", layer->zpos);
+	if (plane_property_settable(l->plane, "alpha"))
+		add_plane_property(req, l->plane, l->plane_id, "alpha", layer->alpha);
+	if (l->blend_mode >= 0)
+		add_plane_property(req, l->plane, l->plane_id, "pixel blend mode",
+				l->blend_mode);
+}
+
+/* The commit that put a layer's next_fb on screen went through: the
+ * buffer it replaced is off screen once the following one completes.
+ */
+static void layers_committed(void)
+{
+	int i;
+
+	for (i = 0; i < num_layers; i++) {
+		struct layer_plane *l = &layers[i];
+
+		if (l->retired_fb) {
+			gbm_surface_release_buffer(l->gbm_surface, l->retired_fb->bo);
+			l->retired_fb = NULL;
+		}
+
+		if (l->next_fb) {
+			l->retired_fb = l->fb;
+			l->fb = l->next_fb;
+			l->next_fb = NULL;
+		}
+	}
+}
+
 static int drm_atomic_commit(uint32_t fb_id, uint32_t flags)
 {
 	drmModeAtomicReq *req;
 	uint32_t plane_id = drm.plane->plane->plane_id;
 	uint32_t blob_id;
-	int ret;
+	int i, ret;
 
 	req = drmModeAtomicAlloc();
 
 	if (flags & DRM_MODE_ATOMIC_ALLOW_MODESET) {
-		if (add_connector_property(req, drm.connector_id, "CRTC_ID",
-						drm.crtc_id) < 0)
+		if (add_connector_property(req, drm.connector, drm.connector_id,
+						"CRTC_ID", drm.crtc_id) < 0)
 				return -1;
 
 		if (drmModeCreatePropertyBlob(drm.fd, drm.mode, sizeof(*drm.mode),
 					      &blob_id) != 0)
 			return -1;
 
-		if (add_crtc_property(req, drm.crtc_id, "MODE_ID", blob_id) < 0)
+		if (add_crtc_property(req, drm.crtc, drm.crtc_id, "MODE_ID", blob_id) < 0)
 			return -1;
 
-		if (add_crtc_property(req, drm.crtc_id, "ACTIVE", 1) < 0)
+		if (add_crtc_property(req, drm.crtc, drm.crtc_id, "ACTIVE", 1) < 0)
 			return -1;
 	}
 
-	add_plane_property(req, plane_id, "FB_ID", fb_id);
-	add_plane_property(req, plane_id, "CRTC_ID", drm.crtc_id);
-	add_plane_property(req, plane_id, "SRC_X", 0);
-	add_plane_property(req, plane_id, "SRC_Y", 0);
-	add_plane_property(req, plane_id, "SRC_W", drm.mode->hdisplay << 16);
-	add_plane_property(req, plane_id, "SRC_H", drm.mode->vdisplay << 16);
-	add_plane_property(req, plane_id, "CRTC_X", 0);
-	add_plane_property(req, plane_id, "CRTC_Y", 0);
-	add_plane_property(req, plane_id, "CRTC_W", drm.mode->hdisplay);
-	add_plane_property(req, plane_id, "CRTC_H", drm.mode->vdisplay);
+	add_plane_property(req, drm.plane, plane_id, "FB_ID", fb_id);
+	add_plane_property(req, drm.plane, plane_id, "CRTC_ID", drm.crtc_id);
+	add_plane_property(req, drm.plane, plane_id, "SRC_X", 0);
+	add_plane_property(req, drm.plane, plane_id, "SRC_Y",
+			(drm.mode->vdisplay - render.height) << 16);
+	add_plane_property(req, drm.plane, plane_id, "SRC_W", render.width << 16);
+	add_plane_property(req, drm.plane, plane_id, "SRC_H", render.height << 16);
+	add_plane_property(req, drm.plane, plane_id, "CRTC_X", 0);
+	add_plane_property(req, drm.plane, plane_id, "CRTC_Y", 0);
+	add_plane_property(req, drm.plane, plane_id, "CRTC_W", drm.mode->hdisplay);
+	add_plane_property(req, drm.plane, plane_id, "CRTC_H", drm.mode->vdisplay);
 
 	if (drm.kms_in_fence_fd != -1) {
-		add_crtc_property(req, drm.crtc_id, "OUT_FENCE_PTR",
+		add_crtc_property(req, drm.crtc, drm.crtc_id, "OUT_FENCE_PTR",
 				VOID2U64(&drm.kms_out_fence_fd));
-		add_plane_property(req, plane_id, "IN_FENCE_FD", drm.kms_in_fence_fd);
+		add_plane_property(req, drm.plane, plane_id, "IN_FENCE_FD",
+				drm.kms_in_fence_fd);
 	}
 
+	/* only the layers that changed, the others keep their state: */
+	for (i = 0; i < num_layers; i++) {
+		if (layers[i].next_fb)
+			add_layer_properties(req, &layers[i]);
+	}
+
+	if (writeback_enabled &&
+	    writeback_add_properties(req, flags & DRM_MODE_ATOMIC_ALLOW_MODESET) < 0) {
+		ret = -1;
+		goto out;
+	}
+
+	PROBE3(commit_begin, fb_id, flags, drm.kms_in_fence_fd);
+	trace_begin("atomic commit");
 	ret = drmModeAtomicCommit(drm.fd, req, flags, NULL);
+	trace_end("atomic commit");
+	PROBE3(commit_end, fb_id, ret, drm.kms_out_fence_fd);
+	if (writeback_enabled)
+		writeback_committed(ret);
 	if (ret)
 		goto out;
 
+	layers_committed();
+
 	if (drm.kms_in_fence_fd != -1) {
 		close(drm.kms_in_fence_fd);
 		drm.kms_in_fence_fd = -1;
@@ -162,6 +363,227 @@ out:
 	return ret;
 }
 
+static void set_render_viewport(void)
+{
+	glViewport(0, 0, render.width, render.height);
+	glScissor(0, 0, render.width, render.height);
+}
+
+static void init_render_scale(const struct egl *egl)
+{
+	const drmModeModeInfo *m = drm.mode;
+
+	render.scale = render.target = 1.0f;
+	render.min = RENDER_SCALE_MIN;
+	render.width = m->hdisplay;
+	render.height = m->vdisplay;
+
+	if (render_scale == 1.0f)
+		return;
+
+	if (render_scale == 0.0f) {
+		/* leave a quarter of the refresh period for the rest: */
+		render.budget_ns = (int64_t)m->htotal * m->vtotal * 1000000 /
+				(m->clock ? m->clock : 1) * 3 / 4;
+		if (!egl->glGenQueriesEXT)
+			printf("no GPU timer queries, render scale stays at 1.00\n");
+	} else {
+		render.target = render_scale;
+	}
+
+	/* so clears only touch the part that is drawn: */
+	glEnable(GL_SCISSOR_TEST);
+	set_render_viewport();
+}
+
+/* GPU time is taken to follow the number of pixels drawn.  Aim for the
+ * scale that would fit the budget, a quarter of the way per sample, so
+ * noise and the latency of the timer queries don't make it oscillate:
+ */
+static void adjust_render_scale(void)
+{
+	uint64_t gpu_ns = gpu_time_sample();
+	float ideal, target;
+
+	if (!gpu_ns)
+		return;
+
+	ideal = render.scale * sqrtf((float)render.budget_ns / gpu_ns);
+	target = render.scale + (ideal - render.scale) / 4;
+	target = roundf(target / RENDER_SCALE_STEP) * RENDER_SCALE_STEP;
+
+	if (target < render.min)
+		target = render.min;
+	if (target > 1.0f)
+		target = 1.0f;
+
+	render.target = target;
+}
+
+/* Switch to the target scale for the frames to come, if a TEST_ONLY
+ * commit says the plane can scale that much.  The plane has the last
+ * frame's fb and the rest of its state already:
+ */
+static void update_render_size(void)
+{
+	const uint32_t plane_id = drm.plane->plane->plane_id;
+	drmModeAtomicReq *req;
+	uint32_t width, height;
+	int ret;
+
+	if (render.target == render.scale)
+		return;
+
+	width = drm.mode->hdisplay * render.target + 0.5f;
+	height = drm.mode->vdisplay * render.target + 0.5f;
+
+	req = drmModeAtomicAlloc();
+	add_plane_property(req, drm.plane, plane_id, "SRC_Y",
+			(drm.mode->vdisplay - height) << 16);
+	add_plane_property(req, drm.plane, plane_id, "SRC_W", width << 16);
+	add_plane_property(req, drm.plane, plane_id, "SRC_H", height << 16);
+	ret = drmModeAtomicCommit(drm.fd, req, DRM_MODE_ATOMIC_TEST_ONLY, NULL);
+	drmModeAtomicFree(req);
+
+	if (ret) {
+		printf("plane can't scale %ux%u to %ux%u, render scale stays at %.2f\n",
+				width, height, drm.mode->hdisplay, drm.mode->vdisplay,
+				render.scale);
+		/* don't try to go this low again: */
+		if (render.target < render.scale)
+			render.min = render.scale;
+		render.target = render.scale;
+		return;
+	}
+
+	render.scale = render.target;
+	render.width = width;
+	render.height = height;
+	set_render_viewport();
+}
+
+/* A window config with buffers of format.  The scene's context can only
+ * draw to it if it isn't tied to a config of its own:
+ */
+static bool get_layer_config(const struct egl *egl, uint32_t format,
+			     EGLConfig *config)
+{
+	static const EGLint attribs[] = {
+		EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+		EGL_RED_SIZE, 1,
+		EGL_GREEN_SIZE, 1,
+		EGL_BLUE_SIZE, 1,
+		EGL_ALPHA_SIZE, 1,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_NONE
+	};
+	EGLConfig configs[64];
+	EGLint i, n;
+
+	if (!egl->no_config ||
+	    !eglChooseConfig(egl->display, attribs, configs, ARRAY_SIZE(configs), &n))
+		return false;
+
+	for (i = 0; i < n; i++) {
+		EGLint id;
+
+		if (eglGetConfigAttrib(egl->display, configs[i],
+				       EGL_NATIVE_VISUAL_ID, &id) &&
+		    (uint32_t)id == format) {
+			*config = configs[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int init_layers(const struct surfmgr *surfmgr, const struct egl *egl)
+{
+	int i;
+
+	for (i = 0; i < num_layers; i++) {
+		struct layer_plane *l = &layers[i];
+		uint32_t format = l->layer->format;
+		EGLConfig config = egl->config;
+
+		l->format = GBM_FORMAT_XRGB8888;
+		l->blend_mode = -1;
+		if (format && format != l->format) {
+			if (plane_has_format(l->plane, format) &&
+			    get_layer_config(egl, format, &config)) {
+				l->format = format;
+				/* the KMS default, but a previous user may have
+				 * changed it:
+				 */
+				l->blend_mode = plane_enum_value(l->plane,
+						"pixel blend mode", "Pre-multiplied");
+			} else {
+				printf("layer %s: can't draw %.4s buffers, drawing it opaque\n",
+						l->layer->name, (const char *)&format);
+			}
+		}
+
+		l->gbm_surface = surfmgr_create_surface(surfmgr, l->layer->width,
+				l->layer->height, l->format);
+		if (!l->gbm_surface)
+			return -1;
+
+		l->surface = eglCreateWindowSurface(egl->display, config,
+				(EGLNativeWindowType)l->gbm_surface, NULL);
+		if (l->surface == EGL_NO_SURFACE) {
+			printf("failed to create egl surface for layer %s\n",
+					l->layer->name);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Redraw the layers that changed, ahead of the scene so the scene's
+ * fence covers them as well.  The first frame draws all of them:
+ */
+static int render_layers(const struct egl *egl)
+{
+	bool drawn = false;
+	int i;
+
+	for (i = 0; i < num_layers; i++) {
+		struct layer_plane *l = &layers[i];
+		struct gbm_bo *bo;
+
+		if (l->fb && !l->layer->changed())
+			continue;
+
+		eglMakeCurrent(egl->display, l->surface, l->surface, egl->context);
+		glViewport(0, 0, l->layer->width, l->layer->height);
+		glScissor(0, 0, l->layer->width, l->layer->height);
+		l->layer->draw(egl);
+		eglSwapBuffers(egl->display, l->surface);
+		drawn = true;
+
+		bo = gbm_surface_lock_front_buffer(l->gbm_surface);
+		if (!bo) {
+			printf("Failed to lock frontbuffer\n");
+			return -1;
+		}
+
+		l->next_fb = drm_fb_get_from_bo(bo);
+		if (!l->next_fb) {
+			printf("Failed to get a new framebuffer BO\n");
+			return -1;
+		}
+	}
+
+	if (drawn) {
+		eglMakeCurrent(egl->display, egl->surface, egl->surface, egl->context);
+		set_render_viewport();
+	}
+
+	return 0;
+}
+
 static int atomic_run(const struct surfmgr *surfmgr, const struct egl *egl)
 {
 	struct drm_fb *fb = NULL;
@@ -181,7 +603,18 @@ static int atomic_run(const struct surfmgr *surfmgr, const struct egl *egl)
 	/* Allow a modeset change for the first commit only. */
 	flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
 
-	while (1) {
+	if (render_scale != 1.0f && (!surfmgr->gbm || surfmgr->prime)) {
+		printf("--render-scale needs GBM surfaces on the display device\n");
+		return -1;
+	}
+	init_render_scale(egl);
+
+	if (num_layers && init_layers(surfmgr, egl))
+		return -1;
+
+	startup_begin(STARTUP_FIRST_FRAME);
+
+	while (keep_running(i)) {
 		struct drm_fb *last_fb;
 		EGLSyncKHR kms_fence = NULL;   /* in-fence to gpu, out-fence from kms */
 
@@ -200,17 +633,42 @@ static int atomic_run(const struct surfmgr *surfmgr, const struct egl *egl)
 			egl->eglWaitSyncKHR(egl->display, kms_fence, 0);
 		}
 
-		egl->draw(i++);
+		/* from the second frame on, with the first one's fb on the plane: */
+		if (fb && render_scale != 1.0f) {
+			if (render_scale == 0.0f)
+				adjust_render_scale();
+			update_render_size();
+		}
 
+		PROBE1(frame_start, i);
+		if (num_layers) {
+			trace_begin("layers");
+			frame_begin(FRAME_HUD);
+			ret = render_layers(egl);
+			frame_end(FRAME_HUD);
+			trace_end("layers");
+			if (ret)
+				return -1;
+		}
+
+		draw_frame(egl, i++);
+
+		frame_begin(FRAME_SWAP);
+		trace_begin("end_frame");
 		surfmgr_end_frame(surfmgr, egl, &drm.kms_in_fence_fd);
 
 		last_fb = fb;
 		fb = surfmgr_get_next_fb(surfmgr);
+		trace_end("end_frame");
+		frame_end(FRAME_SWAP);
 		if (!fb) {
 			printf("Failed to get a new framebuffer BO\n");
 			return -1;
 		}
 
+		PROBE3(frame_ready, i - 1, fb->fb_id, drm.kms_in_fence_fd);
+
+		frame_begin(FRAME_WAIT);
 		if (kms_fence) {
 			EGLint status;
 
@@ -219,29 +677,52 @@ static int atomic_run(const struct surfmgr *surfmgr, const struct egl *egl)
 			 * atomic will reject the commit if we post a new one
 			 * whilst the previous one is still pending.
 			 */
+			trace_begin("kms fence wait");
 			do {
 				status = egl->eglClientWaitSyncKHR(egl->display,
 								   kms_fence,
 								   0,
 								   EGL_FOREVER_KHR);
 			} while (status != EGL_CONDITION_SATISFIED_KHR);
+			trace_end("kms fence wait");
+			PROBE1(flip_complete, i - 2);
+
+			/* the out-fence signals when the previous commit
+			 * hit the screen:
+			 */
+			trace_instant("flip", i - 2);
+			frame_presented(i - 2, get_time_ns());
 
 			egl->eglDestroySyncKHR(egl->display, kms_fence);
 		}
+		frame_end(FRAME_WAIT);
 
-		/*
-		 * Here you could also update drm plane layers if you want
-		 * hw composition
-		 */
+		/* layers that changed go out with the scene, in one commit: */
+		frame_begin(FRAME_COMMIT);
 		ret = drm_atomic_commit(fb->fb_id, flags);
+		frame_end(FRAME_COMMIT);
 		if (ret) {
 			printf("failed to commit: %s\n", strerror(errno));
 			return -1;
 		}
 
+		/* a blocking commit returns once the frame is on screen: */
+		if (!(flags & DRM_MODE_ATOMIC_NONBLOCK))
+			frame_presented(i - 1, get_time_ns());
+
 		/* release last buffer to render on again: */
 		surfmgr_release_fb(surfmgr, last_fb);
 
+		if (flags & DRM_MODE_ATOMIC_ALLOW_MODESET) {
+			startup_end(STARTUP_FIRST_FRAME);
+			startup_report();
+		}
+
+		frame_report();
+		if (render_scale == 0.0f && i % 120 == 0)
+			printf("render scale %.2f: %ux%u\n", render.scale,
+					render.width, render.height);
+
 		/* Allow a modeset change for the first commit only. */
 		flags &= ~(DRM_MODE_ATOMIC_ALLOW_MODESET);
 	}
@@ -249,18 +730,315 @@ static int atomic_run(const struct surfmgr *surfmgr, const struct egl *egl)
 	return ret;
 }
 
+static int add_output_properties(drmModeAtomicReq *req, const struct output *o,
+					uint32_t flags)
+{
+	if (flags & DRM_MODE_ATOMIC_ALLOW_MODESET) {
+		uint32_t blob_id;
+
+		if (add_connector_property(req, o->connector, o->connector_id,
+						"CRTC_ID", o->crtc_id) < 0)
+			return -1;
+
+		if (drmModeCreatePropertyBlob(drm.fd, &o->mode, sizeof(o->mode),
+					      &blob_id) != 0)
+			return -1;
+
+		if (add_crtc_property(req, o->crtc, o->crtc_id, "MODE_ID", blob_id) < 0)
+			return -1;
+
+		if (add_crtc_property(req, o->crtc, o->crtc_id, "ACTIVE", 1) < 0)
+			return -1;
+	}
+
+	add_plane_property(req, o->plane, o->plane_id, "FB_ID", o->next_fb->fb_id);
+	add_plane_property(req, o->plane, o->plane_id, "CRTC_ID", o->crtc_id);
+	add_plane_property(req, o->plane, o->plane_id, "SRC_X", 0);
+	add_plane_property(req, o->plane, o->plane_id, "SRC_Y", 0);
+	add_plane_property(req, o->plane, o->plane_id, "SRC_W", o->mode.hdisplay << 16);
+	add_plane_property(req, o->plane, o->plane_id, "SRC_H", o->mode.vdisplay << 16);
+	add_plane_property(req, o->plane, o->plane_id, "CRTC_X", 0);
+	add_plane_property(req, o->plane, o->plane_id, "CRTC_Y", 0);
+	add_plane_property(req, o->plane, o->plane_id, "CRTC_W", o->mode.hdisplay);
+	add_plane_property(req, o->plane, o->plane_id, "CRTC_H", o->mode.vdisplay);
+
+	return 0;
+}
+
+/* Put the next_fb of each of the given outputs on screen in a single
+ * atomic request; the page flip events carry user_data:
+ */
+static int commit_outputs(const int *list, int count, uint32_t flags,
+			  void *user_data)
+{
+	drmModeAtomicReq *req;
+	int64_t start, ns;
+	int i, ret;
+
+	req = drmModeAtomicAlloc();
+
+	for (i = 0; i < count; i++) {
+		if (add_output_properties(req, &outputs[list[i]], flags) < 0) {
+			ret = -1;
+			goto out;
+		}
+	}
+
+	start = get_time_ns();
+	trace_begin("atomic commit");
+	ret = drmModeAtomicCommit(drm.fd, req, flags, user_data);
+	trace_end("atomic commit");
+	ns = get_time_ns() - start;
+
+	for (i = 0; i < count; i++)
+		outputs[list[i]].commit_ns += ns;
+
+out:
+	drmModeAtomicFree(req);
+
+	return ret;
+}
+
+static int render_output(const struct egl *egl, struct output *o,
+			 unsigned frame, int64_t present_ns, bool update)
+{
+	struct gbm_bo *bo;
+	int64_t start = get_time_ns();
+
+	if (!eglMakeCurrent(egl->display, o->surface, o->surface, egl->context)) {
+		printf("failed to make output %u current\n", o->connector_id);
+		return -1;
+	}
+
+	glViewport(0, 0, o->mode.hdisplay, o->mode.vdisplay);
+	if (egl->set_aspect)
+		egl->set_aspect((float)o->mode.vdisplay / o->mode.hdisplay);
+	draw_frame_at(egl, frame, present_ns, update);
+	eglSwapBuffers(egl->display, o->surface);
+
+	bo = gbm_surface_lock_front_buffer(o->gbm_surface);
+	if (!bo) {
+		printf("Failed to lock frontbuffer\n");
+		return -1;
+	}
+
+	o->next_fb = drm_fb_get_from_bo(bo);
+	if (!o->next_fb) {
+		printf("Failed to get a new framebuffer BO\n");
+		return -1;
+	}
+
+	o->render_ns += get_time_ns() - start;
+
+	return 0;
+}
+
+/* Draw the group's next frame for the vblank after the last flip and
+ * queue it; rendering relies on implicit sync with the flips of the
+ * buffers still on screen.
+ */
+static int render_group(const struct egl *egl, struct output_group *g)
+{
+	int64_t present_ns = g->present_ns + g->period_ns;
+	int i, ret;
+
+	for (i = 0; i < g->count; i++) {
+		int n = g->outputs[i];
+
+		if (render_output(egl, &outputs[n], g->frame, present_ns, n == 0))
+			return -1;
+	}
+
+	ret = commit_outputs(g->outputs, g->count,
+			DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT, g);
+	if (ret) {
+		printf("failed to commit: %s\n", strerror(errno));
+		return -1;
+	}
+
+	g->pending = g->count;
+
+	return 0;
+}
+
+static void report_output(struct output *o, int64_t ns)
+{
+	double secs = (ns - o->report_ns) / (double)NSEC_PER_SEC;
+
+	printf("output %u (%s@%u): %.2f fps, render %.2f ms, commit %.2f ms, "
+			"%u missed vblanks\n", o->connector_id, o->mode.name,
+			o->mode.vrefresh, o->frames / secs,
+			o->render_ns / 1e6 / o->frames, o->commit_ns / 1e6 / o->frames,
+			o->missed);
+
+	o->frames = 0;
+	o->missed = 0;
+	o->render_ns = 0;
+	o->commit_ns = 0;
+	o->report_ns = ns;
+}
+
+static void output_flip_handler(int fd, unsigned int sequence,
+		unsigned int sec, unsigned int usec, unsigned int crtc_id, void *data)
+{
+	struct output_group *g = data;
+	int64_t ns = sec * NSEC_PER_SEC + usec * 1000;
+	int i;
+
+	/* suppress 'unused parameter' warnings */
+	(void)fd;
+
+	for (i = 0; i < g->count; i++) {
+		struct output *o = &outputs[g->outputs[i]];
+
+		if (o->crtc_id != crtc_id)
+			continue;
+
+		/* every vblank in between showed the previous frame again: */
+		if (o->last_flip_ns && sequence - o->last_sequence > 1)
+			o->missed += sequence - o->last_sequence - 1;
+		o->last_sequence = sequence;
+		o->last_flip_ns = ns;
+
+		/* release last buffer to render on again: */
+		gbm_surface_release_buffer(o->gbm_surface, o->fb->bo);
+		o->fb = o->next_fb;
+		o->next_fb = NULL;
+
+		if (ns > g->present_ns)
+			g->present_ns = ns;
+		g->pending--;
+
+		if (++o->frames == OUTPUT_REPORT_FRAMES)
+			report_output(o, ns);
+	}
+
+	trace_instant("flip", g->frame);
+}
+
+static int multi_run(const struct surfmgr *surfmgr, const struct egl *egl)
+{
+	drmEventContext evctx = {
+			.version = 3,
+			.page_flip_handler2 = output_flip_handler,
+	};
+	struct pollfd pfd = {
+			.fd = drm.fd,
+			.events = POLLIN,
+	};
+	int all[MAX_OUTPUTS];
+	int64_t ns;
+	int i, ret;
+
+	if (!surfmgr->gbm || surfmgr->prime) {
+		printf("multiple outputs need GBM on the display device\n");
+		return -1;
+	}
+
+	outputs[0].gbm_surface = surfmgr->gbm->surface;
+	outputs[0].surface = egl->surface;
+
+	for (i = 1; i < num_outputs; i++) {
+		struct output *o = &outputs[i];
+
+		o->gbm_surface = surfmgr_create_surface(surfmgr, o->mode.hdisplay,
+				o->mode.vdisplay, GBM_FORMAT_XRGB8888);
+		if (!o->gbm_surface)
+			return -1;
+
+		o->surface = eglCreateWindowSurface(egl->display, egl->config,
+				(EGLNativeWindowType)o->gbm_surface, NULL);
+		if (o->surface == EGL_NO_SURFACE) {
+			printf("failed to create egl surface for output %u\n",
+					o->connector_id);
+			return -1;
+		}
+	}
+
+	startup_begin(STARTUP_FIRST_FRAME);
+
+	/* the first frame of every output goes out in one modeset: */
+	ns = get_time_ns();
+	for (i = 0; i < num_outputs; i++) {
+		all[i] = i;
+		if (render_output(egl, &outputs[i], 0, ns, i == 0))
+			return -1;
+	}
+
+	ret = commit_outputs(all, num_outputs, DRM_MODE_ATOMIC_ALLOW_MODESET, NULL);
+	if (ret) {
+		printf("failed to commit: %s\n", strerror(errno));
+		return -1;
+	}
+
+	ns = get_time_ns();
+	for (i = 0; i < num_outputs; i++) {
+		outputs[i].fb = outputs[i].next_fb;
+		outputs[i].next_fb = NULL;
+		outputs[i].render_ns = 0;
+		outputs[i].commit_ns = 0;
+		outputs[i].report_ns = ns;
+	}
+
+	startup_end(STARTUP_FIRST_FRAME);
+	startup_report();
+
+	frame_presented(0, ns);
+
+	for (i = 0; i < num_groups; i++) {
+		groups[i].frame = 1;
+		groups[i].present_ns = ns;
+		if (render_group(egl, &groups[i]))
+			return -1;
+	}
+
+	while (keep_running(groups[0].frame)) {
+		ret = poll(&pfd, 1, 1000);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		} else if (ret < 0) {
+			printf("poll err: %s\n", strerror(errno));
+			return -1;
+		} else if (ret == 0) {
+			printf("flip timeout!\n");
+			return -1;
+		}
+
+		drmHandleEvent(drm.fd, &evctx);
+
+		for (i = 0; i < num_groups; i++) {
+			struct output_group *g = &groups[i];
+
+			if (g->pending)
+				continue;
+
+			PROBE1(flip_complete, g->frame);
+			if (i == 0)
+				frame_presented(g->frame, g->present_ns);
+
+			g->frame++;
+			if (render_group(egl, g))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
 /* Pick a plane.. something that at a minimum can be connected to
- * the chosen crtc, but prefer primary plane.
+ * the given crtc and isn't used already, but prefer the given type
+ * (primary for the scene, overlay for layers).
  *
  * Seems like there is some room for a drmModeObjectGetNamedProperty()
  * type helper in libdrm..
  */
-static int get_plane_id(void)
+static int get_plane_id(int crtc_index, uint64_t type,
+			const uint32_t *used, int num_used)
 {
 	drmModePlaneResPtr plane_resources;
 	uint32_t i, j;
 	int ret = -EINVAL;
-	int found_primary = 0;
+	int found_type = 0;
 
 	plane_resources = drmModeGetPlaneResources(drm.fd);
 	if (!plane_resources) {
@@ -268,19 +1046,28 @@ static int get_plane_id(void)
 		return -1;
 	}
 
-	for (i = 0; (i < plane_resources->count_planes) && !found_primary; i++) {
+	for (i = 0; (i < plane_resources->count_planes) && !found_type; i++) {
 		uint32_t id = plane_resources->planes[i];
-		drmModePlanePtr plane = drmModeGetPlane(drm.fd, id);
+		drmModePlanePtr plane;
+		int k;
+
+		for (k = 0; k < num_used; k++)
+			if (used[k] == id)
+				break;
+		if (k < num_used)
+			continue;
+
+		plane = drmModeGetPlane(drm.fd, id);
 		if (!plane) {
 			printf("drmModeGetPlane(%u) failed: %s\n", id, strerror(errno));
 			continue;
 		}
 
-		if (plane->possible_crtcs & (1 << drm.crtc_index)) {
+		if (plane->possible_crtcs & (1 << crtc_index)) {
 			drmModeObjectPropertiesPtr props =
 				drmModeObjectGetProperties(drm.fd, id, DRM_MODE_OBJECT_PLANE);
 
-			/* primary or not, this plane is good enough to use: */
+			/* preferred or not, this plane is good enough to use: */
 			ret = id;
 
 			for (j = 0; j < props->count_props; j++) {
@@ -288,9 +1075,9 @@ static int get_plane_id(void)
 					drmModeGetProperty(drm.fd, props->props[j]);
 
 				if ((strcmp(p->name, "type") == 0) &&
-						(props->prop_values[j] == DRM_PLANE_TYPE_PRIMARY)) {
-					/* found our primary plane, lets use that: */
-					found_primary = 1;
+						(props->prop_values[j] == type)) {
+					/* found our preferred plane, lets use that: */
+					found_type = 1;
 				}
 
 				drmModeFreeProperty(p);
@@ -307,7 +1094,171 @@ static int get_plane_id(void)
 	return ret;
 }
 
-const struct drm * init_drm_atomic(const char *device)
+static int get_objects(struct plane *plane, uint32_t plane_id,
+		       struct crtc *crtc, uint32_t crtc_id,
+		       struct connector *connector, uint32_t connector_id)
+{
+#define get_resource(type, Type, id) do { 					\
+		type->type = drmModeGet##Type(drm.fd, id);			\
+		if (!type->type) {						\
+			printf("could not get %s %i: %s\n",			\
+					#type, id, strerror(errno));		\
+			return -1;						\
+		}								\
+	} while (0)
+
+	/* layers only need the plane: */
+	if (plane)
+		get_resource(plane, Plane, plane_id);
+	if (crtc)
+		get_resource(crtc, Crtc, crtc_id);
+	if (connector)
+		get_resource(connector, Connector, connector_id);
+
+#define get_properties(type, TYPE, id) do {					\
+		uint32_t i;							\
+		type->props = drmModeObjectGetProperties(drm.fd,		\
+				id, DRM_MODE_OBJECT_##TYPE);			\
+		if (!type->props) {						\
+			printf("could not get %s %u properties: %s\n", 		\
+					#type, id, strerror(errno));		\
+			return -1;						\
+		}								\
+		type->props_info = calloc(type->props->count_props,		\
+				sizeof(type->props_info));			\
+		for (i = 0; i < type->props->count_props; i++) {		\
+			type->props_info[i] = drmModeGetProperty(drm.fd,	\
+					type->props->props[i]);			\
+		}								\
+	} while (0)
+
+	if (plane)
+		get_properties(plane, PLANE, plane_id);
+	if (crtc)
+		get_properties(crtc, CRTC, crtc_id);
+	if (connector)
+		get_properties(connector, CONNECTOR, connector_id);
+
+	return 0;
+}
+
+/* The first output is the one already set up in drm, find a plane
+ * for each of the others and group them by timing:
+ */
+static int init_outputs(void)
+{
+	struct drm_output found[MAX_OUTPUTS];
+	uint32_t used_planes[MAX_OUTPUTS];
+	int i, j, n;
+
+	n = find_outputs(&drm, found, MAX_OUTPUTS);
+	if (n < 0)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		struct output *o = &outputs[num_outputs];
+		const drmModeModeInfo *m = &found[i].mode;
+		struct output_group *g;
+
+		o->connector_id = found[i].connector_id;
+		o->crtc_id = found[i].crtc_id;
+		o->mode = *m;
+
+		if (i == 0) {
+			o->plane = drm.plane;
+			o->crtc = drm.crtc;
+			o->connector = drm.connector;
+			o->plane_id = drm.plane->plane->plane_id;
+		} else {
+			int ret = get_plane_id(found[i].crtc_index,
+					DRM_PLANE_TYPE_PRIMARY, used_planes, num_outputs);
+			if (ret <= 0) {
+				printf("no plane for crtc %u, skipping connector %u\n",
+						o->crtc_id, o->connector_id);
+				continue;
+			}
+			o->plane_id = ret;
+
+			o->plane = calloc(1, sizeof(*o->plane));
+			o->crtc = calloc(1, sizeof(*o->crtc));
+			o->connector = calloc(1, sizeof(*o->connector));
+
+			if (get_objects(o->plane, o->plane_id, o->crtc, o->crtc_id,
+					o->connector, o->connector_id))
+				return -1;
+		}
+
+		used_planes[num_outputs] = o->plane_id;
+
+		for (j = 0; j < num_groups; j++) {
+			const drmModeModeInfo *t = &outputs[groups[j].outputs[0]].mode;
+
+			if (t->clock == m->clock && t->htotal == m->htotal &&
+					t->vtotal == m->vtotal)
+				break;
+		}
+
+		g = &groups[j];
+		if (j == num_groups) {
+			g->period_ns = (int64_t)m->htotal * m->vtotal * 1000000 /
+					(m->clock ? m->clock : 1);
+			num_groups++;
+		}
+		g->outputs[g->count++] = num_outputs;
+
+		printf("output %d: connector %u, crtc %u, plane %u, %s@%u, group %d\n",
+				num_outputs, o->connector_id, o->crtc_id, o->plane_id,
+				m->name, m->vrefresh, j);
+
+		num_outputs++;
+	}
+
+	return 0;
+}
+
+static int atomic_add_layer(struct layer *layer)
+{
+	struct layer_plane *l = &layers[num_layers];
+	uint32_t used[MAX_LAYERS + 1];
+	int i, ret;
+
+	if (num_layers == MAX_LAYERS) {
+		printf("too many layers\n");
+		return -1;
+	}
+
+	used[0] = drm.plane->plane->plane_id;
+	for (i = 0; i < num_layers; i++)
+		used[i + 1] = layers[i].plane_id;
+
+	ret = get_plane_id(drm.crtc_index, DRM_PLANE_TYPE_OVERLAY,
+			used, num_layers + 1);
+	if (ret <= 0) {
+		printf("no free plane for layer %s\n", layer->name);
+		return -1;
+	}
+
+	l->layer = layer;
+	l->plane_id = ret;
+	l->plane = calloc(1, sizeof(*l->plane));
+	if (get_objects(l->plane, l->plane_id, NULL, 0, NULL, 0))
+		return -1;
+
+	if (!plane_property_settable(l->plane, "zpos"))
+		printf("plane %u has a fixed zpos\n", l->plane_id);
+	if (layer->alpha != 0xffff && !plane_property_settable(l->plane, "alpha"))
+		printf("plane %u has no alpha, layer %s is opaque\n",
+				l->plane_id, layer->name);
+
+	printf("layer %s: plane %u, %ux%u at %d,%d\n", layer->name, l->plane_id,
+			layer->crtc_w, layer->crtc_h, layer->crtc_x, layer->crtc_y);
+
+	num_layers++;
+
+	return 0;
+}
+
+const struct drm * init_drm_atomic(const char *device, bool all_outputs)
 {
 	uint32_t plane_id;
 	int ret;
@@ -322,7 +1273,7 @@ const struct drm * init_drm_atomic(const char *device)
 		return NULL;
 	}
 
-	ret = get_plane_id();
+	ret = get_plane_id(drm.crtc_index, DRM_PLANE_TYPE_PRIMARY, NULL, 0);
 	if (!ret) {
 		printf("could not find a suitable plane\n");
 		return NULL;
@@ -330,49 +1281,26 @@ const struct drm * init_drm_atomic(const char *device)
 		plane_id = ret;
 	}
 
-	/* We only do single plane to single crtc to single connector, no
-	 * fancy multi-monitor or multi-plane stuff.  So just grab the
-	 * plane/crtc/connector property info for one of each:
+	/* One plane to one crtc to one connector, unless --outputs asked
+	 * for the other connected connectors as well, each with a crtc and
+	 * plane of its own.  Grab the plane/crtc/connector property info:
 	 */
 	drm.plane = calloc(1, sizeof(*drm.plane));
 	drm.crtc = calloc(1, sizeof(*drm.crtc));
 	drm.connector = calloc(1, sizeof(*drm.connector));
 
-#define get_resource(type, Type, id) do { 					\
-		drm.type->type = drmModeGet##Type(drm.fd, id);			\
-		if (!drm.type->type) {						\
-			printf("could not get %s %i: %s\n",			\
-					#type, id, strerror(errno));		\
-			return NULL;						\
-		}								\
-	} while (0)
-
-	get_resource(plane, Plane, plane_id);
-	get_resource(crtc, Crtc, drm.crtc_id);
-	get_resource(connector, Connector, drm.connector_id);
-
-#define get_properties(type, TYPE, id) do {					\
-		uint32_t i;							\
-		drm.type->props = drmModeObjectGetProperties(drm.fd,		\
-				id, DRM_MODE_OBJECT_##TYPE);			\
-		if (!drm.type->props) {						\
-			printf("could not get %s %u properties: %s\n", 		\
-					#type, id, strerror(errno));		\
-			return NULL;						\
-		}								\
-		drm.type->props_info = calloc(drm.type->props->count_props,	\
-				sizeof(drm.type->props_info));			\
-		for (i = 0; i < drm.type->props->count_props; i++) {		\
-			drm.type->props_info[i] = drmModeGetProperty(drm.fd,	\
-					drm.type->props->props[i]);		\
-		}								\
-	} while (0)
-
-	get_properties(plane, PLANE, plane_id);
-	get_properties(crtc, CRTC, drm.crtc_id);
-	get_properties(connector, CONNECTOR, drm.connector_id);
+	if (get_objects(drm.plane, plane_id, drm.crtc, drm.crtc_id,
+			drm.connector, drm.connector_id))
+		return NULL;
 
 	drm.run = atomic_run;
+	drm.add_layer = atomic_add_layer;
+
+	if (all_outputs) {
+		if (init_outputs())
+			return NULL;
+		drm.run = multi_run;
+	}
 
 	return &drm;
 }
@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include "common.h"
 #include "drm-common.h"
@@ -52,7 +53,7 @@ struct drm_fb * drm_fb_get_from_bo(struct gbm_bo *bo)
 {
 	int drm_fd = gbm_device_get_fd(gbm_bo_get_device(bo));
 	struct drm_fb *fb = gbm_bo_get_user_data(bo);
-	uint32_t width, height,
+	uint32_t width, height, format,
 		 strides[4] = {0}, handles[4] = {0},
 		 offsets[4] = {0}, flags = 0;
 	int ret = -1;
@@ -65,6 +66,7 @@ struct drm_fb * drm_fb_get_from_bo(struct gbm_bo *bo)
 
 	width = gbm_bo_get_width(bo);
 	height = gbm_bo_get_height(bo);
+	format = gbm_bo_get_format(bo);
 
 #ifdef HAVE_GBM_MODIFIERS
 	uint64_t modifiers[4] = {0};
@@ -83,7 +85,7 @@ struct drm_fb * drm_fb_get_from_bo(struct gbm_bo *bo)
 	}
 
 	ret = drmModeAddFB2WithModifiers(drm_fd, width, height,
-			DRM_FORMAT_XRGB8888, handles, strides, offsets,
+			format, handles, strides, offsets,
 			modifiers, &fb->fb_id, flags);
 #endif
 	if (ret) {
@@ -93,7 +95,7 @@ struct drm_fb * drm_fb_get_from_bo(struct gbm_bo *bo)
 		memcpy(handles, (uint32_t [4]){gbm_bo_get_handle(bo).u32,0,0,0}, 16);
 		memcpy(strides, (uint32_t [4]){gbm_bo_get_stride(bo),0,0,0}, 16);
 		memset(offsets, 0, 16);
-		ret = drmModeAddFB2(drm_fd, width, height, DRM_FORMAT_XRGB8888,
+		ret = drmModeAddFB2(drm_fd, width, height, format,
 				handles, strides, offsets, &fb->fb_id, 0);
 	}
 
@@ -108,31 +110,54 @@ struct drm_fb * drm_fb_get_from_bo(struct gbm_bo *bo)
 	return fb;
 }
 
-#ifdef HAVE_ALLOCATOR
 struct drm_fb * drm_fb_get_from_gem(int drm_fd,
 									uint32_t gemHandle,
 									uint32_t width,
 									uint32_t height,
-									size_t metadata_size,
-									void *metadata)
+									uint32_t stride,
+									uint64_t modifier)
 {
 	uint32_t strides[4] = {0}, handles[4] = {0},
 			 offsets[4] = {0}, flags = 0;
+	uint64_t modifiers[4] = {0};
 	struct drm_fb *fb = calloc(1, sizeof(*fb));
-	(void)metadata_size;
-	(void)metadata; /* XXX Need method to transmit this through AddFB2 */
+	int ret = -1;
 
 	if (!fb) return NULL;
 
 	handles[0] = gemHandle;
-	strides[0] = width * 4; /* Prototype allocator assumes RGBA8888 (Bpp==4) */
-
-	if (drmModeAddFB2(drm_fd, width, height, DRM_FORMAT_XRGB8888,
-					  handles,
-					  strides, /* Replace or augment with metadata */
-					  offsets,
-					  &fb->fb_id,
-					  flags)) {
+	strides[0] = stride;
+
+	/* An invalid modifier means the layout is implied by the kernel
+	 * driver, which is all plain AddFB2 can express:
+	 */
+	if (modifier != DRM_FORMAT_MOD_INVALID) {
+		modifiers[0] = modifier;
+		flags = DRM_MODE_FB_MODIFIERS;
+
+		ret = drmModeAddFB2WithModifiers(drm_fd, width, height,
+				DRM_FORMAT_XRGB8888, handles, strides, offsets,
+				modifiers, &fb->fb_id, flags);
+		if (ret)
+			fprintf(stderr, "Modifiers failed!\n");
+		else
+			printf("Using modifier %" PRIx64 "\n", modifier);
+
+		/* Only a linear buffer still scans out right without the
+		 * modifier, anything else would be shown as the driver's
+		 * implicit layout, garbled; let the caller try another one:
+		 */
+		if (ret && modifier != DRM_FORMAT_MOD_LINEAR) {
+			free(fb);
+			return NULL;
+		}
+	}
+
+	if (ret)
+		ret = drmModeAddFB2(drm_fd, width, height, DRM_FORMAT_XRGB8888,
+				handles, strides, offsets, &fb->fb_id, 0);
+
+	if (ret) {
 		printf("Failed to create fb: %s\n", strerror(errno));
 		free(fb);
 		return NULL;
@@ -140,7 +165,90 @@ struct drm_fb * drm_fb_get_from_gem(int drm_fd,
 
 	return fb;
 }
-#endif /* HAVE_ALLOCATOR */
+
+bool drm_same_device(int fd_a, int fd_b)
+{
+	drmDevicePtr a, b;
+	bool ret = false;
+
+	if (drmGetDevice2(fd_a, 0, &a))
+		return false;
+
+	if (drmGetDevice2(fd_b, 0, &b) == 0) {
+		ret = drmDevicesEqual(a, b);
+		drmFreeDevice(&b);
+	}
+
+	drmFreeDevice(&a);
+
+	return ret;
+}
+
+struct drm_dumb * drm_dumb_create(int drm_fd, uint32_t width, uint32_t height)
+{
+	struct drm_mode_create_dumb create = {
+		.width = width,
+		.height = height,
+		.bpp = 32,
+	};
+	struct drm_mode_map_dumb map = {0};
+	struct drm_dumb *dumb;
+
+	dumb = calloc(1, sizeof(*dumb));
+	if (!dumb)
+		return NULL;
+
+	if (drmIoctl(drm_fd, DRM_IOCTL_MODE_CREATE_DUMB, &create)) {
+		printf("failed to create dumb buffer: %s\n", strerror(errno));
+		free(dumb);
+		return NULL;
+	}
+
+	dumb->handle = create.handle;
+	dumb->width = width;
+	dumb->height = height;
+	dumb->pitch = create.pitch;
+	dumb->size = create.size;
+
+	map.handle = dumb->handle;
+	if (drmIoctl(drm_fd, DRM_IOCTL_MODE_MAP_DUMB, &map)) {
+		printf("failed to map dumb buffer: %s\n", strerror(errno));
+		goto fail;
+	}
+
+	dumb->map = mmap(NULL, dumb->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+					 drm_fd, map.offset);
+	if (dumb->map == MAP_FAILED) {
+		printf("failed to mmap dumb buffer: %s\n", strerror(errno));
+		dumb->map = NULL;
+		goto fail;
+	}
+
+	dumb->fb = drm_fb_get_from_gem(drm_fd, dumb->handle, width, height,
+								   dumb->pitch, DRM_FORMAT_MOD_INVALID);
+	if (!dumb->fb)
+		goto fail;
+
+	return dumb;
+
+fail:
+	drm_dumb_destroy(drm_fd, dumb);
+	return NULL;
+}
+
+void drm_dumb_destroy(int drm_fd, struct drm_dumb *dumb)
+{
+	struct drm_mode_destroy_dumb destroy = {
+		.handle = dumb->handle,
+	};
+
+	if (dumb->fb)
+		drm_fb_destroy(drm_fd, dumb->fb);
+	if (dumb->map)
+		munmap(dumb->map, dumb->size);
+	drmIoctl(drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+	free(dumb);
+}
 
 static uint32_t find_crtc_for_encoder(const drmModeRes *resources,
 		const drmModeEncoder *encoder) {
@@ -183,12 +291,55 @@ static uint32_t find_crtc_for_connector(const struct drm *drm, const drmModeRes
 	return -1;
 }
 
+static drmModeConnector * find_connected_connector(const struct drm *drm,
+		const drmModeRes *resources,
+		drmModeConnector *(*get_connector)(int fd, uint32_t connector_id))
+{
+	drmModeConnector *connector;
+	int i;
+
+	for (i = 0; i < resources->count_connectors; i++) {
+		connector = get_connector(drm->fd, resources->connectors[i]);
+		if (connector && connector->connection == DRM_MODE_CONNECTED &&
+				connector->count_modes > 0) {
+			/* it's connected, let's use this! */
+			return connector;
+		}
+		drmModeFreeConnector(connector);
+	}
+
+	return NULL;
+}
+
+/* the preferred mode, or the highest resolution one: */
+static drmModeModeInfo * pick_mode(drmModeConnector *connector)
+{
+	drmModeModeInfo *mode = NULL;
+	int i, area;
+
+	for (i = 0, area = 0; i < connector->count_modes; i++) {
+		drmModeModeInfo *current_mode = &connector->modes[i];
+
+		if (current_mode->type & DRM_MODE_TYPE_PREFERRED) {
+			mode = current_mode;
+		}
+
+		int current_area = current_mode->hdisplay * current_mode->vdisplay;
+		if (current_area > area) {
+			mode = current_mode;
+			area = current_area;
+		}
+	}
+
+	return mode;
+}
+
 int init_drm(struct drm *drm, const char *device)
 {
 	drmModeRes *resources;
 	drmModeConnector *connector = NULL;
 	drmModeEncoder *encoder = NULL;
-	int i, area;
+	int i;
 
 	drm->fd = open(device, O_RDWR);
 
@@ -203,16 +354,13 @@ int init_drm(struct drm *drm, const char *device)
 		return -1;
 	}
 
-	/* find a connected connector: */
-	for (i = 0; i < resources->count_connectors; i++) {
-		connector = drmModeGetConnector(drm->fd, resources->connectors[i]);
-		if (connector->connection == DRM_MODE_CONNECTED) {
-			/* it's connected, let's use this! */
-			break;
-		}
-		drmModeFreeConnector(connector);
-		connector = NULL;
-	}
+	/* find a connected connector.  Try the state the kernel already
+	 * knows about first, since a forced probe can mean slow EDID reads
+	 * on every connector:
+	 */
+	connector = find_connected_connector(drm, resources, drmModeGetConnectorCurrent);
+	if (!connector)
+		connector = find_connected_connector(drm, resources, drmModeGetConnector);
 
 	if (!connector) {
 		/* we could be fancy and listen for hotplug events and wait for
@@ -222,21 +370,7 @@ int init_drm(struct drm *drm, const char *device)
 		return -1;
 	}
 
-	/* find preferred mode or the highest resolution mode: */
-	for (i = 0, area = 0; i < connector->count_modes; i++) {
-		drmModeModeInfo *current_mode = &connector->modes[i];
-
-		if (current_mode->type & DRM_MODE_TYPE_PREFERRED) {
-			drm->mode = current_mode;
-		}
-
-		int current_area = current_mode->hdisplay * current_mode->vdisplay;
-		if (current_area > area) {
-			drm->mode = current_mode;
-			area = current_area;
-		}
-	}
-
+	drm->mode = pick_mode(connector);
 	if (!drm->mode) {
 		printf("could not find mode!\n");
 		return -1;
@@ -276,3 +410,104 @@ int init_drm(struct drm *drm, const char *device)
 
 	return 0;
 }
+
+/* A CRTC not used yet that can drive the connector, preferring the one it
+ * is currently on:
+ */
+static int find_free_crtc(const struct drm *drm, const drmModeRes *resources,
+		const drmModeConnector *connector, uint32_t used)
+{
+	drmModeEncoder *encoder;
+	int i, j, crtc_index = -1;
+
+	encoder = connector->encoder_id ?
+			drmModeGetEncoder(drm->fd, connector->encoder_id) : NULL;
+	if (encoder) {
+		for (j = 0; j < resources->count_crtcs; j++) {
+			if (resources->crtcs[j] == encoder->crtc_id &&
+					!(used & (1 << j)))
+				crtc_index = j;
+		}
+		drmModeFreeEncoder(encoder);
+		if (crtc_index >= 0)
+			return crtc_index;
+	}
+
+	for (i = 0; i < connector->count_encoders && crtc_index < 0; i++) {
+		encoder = drmModeGetEncoder(drm->fd, connector->encoders[i]);
+		if (!encoder)
+			continue;
+
+		for (j = 0; j < resources->count_crtcs; j++) {
+			if ((encoder->possible_crtcs & (1 << j)) && !(used & (1 << j))) {
+				crtc_index = j;
+				break;
+			}
+		}
+		drmModeFreeEncoder(encoder);
+	}
+
+	return crtc_index;
+}
+
+int find_outputs(const struct drm *drm, struct drm_output *outputs, int max)
+{
+	drmModeRes *resources;
+	uint32_t used = 1 << drm->crtc_index;
+	int i, n = 1;
+
+	resources = drmModeGetResources(drm->fd);
+	if (!resources) {
+		printf("drmModeGetResources failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	outputs[0].connector_id = drm->connector_id;
+	outputs[0].crtc_id = drm->crtc_id;
+	outputs[0].crtc_index = drm->crtc_index;
+	outputs[0].mode = *drm->mode;
+
+	for (i = 0; i < resources->count_connectors && n < max; i++) {
+		drmModeConnector *connector;
+		int crtc_index;
+
+		if (resources->connectors[i] == drm->connector_id)
+			continue;
+
+		/* as for the first output, the kernel's current state first,
+		 * then a probe for connectors it hasn't looked at yet:
+		 */
+		connector = drmModeGetConnectorCurrent(drm->fd, resources->connectors[i]);
+		if (!connector || connector->connection != DRM_MODE_CONNECTED ||
+				connector->count_modes == 0) {
+			drmModeFreeConnector(connector);
+			connector = drmModeGetConnector(drm->fd, resources->connectors[i]);
+		}
+		if (!connector || connector->connection != DRM_MODE_CONNECTED ||
+				connector->count_modes == 0) {
+			drmModeFreeConnector(connector);
+			continue;
+		}
+
+		crtc_index = find_free_crtc(drm, resources, connector, used);
+		if (crtc_index < 0) {
+			printf("no free crtc for connector %u, skipping it\n",
+					connector->connector_id);
+			drmModeFreeConnector(connector);
+			continue;
+		}
+		used |= 1 << crtc_index;
+
+		outputs[n].connector_id = connector->connector_id;
+		outputs[n].crtc_id = resources->crtcs[crtc_index];
+		outputs[n].crtc_index = crtc_index;
+		outputs[n].mode = *pick_mode(connector);
+		n++;
+
+		drmModeFreeConnector(connector);
+	}
+
+	drmModeFreeResources(resources);
+
+	return n;
+}
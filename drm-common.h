@@ -24,6 +24,7 @@
 #ifndef _DRM_COMMON_H
 #define _DRM_COMMON_H
 
+#include <stdbool.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 
@@ -48,6 +49,27 @@ struct connector {
 	drmModePropertyRes **props_info;
 };
 
+/* A layer renders into buffers of its own which the display engine
+ * scans out on a separate plane and blends over the scene, instead of
+ * the GPU drawing it into the scene.  draw() is only called, and the
+ * plane only updated, when changed() says the layer no longer matches
+ * what is on screen:
+ */
+struct layer {
+	const char *name;
+	int width, height;                     /* of the buffers */
+	uint32_t src_x, src_y, src_w, src_h;   /* part of the buffer shown */
+	int32_t crtc_x, crtc_y;                /* where it goes on the crtc, */
+	uint32_t crtc_w, crtc_h;               /* scaled to this size */
+	unsigned zpos;                         /* above the scene's plane */
+	uint16_t alpha;                        /* plane alpha, 0xffff opaque */
+	uint32_t format;                       /* eg. ARGB8888 to blend per pixel,
+	                                          0 for the scene's XRGB8888 */
+
+	bool (*changed)(void);
+	void (*draw)(const struct egl *egl);
+};
+
 struct drm {
 	int fd;
 
@@ -58,6 +80,8 @@ struct drm {
 	int crtc_index;
 	int kms_in_fence_fd;
 	int kms_out_fence_fd;
+	/* put a layer on a plane of its own, before run(): */
+	int (*add_layer)(struct layer *layer);
 
 	drmModeModeInfo *mode;
 	uint32_t crtc_id;
@@ -72,18 +96,44 @@ struct drm_fb {
 };
 
 struct drm_fb * drm_fb_get_from_bo(struct gbm_bo *bo);
-#ifdef HAVE_ALLOCATOR
 struct drm_fb * drm_fb_get_from_gem(int drm_fd,
 									uint32_t gemHandle,
 									uint32_t width,
 									uint32_t height,
-									size_t metadata_size,
-									void *metadata);
-#endif
+									uint32_t stride,
+									uint64_t modifier);
 void drm_fb_destroy(int drm_fd, struct drm_fb *fb);
 
+/* CPU mapped XRGB8888 dumb buffer with a KMS framebuffer: */
+struct drm_dumb {
+	uint32_t handle;
+	uint32_t width, height, pitch;
+	uint64_t size;
+	uint8_t *map;
+	struct drm_fb *fb;
+};
+
+struct drm_dumb * drm_dumb_create(int drm_fd, uint32_t width, uint32_t height);
+void drm_dumb_destroy(int drm_fd, struct drm_dumb *dumb);
+
+/* Are the two fds opened on the same DRM device (card or render node)? */
+bool drm_same_device(int fd_a, int fd_b);
+
 int init_drm(struct drm *drm, const char *device);
 const struct drm * init_drm_legacy(const char *device);
-const struct drm * init_drm_atomic(const char *device);
+const struct drm * init_drm_atomic(const char *device, bool all_outputs);
+
+/* A connected connector with a CRTC of its own: */
+struct drm_output {
+	uint32_t connector_id;
+	uint32_t crtc_id;
+	int crtc_index;
+	drmModeModeInfo mode;
+};
+
+/* every connected connector that can be driven at the same time, the
+ * one init_drm() picked first; returns how many, at most max:
+ */
+int find_outputs(const struct drm *drm, struct drm_output *outputs, int max);
 
 #endif /* _DRM_COMMON_H */
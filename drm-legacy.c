@@ -28,17 +28,28 @@
 
 #include "common.h"
 #include "drm-common.h"
+#include "probes.h"
+#include "surface-manager.h"
+#include "trace.h"
 
 static struct drm drm;
 
+static int64_t flip_ns;
+
 static void page_flip_handler(int fd, unsigned int frame,
 		  unsigned int sec, unsigned int usec, void *data)
 {
 	/* suppress 'unused parameter' warnings */
-	(void)fd, (void)frame, (void)sec, (void)usec;
+	(void)fd, (void)frame;
 
 	int *waiting_for_flip = data;
 	*waiting_for_flip = 0;
+
+	/* the kernel timestamps the vblank the flip completed on: */
+	flip_ns = sec * NSEC_PER_SEC + usec * 1000;
+
+	trace_instant("flip", frame);
+	PROBE1(flip_complete, frame);
 }
 
 static int legacy_run(const struct surfmgr *surfmgr, const struct egl *egl)
@@ -48,7 +59,6 @@ static int legacy_run(const struct surfmgr *surfmgr, const struct egl *egl)
 			.version = 2,
 			.page_flip_handler = page_flip_handler,
 	};
-	struct gbm_bo *bo;
 	struct drm_fb *fb;
 	uint32_t i = 0;
 	int ret;
@@ -57,9 +67,10 @@ static int legacy_run(const struct surfmgr *surfmgr, const struct egl *egl)
 	FD_SET(0, &fds);
 	FD_SET(drm.fd, &fds);
 
-	eglSwapBuffers(egl->display, egl->surface);
-	bo = gbm_surface_lock_front_buffer(surfmgr->gbm->surface);
-	fb = drm_fb_get_from_bo(bo);
+	startup_begin(STARTUP_FIRST_FRAME);
+
+	surfmgr_end_frame(surfmgr, egl, NULL);
+	fb = surfmgr_get_next_fb(surfmgr);
 	if (!fb) {
 		fprintf(stderr, "Failed to get a new framebuffer BO\n");
 		return -1;
@@ -73,16 +84,23 @@ static int legacy_run(const struct surfmgr *surfmgr, const struct egl *egl)
 		return ret;
 	}
 
-	while (1) {
-		struct gbm_bo *next_bo;
+	startup_end(STARTUP_FIRST_FRAME);
+	startup_report();
+
+	while (keep_running(i)) {
+		struct drm_fb *next_fb;
 		int waiting_for_flip = 1;
 
-		egl->draw(i++);
+		PROBE1(frame_start, i);
+		draw_frame(egl, i++);
 
-		eglSwapBuffers(egl->display, egl->surface);
-		next_bo = gbm_surface_lock_front_buffer(surfmgr->gbm->surface);
-		fb = drm_fb_get_from_bo(next_bo);
-		if (!fb) {
+		frame_begin(FRAME_SWAP);
+		trace_begin("end_frame");
+		surfmgr_end_frame(surfmgr, egl, NULL);
+		next_fb = surfmgr_get_next_fb(surfmgr);
+		trace_end("end_frame");
+		frame_end(FRAME_SWAP);
+		if (!next_fb) {
 			fprintf(stderr, "Failed to get a new framebuffer BO\n");
 			return -1;
 		}
@@ -92,16 +110,26 @@ static int legacy_run(const struct surfmgr *surfmgr, const struct egl *egl)
 		 * hw composition
 		 */
 
-		ret = drmModePageFlip(drm.fd, drm.crtc_id, fb->fb_id,
+		PROBE2(page_flip, i - 1, next_fb->fb_id);
+		frame_begin(FRAME_COMMIT);
+		trace_begin("page flip");
+		ret = drmModePageFlip(drm.fd, drm.crtc_id, next_fb->fb_id,
 				DRM_MODE_PAGE_FLIP_EVENT, &waiting_for_flip);
+		trace_end("page flip");
+		frame_end(FRAME_COMMIT);
 		if (ret) {
 			printf("failed to queue page flip: %s\n", strerror(errno));
 			return -1;
 		}
 
+		frame_begin(FRAME_WAIT);
+		trace_begin("flip wait");
 		while (waiting_for_flip) {
 			ret = select(drm.fd + 1, &fds, NULL, NULL, NULL);
-			if (ret < 0) {
+			if (ret < 0 && errno == EINTR) {
+				/* quit requested, finish this flip first */
+				continue;
+			} else if (ret < 0) {
 				printf("select err: %s\n", strerror(errno));
 				return ret;
 			} else if (ret == 0) {
@@ -113,10 +141,16 @@ static int legacy_run(const struct surfmgr *surfmgr, const struct egl *egl)
 			}
 			drmHandleEvent(drm.fd, &evctx);
 		}
+		trace_end("flip wait");
+		frame_end(FRAME_WAIT);
+
+		frame_presented(i - 1, flip_ns);
 
 		/* release last buffer to render on again: */
-		gbm_surface_release_buffer(surfmgr->gbm->surface, bo);
-		bo = next_bo;
+		surfmgr_release_fb(surfmgr, fb);
+		fb = next_fb;
+
+		frame_report();
 	}
 
 	return 0;
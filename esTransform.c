@@ -44,8 +44,124 @@
 #include <math.h>
 #include <string.h>
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define ES_HAVE_SIMD 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ES_HAVE_SIMD 1
+#endif
+
 #define PI 3.1415926535897932384626433832795f
 
+static GLboolean useSimd = GL_TRUE;
+
+///
+//  Vector kernels
+//
+//  Transforming vectors is "row = sum of scaled rows": out = in[0] * m row 0
+//  + in[1] * m row 1 + ... which maps onto four-wide SIMD directly, and
+//  pays off over a batch of them.  A single 4x4 multiply or rotate is too
+//  short for that to beat what the compiler makes of the scalar loop, so
+//  those stay scalar.  The scalar transform is kept for other
+//  architectures and for comparison (see esSetSimd()).
+//
+
+static void
+multiplyScalar(ESMatrix *dst, const ESMatrix *a, const ESMatrix *b, int rows)
+{
+    int i, j;
+
+    for (i = 0; i < rows; i++)
+        for (j = 0; j < 4; j++)
+            dst->m[i][j] = a->m[i][0] * b->m[0][j] +
+                           a->m[i][1] * b->m[1][j] +
+                           a->m[i][2] * b->m[2][j] +
+                           a->m[i][3] * b->m[3][j];
+}
+
+static void
+transformScalar(const ESMatrix *m, const GLfloat *in, GLfloat *out, int count)
+{
+    int i, j;
+
+    for (i = 0; i < count; i++, in += 4, out += 4)
+    {
+        GLfloat v[4] = { in[0], in[1], in[2], in[3] };
+
+        for (j = 0; j < 4; j++)
+            out[j] = v[0] * m->m[0][j] + v[1] * m->m[1][j] +
+                     v[2] * m->m[2][j] + v[3] * m->m[3][j];
+    }
+}
+
+#if defined(__SSE__)
+static void
+transformSimd(const ESMatrix *m, const GLfloat *in, GLfloat *out, int count)
+{
+    __m128 m0 = _mm_loadu_ps(m->m[0]);
+    __m128 m1 = _mm_loadu_ps(m->m[1]);
+    __m128 m2 = _mm_loadu_ps(m->m[2]);
+    __m128 m3 = _mm_loadu_ps(m->m[3]);
+    int i;
+
+    for (i = 0; i < count; i++, in += 4, out += 4)
+    {
+        __m128 v = _mm_loadu_ps(in);
+        __m128 r = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(v, v, 0x00), m0),
+                       _mm_mul_ps(_mm_shuffle_ps(v, v, 0x55), m1)),
+            _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(v, v, 0xaa), m2),
+                       _mm_mul_ps(_mm_shuffle_ps(v, v, 0xff), m3)));
+        _mm_storeu_ps(out, r);
+    }
+}
+#elif defined(__ARM_NEON)
+static void
+transformSimd(const ESMatrix *m, const GLfloat *in, GLfloat *out, int count)
+{
+    float32x4_t m0 = vld1q_f32(m->m[0]);
+    float32x4_t m1 = vld1q_f32(m->m[1]);
+    float32x4_t m2 = vld1q_f32(m->m[2]);
+    float32x4_t m3 = vld1q_f32(m->m[3]);
+    int i;
+
+    for (i = 0; i < count; i++, in += 4, out += 4)
+    {
+        float32x4_t v = vld1q_f32(in);
+        float32x4_t r;
+
+        r = vmulq_lane_f32(m0, vget_low_f32(v), 0);
+        r = vmlaq_lane_f32(r, m1, vget_low_f32(v), 1);
+        r = vmlaq_lane_f32(r, m2, vget_high_f32(v), 0);
+        r = vmlaq_lane_f32(r, m3, vget_high_f32(v), 1);
+        vst1q_f32(out, r);
+    }
+}
+#endif
+
+static void
+multiplyRows(ESMatrix *dst, const ESMatrix *a, const ESMatrix *b, int rows)
+{
+    ESMatrix tmp;
+
+    multiplyScalar(&tmp, a, b, rows);
+    memcpy(dst, &tmp, rows * sizeof(tmp.m[0]));
+}
+
+GLboolean ESUTIL_API
+esSetSimd(GLboolean enable)
+{
+#ifdef ES_HAVE_SIMD
+    useSimd = enable;
+    return useSimd;
+#else
+    (void)enable;
+    useSimd = GL_FALSE;
+    return GL_FALSE;
+#endif
+}
+
 void ESUTIL_API
 esScale(ESMatrix *result, GLfloat sx, GLfloat sy, GLfloat sz)
 {
@@ -118,12 +234,9 @@ esRotate(ESMatrix *result, GLfloat angle, GLfloat x, GLfloat y, GLfloat z)
       rotMat.m[2][2] = (oneMinusCos * zz) + cosAngle;
       rotMat.m[2][3] = 0.0F; 
 
-      rotMat.m[3][0] = 0.0F;
-      rotMat.m[3][1] = 0.0F;
-      rotMat.m[3][2] = 0.0F;
-      rotMat.m[3][3] = 1.0F;
-
-      esMatrixMultiply( result, &rotMat, result );
+      /* the last row would be (0, 0, 0, 1), which leaves row 3 of
+       * result unchanged, so only multiply the first three: */
+      multiplyRows( result, &rotMat, result, 3 );
    }
 }
 
@@ -194,32 +307,21 @@ esOrtho(ESMatrix *result, float left, float right, float bottom, float top, floa
 void ESUTIL_API
 esMatrixMultiply(ESMatrix *result, ESMatrix *srcA, ESMatrix *srcB)
 {
-    ESMatrix    tmp;
-    int         i;
-
-	for (i=0; i<4; i++)
-	{
-		tmp.m[i][0] =	(srcA->m[i][0] * srcB->m[0][0]) +
-						(srcA->m[i][1] * srcB->m[1][0]) +
-						(srcA->m[i][2] * srcB->m[2][0]) +
-						(srcA->m[i][3] * srcB->m[3][0]) ;
-
-		tmp.m[i][1] =	(srcA->m[i][0] * srcB->m[0][1]) + 
-						(srcA->m[i][1] * srcB->m[1][1]) +
-						(srcA->m[i][2] * srcB->m[2][1]) +
-						(srcA->m[i][3] * srcB->m[3][1]) ;
-
-		tmp.m[i][2] =	(srcA->m[i][0] * srcB->m[0][2]) + 
-						(srcA->m[i][1] * srcB->m[1][2]) +
-						(srcA->m[i][2] * srcB->m[2][2]) +
-						(srcA->m[i][3] * srcB->m[3][2]) ;
-
-		tmp.m[i][3] =	(srcA->m[i][0] * srcB->m[0][3]) + 
-						(srcA->m[i][1] * srcB->m[1][3]) +
-						(srcA->m[i][2] * srcB->m[2][3]) +
-						(srcA->m[i][3] * srcB->m[3][3]) ;
-	}
-    memcpy(result, &tmp, sizeof(ESMatrix));
+    multiplyRows(result, srcA, srcB, 4);
+}
+
+
+void ESUTIL_API
+esMatrixTransform(const ESMatrix *matrix, const GLfloat *in, GLfloat *out, int count)
+{
+#ifdef ES_HAVE_SIMD
+    if (useSimd)
+    {
+        transformSimd(matrix, in, out, count);
+        return;
+    }
+#endif
+    transformScalar(matrix, in, out, count);
 }
 
 
@@ -290,6 +290,20 @@ void ESUTIL_API esOrtho(ESMatrix *result, float left, float right, float bottom,
 //
 void ESUTIL_API esMatrixMultiply(ESMatrix *result, ESMatrix *srcA, ESMatrix *srcB);
 
+//
+/// \brief transform count vec4s by matrix (out = in * matrix), in and out may alias
+/// \param matrix Transformation matrix
+/// \param in, out Arrays of count x/y/z/w vectors
+//
+void ESUTIL_API esMatrixTransform(const ESMatrix *matrix, const GLfloat *in, GLfloat *out, int count);
+
+//
+/// \brief select the SIMD (SSE/NEON) or scalar esMatrixTransform() kernel, SIMD is the default where available
+/// \param enable GL_TRUE to use SIMD kernels
+/// \return whether SIMD kernels are in use
+//
+GLboolean ESUTIL_API esSetSimd(GLboolean enable);
+
 //
 //// \brief return an indentity matrix 
 //// \param result returns identity matrix
@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "frames.h"
+
+struct frames_reader {
+	int fd;
+	const uint8_t *map;
+	size_t size;
+	size_t page_size;
+
+	/* start of each frame's data within the mapping: */
+	size_t *offsets;
+	unsigned window;
+
+	pthread_t thread;
+	bool started;
+
+	/* sequence numbers, counting up across loops of the file: the
+	 * next frame to hand out, and the first one not yet resident:
+	 */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned consumed;
+	unsigned prefetched;
+	bool quit;
+};
+
+static const char *format_names[] = {
+	[FRAME_RGBA] = "rgba",
+	[FRAME_NV12] = "nv12",
+	[FRAME_I420] = "i420",
+	[FRAME_P010] = "p010",
+};
+
+static size_t frame_size(enum frame_format format, unsigned width, unsigned height)
+{
+	size_t pixels = (size_t)width * height;
+
+	switch (format) {
+	case FRAME_RGBA:
+		return pixels * 4;
+	case FRAME_P010:
+		return pixels * 3;
+	default:
+		return pixels * 3 / 2;
+	}
+}
+
+const char * frames_format_name(enum frame_format format)
+{
+	return format_names[format];
+}
+
+int frames_parse_format(const char *format, enum frame_format *fmt,
+						unsigned *width, unsigned *height)
+{
+	const char *sep = strchr(format, ':');
+	size_t len = sep ? (size_t)(sep - format) : strlen(format);
+	unsigned i;
+
+	for (i = 0; i < sizeof(format_names) / sizeof(format_names[0]); i++) {
+		if (strlen(format_names[i]) == len && !strncmp(format, format_names[i], len))
+			break;
+	}
+	if (i == sizeof(format_names) / sizeof(format_names[0])) {
+		printf("invalid frame format: %.*s\n", (int)len, format);
+		return -1;
+	}
+	*fmt = i;
+
+	if (sep && (sscanf(sep + 1, "%ux%u", width, height) != 2 ||
+				!*width || !*height)) {
+		printf("invalid frame size: %s\n", sep + 1);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int init_raw(struct frames *frames, const char *format)
+{
+	struct frames_reader *r = frames->reader;
+	unsigned i;
+
+	if (!format || !strchr(format, ':')) {
+		printf("raw frames need a FORMAT:WxH frame format\n");
+		return -1;
+	}
+	if (frames_parse_format(format, &frames->format, &frames->width, &frames->height))
+		return -1;
+
+	frames->frame_size = frame_size(frames->format, frames->width, frames->height);
+	frames->count = r->size / frames->frame_size;
+	if (r->size % frames->frame_size)
+		printf("ignoring %zu trailing bytes\n", r->size % frames->frame_size);
+
+	r->offsets = calloc(frames->count, sizeof(*r->offsets));
+	if (!r->offsets)
+		return -1;
+	for (i = 0; i < frames->count; i++)
+		r->offsets[i] = i * frames->frame_size;
+
+	return 0;
+}
+
+/* find the end of the header line starting at pos: */
+static const uint8_t * line_end(struct frames_reader *r, size_t pos)
+{
+	if (pos >= r->size)
+		return NULL;
+	return memchr(r->map + pos, '\n', r->size - pos);
+}
+
+static int init_y4m(struct frames *frames)
+{
+	struct frames_reader *r = frames->reader;
+	const uint8_t *end = line_end(r, 0);
+	char header[256], *tok, *save;
+	size_t pos;
+
+	if (!end || end - r->map >= (ptrdiff_t)sizeof(header)) {
+		printf("invalid y4m header\n");
+		return -1;
+	}
+	memcpy(header, r->map, end - r->map);
+	header[end - r->map] = '\0';
+
+	/* 8-bit 4:2:0 is the default, and the only format handled; the
+	 * various C420 variants only differ in chroma siting, but the
+	 * C420p10/C420p12 ones have 16-bit samples:
+	 */
+	frames->format = FRAME_I420;
+	for (tok = strtok_r(header, " ", &save); tok; tok = strtok_r(NULL, " ", &save)) {
+		switch (tok[0]) {
+		case 'W':
+			frames->width = strtoul(tok + 1, NULL, 10);
+			break;
+		case 'H':
+			frames->height = strtoul(tok + 1, NULL, 10);
+			break;
+		case 'C':
+			if (strcmp(tok, "C420") && strcmp(tok, "C420jpeg") &&
+			    strcmp(tok, "C420paldv") && strcmp(tok, "C420mpeg2")) {
+				printf("unsupported y4m colorspace: %s\n", tok);
+				return -1;
+			}
+			break;
+		}
+	}
+
+	frames->frame_size = frame_size(frames->format, frames->width, frames->height);
+	if (!frames->frame_size) {
+		printf("invalid y4m frame size\n");
+		return -1;
+	}
+
+	/* each frame has its own header line, which may carry parameters,
+	 * so walk them once up front:
+	 */
+	pos = end - r->map + 1;
+	while ((end = line_end(r, pos))) {
+		size_t *offsets;
+
+		if (strncmp((const char *)r->map + pos, "FRAME", 5)) {
+			printf("invalid y4m frame header at %zu\n", pos);
+			return -1;
+		}
+		pos = end - r->map + 1;
+		if (r->size - pos < frames->frame_size)
+			break;
+
+		if (!(frames->count & (frames->count - 1))) {
+			offsets = realloc(r->offsets,
+					(frames->count ? frames->count * 2 : 1) * sizeof(*offsets));
+			if (!offsets)
+				return -1;
+			r->offsets = offsets;
+		}
+		r->offsets[frames->count++] = pos;
+		pos += frames->frame_size;
+	}
+
+	return 0;
+}
+
+/* the page aligned range covering a frame, rounded outwards to pull in
+ * all of it, or inwards to drop only pages no other frame shares:
+ */
+static void frame_pages(struct frames *frames, unsigned i, bool outer,
+		uintptr_t *start, size_t *len)
+{
+	struct frames_reader *r = frames->reader;
+	uintptr_t mask = r->page_size - 1;
+	uintptr_t begin = (uintptr_t)r->map + r->offsets[i];
+	uintptr_t end = begin + frames->frame_size;
+
+	if (outer) {
+		begin &= ~mask;
+		end = (end + mask) & ~mask;
+	} else {
+		begin = (begin + mask) & ~mask;
+		end &= ~mask;
+	}
+
+	*start = begin;
+	*len = end > begin ? end - begin : 0;
+}
+
+static void fetch_frame(struct frames *frames, unsigned i)
+{
+	struct frames_reader *r = frames->reader;
+	const volatile uint8_t *p;
+	uintptr_t start;
+	size_t len, off;
+
+	frame_pages(frames, i, true, &start, &len);
+	madvise((void *)start, len, MADV_WILLNEED);
+
+	/* WILLNEED only starts the reads, touching each page waits for
+	 * them and maps the pages in:
+	 */
+	p = (const volatile uint8_t *)start;
+	for (off = 0; off < len; off += r->page_size)
+		(void)p[off];
+}
+
+static void drop_frame(struct frames *frames, unsigned i)
+{
+	uintptr_t start;
+	size_t len;
+
+	frame_pages(frames, i, false, &start, &len);
+	if (len)
+		madvise((void *)start, len, MADV_DONTNEED);
+}
+
+static void * readahead_thread(void *arg)
+{
+	struct frames *frames = arg;
+	struct frames_reader *r = frames->reader;
+	/* only drop frames when the whole file doesn't fit the window: */
+	bool drop = frames->count > r->window + 1;
+
+	pthread_mutex_lock(&r->lock);
+	while (!r->quit) {
+		unsigned seq;
+
+		/* skip frames already handed out if we fell behind: */
+		if ((int)(r->prefetched - r->consumed) < 0)
+			r->prefetched = r->consumed;
+
+		if (r->prefetched - r->consumed >= r->window) {
+			pthread_cond_wait(&r->cond, &r->lock);
+			continue;
+		}
+
+		seq = r->prefetched;
+		pthread_mutex_unlock(&r->lock);
+
+		fetch_frame(frames, seq % frames->count);
+		if (drop && seq > r->window)
+			drop_frame(frames, (seq - r->window - 1) % frames->count);
+
+		pthread_mutex_lock(&r->lock);
+		if (r->prefetched == seq)
+			r->prefetched = seq + 1;
+	}
+	pthread_mutex_unlock(&r->lock);
+
+	return NULL;
+}
+
+struct frames * frames_open(const char *path, const char *format,
+							unsigned window)
+{
+	struct frames *frames;
+	struct frames_reader *r;
+	struct stat st;
+	int ret;
+
+	frames = calloc(1, sizeof(*frames));
+	r = calloc(1, sizeof(*r));
+	if (!frames || !r) {
+		free(frames);
+		free(r);
+		return NULL;
+	}
+	frames->reader = r;
+	r->fd = -1;
+	r->window = window ? window : 1;
+	r->page_size = sysconf(_SC_PAGESIZE);
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->cond, NULL);
+
+	r->fd = open(path, O_RDONLY);
+	if (r->fd < 0) {
+		printf("could not open %s: %s\n", path, strerror(errno));
+		goto fail;
+	}
+
+	if (fstat(r->fd, &st) || !st.st_size) {
+		printf("could not read %s\n", path);
+		goto fail;
+	}
+	r->size = st.st_size;
+
+	r->map = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+	if (r->map == MAP_FAILED) {
+		printf("could not map %s: %s\n", path, strerror(errno));
+		r->map = NULL;
+		goto fail;
+	}
+	madvise((void *)r->map, r->size, MADV_SEQUENTIAL);
+
+	if (r->size > 10 && !memcmp(r->map, "YUV4MPEG2 ", 10))
+		ret = init_y4m(frames);
+	else
+		ret = init_raw(frames, format);
+	if (ret)
+		goto fail;
+
+	if (!frames->count) {
+		printf("no complete frames in %s\n", path);
+		goto fail;
+	}
+
+	/* chroma is subsampled 2x2: */
+	if (frames->format != FRAME_RGBA &&
+			(frames->width % 2 || frames->height % 2)) {
+		printf("odd %ux%u frame size for %s frames\n",
+				frames->width, frames->height, format_names[frames->format]);
+		goto fail;
+	}
+
+	ret = pthread_create(&r->thread, NULL, readahead_thread, frames);
+	if (ret) {
+		printf("could not start readahead thread: %s\n", strerror(ret));
+		goto fail;
+	}
+	r->started = true;
+
+	printf("Streaming %u %ux%u %s frames from %s, %u frames ahead\n",
+			frames->count, frames->width, frames->height,
+			format_names[frames->format], path, r->window);
+
+	return frames;
+
+fail:
+	frames_close(frames);
+	return NULL;
+}
+
+struct frames * frames_open_builtin(enum frame_format format)
+{
+	const char *dir = getenv("KMSCUBE_DATADIR");
+	bool rgba = format == FRAME_RGBA;
+	char path[4096];
+
+	snprintf(path, sizeof(path), "%s/frame-512x512-%s.raw",
+			dir ? dir : PKGDATADIR, rgba ? "RGBA" : "NV12");
+
+	return frames_open(path, rgba ? "rgba:512x512" : "nv12:512x512", 1);
+}
+
+const void * frames_next(struct frames *frames)
+{
+	struct frames_reader *r = frames->reader;
+	const uint8_t *frame;
+
+	pthread_mutex_lock(&r->lock);
+	if ((int)(r->prefetched - r->consumed) <= 0)
+		frames->stalls++;
+	frame = r->map + r->offsets[r->consumed % frames->count];
+	r->consumed++;
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+
+	return frame;
+}
+
+void frames_close(struct frames *frames)
+{
+	struct frames_reader *r;
+
+	if (!frames)
+		return;
+
+	r = frames->reader;
+	if (r->started) {
+		pthread_mutex_lock(&r->lock);
+		r->quit = true;
+		pthread_cond_signal(&r->cond);
+		pthread_mutex_unlock(&r->lock);
+		pthread_join(r->thread, NULL);
+	}
+
+	if (r->map)
+		munmap((void *)r->map, r->size);
+	if (r->fd >= 0)
+		close(r->fd);
+	pthread_mutex_destroy(&r->lock);
+	pthread_cond_destroy(&r->cond);
+	free(r->offsets);
+	free(r);
+	free(frames);
+}
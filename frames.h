@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _FRAMES_H
+#define _FRAMES_H
+
+#include <stddef.h>
+
+/* Raw frames streamed from a file, for the textured modes: either a
+ * headerless file of back to back frames, described by a FORMAT:WxH
+ * string (eg. "nv12:1920x1080"), or a YUV4MPEG2 (.y4m) 4:2:0 sequence.
+ *
+ * The file is mmap()ed, and a readahead thread keeps a window of the
+ * upcoming frames resident, so copying a frame out never waits on the
+ * disk as long as the disk keeps up.  Frames behind the window are
+ * dropped from the mapping again.  The sequence loops at the end.
+ */
+
+enum frame_format {
+	FRAME_RGBA,     /* bytes R, G, B, A (DRM_FORMAT_ABGR8888) */
+	FRAME_NV12,
+	FRAME_I420,
+	FRAME_P010,     /* NV12 layout, 10 bits in the top of 16 */
+};
+
+struct frames_reader;
+
+struct frames {
+	enum frame_format format;
+	unsigned width, height;
+	unsigned count;
+	size_t frame_size;
+
+	/* frames not (yet) resident when they were needed: */
+	unsigned stalls;
+
+	struct frames_reader *reader;
+};
+
+/* FORMAT[:WxH], the size is left alone if not given: */
+int frames_parse_format(const char *format, enum frame_format *fmt,
+						unsigned *width, unsigned *height);
+const char * frames_format_name(enum frame_format format);
+
+/* format is ignored for .y4m files */
+struct frames * frames_open(const char *path, const char *format,
+							unsigned window);
+/* The built-in 512x512 RGBA or NV12 test image, installed as a .raw
+ * file in PKGDATADIR, or $KMSCUBE_DATADIR if set (eg. to run from the
+ * source tree):
+ */
+#ifndef PKGDATADIR
+#define PKGDATADIR "/usr/local/share/kmscube"
+#endif
+
+struct frames * frames_open_builtin(enum frame_format format);
+/* the next frame, valid until the following call: */
+const void * frames_next(struct frames *frames);
+void frames_close(struct frames *frames);
+
+#endif /* _FRAMES_H */
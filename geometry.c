@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES3/gl3.h>
+
+#include "geometry.h"
+
+#ifndef GL_HALF_FLOAT_OES
+#define GL_HALF_FLOAT_OES 0x8D61
+#endif
+
+enum geometry_layout geometry_layout = GEOMETRY_SPLIT;
+
+/* how one attribute is stored in the buffer: */
+struct attrib_format {
+	GLenum type;
+	GLint size;
+	GLboolean normalized;
+	unsigned bytes;
+	unsigned offset;
+};
+
+static const GLint num_components[] = {
+	[ATTRIB_POSITION] = 3,
+	[ATTRIB_NORMAL]   = 3,
+	[ATTRIB_COLOR]    = 3,
+	[ATTRIB_TEXCOORD] = 2,
+};
+
+int parse_geometry_layout(const char *name)
+{
+	if (strcmp(name, "split") == 0)
+		return GEOMETRY_SPLIT;
+	else if (strcmp(name, "interleaved") == 0)
+		return GEOMETRY_INTERLEAVED;
+	else if (strcmp(name, "packed") == 0)
+		return GEOMETRY_PACKED;
+	return -1;
+}
+
+/* no denormals, infinities or NaNs in vertex data, so keep it simple: */
+static GLushort float_to_half(GLfloat f)
+{
+	union { GLfloat f; uint32_t u; } v = { f };
+	uint32_t sign = (v.u >> 16) & 0x8000;
+	int32_t exp = (int32_t)((v.u >> 23) & 0xff) - 127 + 15;
+
+	if (exp <= 0)
+		return sign;
+	if (exp >= 31)
+		return sign | 0x7c00;
+	return sign | (exp << 10) | ((v.u & 0x7fffff) >> 13);
+}
+
+static uint32_t pack_2_10_10_10(const GLfloat *v)
+{
+	uint32_t x = (uint32_t)lrintf(v[0] * 511.0f) & 0x3ff;
+	uint32_t y = (uint32_t)lrintf(v[1] * 511.0f) & 0x3ff;
+	uint32_t z = (uint32_t)lrintf(v[2] * 511.0f) & 0x3ff;
+
+	return x | (y << 10) | (z << 20);
+}
+
+static void packed_format(const struct egl *egl, enum attrib_kind kind,
+						  struct attrib_format *fmt)
+{
+	bool es3 = egl->gl_major >= 3;
+
+	fmt->normalized = GL_TRUE;
+
+	switch (kind) {
+	case ATTRIB_POSITION:
+		if (es3 || gl_has_extension("GL_OES_vertex_half_float")) {
+			fmt->type = es3 ? GL_HALF_FLOAT : GL_HALF_FLOAT_OES;
+			fmt->normalized = GL_FALSE;
+		} else {
+			fmt->type = GL_SHORT;
+		}
+		fmt->size = 4;
+		fmt->bytes = 8;
+		break;
+	case ATTRIB_NORMAL:
+		fmt->type = es3 ? GL_INT_2_10_10_10_REV : GL_BYTE;
+		fmt->size = 4;
+		fmt->bytes = 4;
+		break;
+	case ATTRIB_COLOR:
+		fmt->type = GL_UNSIGNED_BYTE;
+		fmt->size = 4;
+		fmt->bytes = 4;
+		break;
+	case ATTRIB_TEXCOORD:
+		fmt->type = GL_UNSIGNED_SHORT;
+		fmt->size = 2;
+		fmt->bytes = 4;
+		break;
+	}
+}
+
+static void encode(const struct attrib_format *fmt, enum attrib_kind kind,
+				   const GLfloat *v, uint8_t *dst)
+{
+	int i, n = num_components[kind];
+
+	switch (fmt->type) {
+	case GL_FLOAT:
+		memcpy(dst, v, n * sizeof(GLfloat));
+		break;
+	case GL_HALF_FLOAT:
+	case GL_HALF_FLOAT_OES: {
+		GLushort *h = (GLushort *)dst;
+		for (i = 0; i < 3; i++)
+			h[i] = float_to_half(v[i]);
+		h[3] = float_to_half(1.0f);
+		break;
+	}
+	case GL_SHORT: {
+		GLshort *s = (GLshort *)dst;
+		for (i = 0; i < 3; i++)
+			s[i] = lrintf(v[i] * 32767.0f);
+		s[3] = 32767;
+		break;
+	}
+	case GL_INT_2_10_10_10_REV: {
+		uint32_t p = pack_2_10_10_10(v);
+		memcpy(dst, &p, sizeof(p));
+		break;
+	}
+	case GL_BYTE: {
+		GLbyte *b = (GLbyte *)dst;
+		for (i = 0; i < 3; i++)
+			b[i] = lrintf(v[i] * 127.0f);
+		b[3] = 0;
+		break;
+	}
+	case GL_UNSIGNED_BYTE:
+		for (i = 0; i < 3; i++)
+			dst[i] = lrintf(v[i] * 255.0f);
+		dst[3] = 255;
+		break;
+	case GL_UNSIGNED_SHORT: {
+		GLushort *s = (GLushort *)dst;
+		for (i = 0; i < n; i++)
+			s[i] = lrintf(v[i] * 65535.0f);
+		break;
+	}
+	}
+}
+
+int init_geometry(struct geometry *geom, const struct egl *egl,
+				  const struct geometry_attrib *attribs, unsigned num_attribs,
+				  unsigned num_vertices)
+{
+	struct attrib_format fmts[MAX_GEOMETRY_ATTRIBS];
+	unsigned i, j, size = 0;
+	uint8_t *data;
+
+	if (num_attribs > MAX_GEOMETRY_ATTRIBS)
+		return -1;
+
+	geom->layout = geometry_layout;
+	geom->num_vertices = num_vertices;
+	geom->num_indices = 0;
+	geom->ibo = 0;
+
+	for (i = 0; i < num_attribs; i++) {
+		if (geom->layout == GEOMETRY_PACKED) {
+			packed_format(egl, attribs[i].kind, &fmts[i]);
+		} else {
+			fmts[i].type = GL_FLOAT;
+			fmts[i].size = num_components[attribs[i].kind];
+			fmts[i].normalized = GL_FALSE;
+			fmts[i].bytes = fmts[i].size * sizeof(GLfloat);
+		}
+	}
+
+	/* split keeps each attribute in its own region of the buffer,
+	 * otherwise they're interleaved into a single vertex struct:
+	 */
+	for (i = 0; i < num_attribs; i++) {
+		fmts[i].offset = size;
+		if (geom->layout == GEOMETRY_SPLIT)
+			size += fmts[i].bytes * num_vertices;
+		else
+			size += fmts[i].bytes;
+	}
+
+	if (geom->layout == GEOMETRY_SPLIT) {
+		geom->stride = 0;
+	} else {
+		geom->stride = size;
+		size *= num_vertices;
+	}
+
+	data = malloc(size);
+	if (!data)
+		return -1;
+
+	for (i = 0; i < num_attribs; i++) {
+		const GLfloat *v = attribs[i].data;
+		unsigned n = num_components[attribs[i].kind];
+
+		for (j = 0; j < num_vertices; j++, v += n) {
+			unsigned offset = fmts[i].offset +
+				j * (geom->stride ? geom->stride : fmts[i].bytes);
+			encode(&fmts[i], attribs[i].kind, v, data + offset);
+		}
+	}
+
+	glGenBuffers(1, &geom->vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, geom->vbo);
+	glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+	free(data);
+
+	for (i = 0; i < num_attribs; i++) {
+		glVertexAttribPointer(attribs[i].location, fmts[i].size, fmts[i].type,
+							  fmts[i].normalized, geom->stride,
+							  (const GLvoid *)(intptr_t)fmts[i].offset);
+		glEnableVertexAttribArray(attribs[i].location);
+	}
+
+	if (geom->layout != GEOMETRY_SPLIT) {
+		GLushort *indices;
+
+		/* two triangles per 4-vertex strip, same winding as the strip: */
+		geom->num_indices = num_vertices / 4 * 6;
+		indices = malloc(geom->num_indices * sizeof(*indices));
+		if (!indices)
+			return -1;
+
+		for (i = 0, j = 0; i < num_vertices; i += 4) {
+			indices[j++] = i + 0;
+			indices[j++] = i + 1;
+			indices[j++] = i + 2;
+			indices[j++] = i + 2;
+			indices[j++] = i + 1;
+			indices[j++] = i + 3;
+		}
+
+		glGenBuffers(1, &geom->ibo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geom->ibo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+					 geom->num_indices * sizeof(*indices), indices,
+					 GL_STATIC_DRAW);
+		free(indices);
+	}
+
+	if (verbose) {
+		static const char *names[] = { "split", "interleaved", "packed" };
+		printf("geometry: %s, %u vertices, %u bytes\n", names[geom->layout],
+			   num_vertices, size);
+	}
+
+	return 0;
+}
+
+void draw_geometry(const struct geometry *geom)
+{
+	unsigned i;
+
+	if (geom->layout != GEOMETRY_SPLIT) {
+		glDrawElements(GL_TRIANGLES, geom->num_indices, GL_UNSIGNED_SHORT, 0);
+		return;
+	}
+
+	for (i = 0; i < geom->num_vertices; i += 4)
+		glDrawArrays(GL_TRIANGLE_STRIP, i, 4);
+}
+
+/* ES3 only: */
+void draw_geometry_instanced(const struct geometry *geom, unsigned count)
+{
+	unsigned i;
+
+	if (geom->layout != GEOMETRY_SPLIT) {
+		glDrawElementsInstanced(GL_TRIANGLES, geom->num_indices,
+								GL_UNSIGNED_SHORT, 0, count);
+		return;
+	}
+
+	for (i = 0; i < geom->num_vertices; i += 4)
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, i, 4, count);
+}
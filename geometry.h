@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _GEOMETRY_H
+#define _GEOMETRY_H
+
+#include "common.h"
+
+/* Vertex buffer layouts for the cube, selectable with --geometry so the
+ * vertex fetch cost of each can be compared:
+ *
+ *   split       - one VBO region per attribute, six 4-vertex strips
+ *   interleaved - one float vertex struct, indexed, one draw
+ *   packed      - as interleaved, but half-float positions, 10:10:10:2
+ *                 (or byte) normals and normalized byte/short colors and
+ *                 texcoords
+ */
+enum geometry_layout {
+	GEOMETRY_SPLIT,
+	GEOMETRY_INTERLEAVED,
+	GEOMETRY_PACKED,
+};
+
+extern enum geometry_layout geometry_layout;
+
+enum attrib_kind {
+	ATTRIB_POSITION,     /* 3 floats, within [-1, 1] */
+	ATTRIB_NORMAL,       /* 3 floats, unit length */
+	ATTRIB_COLOR,        /* 3 floats, within [0, 1] */
+	ATTRIB_TEXCOORD,     /* 2 floats, within [0, 1] */
+};
+
+struct geometry_attrib {
+	GLuint location;
+	enum attrib_kind kind;
+	const GLfloat *data;
+};
+
+#define MAX_GEOMETRY_ATTRIBS 4
+
+struct geometry {
+	enum geometry_layout layout;
+	GLuint vbo, ibo;
+	unsigned num_vertices;
+	unsigned num_indices;
+	unsigned stride;
+};
+
+/* num_vertices is a multiple of 4, each group of 4 vertices being one
+ * face drawn as a triangle strip.  Leaves the buffers bound and the
+ * attribute arrays enabled.
+ */
+int init_geometry(struct geometry *geom, const struct egl *egl,
+				  const struct geometry_attrib *attribs, unsigned num_attribs,
+				  unsigned num_vertices);
+void draw_geometry(const struct geometry *geom);
+void draw_geometry_instanced(const struct geometry *geom, unsigned count);
+int parse_geometry_layout(const char *name);
+
+#endif /* _GEOMETRY_H */
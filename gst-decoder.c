@@ -30,6 +30,10 @@
 #include <unistd.h>
 
 #include "common.h"
+#include "probes.h"
+#include "threadpool.h"
+#include "trace.h"
+#include "yuv.h"
 
 #include <drm_fourcc.h>
 
@@ -43,14 +47,24 @@
 GST_DEBUG_CATEGORY_EXTERN(kmscube_debug);
 #define GST_CAT_DEFAULT kmscube_debug
 
-#define MAX_NUM_PLANES 3
-
 inline static const char *
 yesno(int yes)
 {
 	return yes ? "yes" : "no";
 }
 
+/* Converted frames are written round robin into a few persistent bos,
+ * so the next one isn't written while the GPU may still be sampling
+ * the last:
+ */
+#define NUM_CONVERT_BUFS 3
+
+struct convert_buf {
+	struct gbm_bo      *bo;
+	int                 fd;
+	EGLImage            image;
+};
+
 struct decoder {
 	GMainLoop          *loop;
 	GstElement         *pipeline;
@@ -66,6 +80,13 @@ struct decoder {
 
 	EGLImage            last_frame;
 	GstSample          *last_samp;
+
+	/* EGL couldn't import the decoder's format, convert on the CPU: */
+	bool                convert;
+	struct threadpool  *pool;
+	struct convert_buf  convert_bufs[NUM_CONVERT_BUFS];
+	unsigned            convert_width, convert_height;
+	unsigned            convert_next;
 };
 
 static GstPadProbeReturn
@@ -114,6 +135,7 @@ static void *
 gst_thread_func(void *args)
 {
 	struct decoder *dec = args;
+	trace_thread_name("gst main loop");
 	g_main_loop_run(dec->loop);
 	return NULL;
 }
@@ -252,6 +274,20 @@ appsink_query_cb(GstPad *pad G_GNUC_UNUSED, GstPadProbeInfo *info,
 	return GST_PAD_PROBE_HANDLED;
 }
 
+/* marks decoded buffers arriving at the appsink, on the streaming thread: */
+static GstPadProbeReturn
+appsink_buffer_cb(GstPad *pad G_GNUC_UNUSED, GstPadProbeInfo *info,
+	gpointer user_data G_GNUC_UNUSED)
+{
+	GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+
+	trace_thread_name("gst streaming");
+	trace_instant("decoded", GST_BUFFER_PTS_IS_VALID(buf) ?
+			(int64_t)(GST_BUFFER_PTS(buf) / GST_USECOND) : TRACE_NO_ARG);
+
+	return GST_PAD_PROBE_OK;
+}
+
 struct decoder *
 video_init(const struct egl *egl, const struct gbm *gbm, const char *filename)
 {
@@ -284,6 +320,9 @@ video_init(const struct egl *egl, const struct gbm *gbm, const char *filename)
 	pad = gst_element_get_static_pad(dec->sink, "sink");
 	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM,
 		appsink_query_cb, NULL, NULL);
+	if (trace_is_enabled())
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+			appsink_buffer_cb, NULL, NULL);
 	gst_object_unref(pad);
 
 	src = gst_bin_get_by_name(GST_BIN(dec->pipeline), "src");
@@ -324,7 +363,8 @@ video_init(const struct egl *egl, const struct gbm *gbm, const char *filename)
 static void
 set_last_frame(struct decoder *dec, EGLImage frame, GstSample *samp)
 {
-	if (dec->last_frame)
+	/* converted frames belong to the convert_bufs: */
+	if (dec->last_frame && !dec->convert)
 		dec->egl->eglDestroyImageKHR(dec->egl->display, dec->last_frame);
 	dec->last_frame = frame;
 	if (dec->last_samp)
@@ -358,10 +398,40 @@ buf_to_fd(const struct gbm *gbm, int size, void *ptr)
 	return fd;
 }
 
+static void
+get_plane_layout(struct decoder *dec, GstVideoMeta *meta,
+		uint32_t *offsets, uint32_t *strides)
+{
+	guint nplanes = GST_VIDEO_INFO_N_PLANES(&(dec->info));
+	guint i;
+
+	/* Usually, a videometa should be present, since by using the internal kmscube
+	 * video_appsink element instead of the regular appsink, it is guaranteed that
+	 * video meta support is declared in the video_appsink's allocation query.
+	 * However, this assumes that upstream elements actually look at the allocation
+	 * query's contents properly, or that they even send a query at all. If this
+	 * is not the case, then upstream might decide to push frames without adding
+	 * a meta. It can happen, and in this case, look at the video info data as
+	 * a fallback (it is computed out of the input caps).
+	 */
+	if (meta) {
+		for (i = 0; i < nplanes; i++) {
+			offsets[i] = meta->offset[i];
+			strides[i] = meta->stride[i];
+		}
+	} else {
+		for (i = 0; i < nplanes; i++) {
+			offsets[i] = GST_VIDEO_INFO_PLANE_OFFSET(&(dec->info), i);
+			strides[i] = GST_VIDEO_INFO_PLANE_STRIDE(&(dec->info), i);
+		}
+	}
+}
+
 static EGLImage
 buffer_to_image(struct decoder *dec, GstBuffer *buf)
 {
-	struct { int fd, offset, stride; } planes[MAX_NUM_PLANES];
+	int fds[MAX_DMABUF_PLANES];
+	uint32_t offsets[MAX_DMABUF_PLANES], strides[MAX_DMABUF_PLANES];
 	GstVideoMeta *meta = gst_buffer_get_video_meta(buf);
 	EGLImage image;
 	guint nmems = gst_buffer_n_memory(buf);
@@ -372,22 +442,6 @@ buffer_to_image(struct decoder *dec, GstBuffer *buf)
 	GstMemory *mem;
 	int dmabuf_fd = -1;
 
-	static const EGLint egl_dmabuf_plane_fd_attr[MAX_NUM_PLANES] = {
-		EGL_DMA_BUF_PLANE0_FD_EXT,
-		EGL_DMA_BUF_PLANE1_FD_EXT,
-		EGL_DMA_BUF_PLANE2_FD_EXT,
-	};
-	static const EGLint egl_dmabuf_plane_offset_attr[MAX_NUM_PLANES] = {
-		EGL_DMA_BUF_PLANE0_OFFSET_EXT,
-		EGL_DMA_BUF_PLANE1_OFFSET_EXT,
-		EGL_DMA_BUF_PLANE2_OFFSET_EXT,
-	};
-	static const EGLint egl_dmabuf_plane_pitch_attr[MAX_NUM_PLANES] = {
-		EGL_DMA_BUF_PLANE0_PITCH_EXT,
-		EGL_DMA_BUF_PLANE1_PITCH_EXT,
-		EGL_DMA_BUF_PLANE2_PITCH_EXT,
-	};
-
 	/* Query gst_is_dmabuf_memory() here, since the gstmemory
 	 * block might get merged below by gst_buffer_map(), meaning
 	 * that the mem pointer would become invalid */
@@ -422,28 +476,9 @@ buffer_to_image(struct decoder *dec, GstBuffer *buf)
 		return EGL_NO_IMAGE_KHR;
 	}
 
-	/* Usually, a videometa should be present, since by using the internal kmscube
-	 * video_appsink element instead of the regular appsink, it is guaranteed that
-	 * video meta support is declared in the video_appsink's allocation query.
-	 * However, this assumes that upstream elements actually look at the allocation
-	 * query's contents properly, or that they even send a query at all. If this
-	 * is not the case, then upstream might decide to push frames without adding
-	 * a meta. It can happen, and in this case, look at the video info data as
-	 * a fallback (it is computed out of the input caps).
-	 */
-	if (meta) {
-		for (i = 0; i < nplanes; i++) {
-			planes[i].fd = dmabuf_fd;
-			planes[i].offset = meta->offset[i];
-			planes[i].stride = meta->stride[i];
-		}
-	} else {
-		for (i = 0; i < nplanes; i++) {
-			planes[i].fd = dmabuf_fd;
-			planes[i].offset = GST_VIDEO_INFO_PLANE_OFFSET(&(dec->info), i);
-			planes[i].stride = GST_VIDEO_INFO_PLANE_STRIDE(&(dec->info), i);
-		}
-	}
+	get_plane_layout(dec, meta, offsets, strides);
+	for (i = 0; i < nplanes; i++)
+		fds[i] = dmabuf_fd;
 
 	width = GST_VIDEO_INFO_WIDTH(&(dec->info));
 	height = GST_VIDEO_INFO_HEIGHT(&(dec->info));
@@ -465,35 +500,153 @@ buffer_to_image(struct decoder *dec, GstBuffer *buf)
 		printf("===================================\n");
 	}
 
-	{
-		/* Initialize the first 6 attributes with values that are
-		 * plane invariant (width, height, format) */
-		EGLint attr[6 + 6*(MAX_NUM_PLANES) + 1] = {
-			EGL_WIDTH, width,
-			EGL_HEIGHT, height,
-			EGL_LINUX_DRM_FOURCC_EXT, dec->format
-		};
+	PROBE4(import_begin, dmabuf_fd, dec->format, width, height);
+	image = create_dmabuf_image(dec->egl, width, height, dec->format,
+			nplanes, fds, offsets, strides);
+	PROBE2(import_end, dmabuf_fd, image);
 
-		for (i = 0; i < nplanes; i++) {
-			attr[6 + 6*i + 0] = egl_dmabuf_plane_fd_attr[i];
-			attr[6 + 6*i + 1] = planes[i].fd;
-			attr[6 + 6*i + 2] = egl_dmabuf_plane_offset_attr[i];
-			attr[6 + 6*i + 3] = planes[i].offset;
-			attr[6 + 6*i + 4] = egl_dmabuf_plane_pitch_attr[i];
-			attr[6 + 6*i + 5] = planes[i].stride;
-		}
+	/* Cleanup */
+	for (unsigned i = 0; i < nmems; i++)
+		close(fds[i]);
 
-		attr[6 + 6*nplanes] = EGL_NONE;
+	return image;
+}
 
-		image = dec->egl->eglCreateImageKHR(dec->egl->display, EGL_NO_CONTEXT,
-				EGL_LINUX_DMA_BUF_EXT, NULL, attr);
+static void
+destroy_convert_bufs(struct decoder *dec)
+{
+	unsigned i;
+
+	for (i = 0; i < NUM_CONVERT_BUFS; i++) {
+		struct convert_buf *b = &dec->convert_bufs[i];
+
+		if (!b->bo)
+			continue;
+		if (b->image)
+			dec->egl->eglDestroyImageKHR(dec->egl->display, b->image);
+		if (b->fd >= 0)
+			close(b->fd);
+		gbm_bo_destroy(b->bo);
 	}
 
-	/* Cleanup */
-	for (unsigned i = 0; i < nmems; i++)
-		close(planes[i].fd);
+	memset(dec->convert_bufs, 0, sizeof(dec->convert_bufs));
+	dec->convert_width = dec->convert_height = 0;
+}
 
-	return image;
+static int
+init_convert_bufs(struct decoder *dec, unsigned width, unsigned height)
+{
+	unsigned i;
+
+	destroy_convert_bufs(dec);
+
+	for (i = 0; i < NUM_CONVERT_BUFS; i++) {
+		struct convert_buf *b = &dec->convert_bufs[i];
+		uint32_t stride, offset = 0;
+
+		b->bo = gbm_bo_create(dec->gbm->dev, width, height,
+				GBM_FORMAT_XRGB8888, GBM_BO_USE_LINEAR);
+		if (!b->bo)
+			goto fail;
+
+		b->fd = gbm_bo_get_fd(b->bo);
+		if (b->fd < 0)
+			goto fail;
+
+		stride = gbm_bo_get_stride(b->bo);
+		b->image = create_dmabuf_image(dec->egl, width, height,
+				DRM_FORMAT_XRGB8888, 1, &b->fd, &offset, &stride);
+		if (!b->image)
+			goto fail;
+	}
+
+	dec->convert_width = width;
+	dec->convert_height = height;
+
+	return 0;
+
+fail:
+	GST_ERROR("could not allocate %ux%u conversion buffers", width, height);
+	destroy_convert_bufs(dec);
+	return -1;
+}
+
+/* Fallback for formats (or layouts) EGL can't import: convert to
+ * XRGB8888 on the CPU, into one of the linear convert_bufs, which are
+ * imported once per stream size.
+ */
+static EGLImage
+convert_to_image(struct decoder *dec, GstBuffer *buf)
+{
+	const GstVideoColorimetry *cinfo = &GST_VIDEO_INFO_COLORIMETRY(&(dec->info));
+	guint nplanes = GST_VIDEO_INFO_N_PLANES(&(dec->info));
+	uint32_t offsets[MAX_DMABUF_PLANES], strides[MAX_DMABUF_PLANES];
+	struct yuv_image src = {
+		.width = GST_VIDEO_INFO_WIDTH(&(dec->info)),
+		.height = GST_VIDEO_INFO_HEIGHT(&(dec->info)),
+	};
+	enum yuv_matrix matrix;
+	GstMapInfo map_info;
+	struct convert_buf *b;
+	void *map, *map_data = NULL;
+	uint32_t stride;
+	guint i;
+
+	switch (dec->format) {
+	case DRM_FORMAT_NV12:
+		src.format = YUV_NV12;
+		break;
+	case DRM_FORMAT_YUV420:
+		src.format = YUV_I420;
+		break;
+	case DRM_FORMAT_YUYV:
+		src.format = YUV_YUYV;
+		break;
+	default:
+		return EGL_NO_IMAGE_KHR;
+	}
+
+	switch (cinfo->matrix) {
+	case GST_VIDEO_COLOR_MATRIX_BT709:
+		matrix = YUV_BT709;
+		break;
+	case GST_VIDEO_COLOR_MATRIX_BT2020:
+		matrix = YUV_BT2020;
+		break;
+	default:
+		matrix = YUV_BT601;
+		break;
+	}
+
+	if (!gst_buffer_map(buf, &map_info, GST_MAP_READ)) {
+		GST_ERROR("could not map buffer for conversion");
+		return EGL_NO_IMAGE_KHR;
+	}
+
+	get_plane_layout(dec, gst_buffer_get_video_meta(buf), offsets, strides);
+	for (i = 0; i < nplanes; i++) {
+		src.planes[i] = map_info.data + offsets[i];
+		src.strides[i] = strides[i];
+	}
+
+	if ((src.width != dec->convert_width || src.height != dec->convert_height) &&
+	    init_convert_bufs(dec, src.width, src.height)) {
+		gst_buffer_unmap(buf, &map_info);
+		return EGL_NO_IMAGE_KHR;
+	}
+
+	b = &dec->convert_bufs[dec->convert_next++ % NUM_CONVERT_BUFS];
+	map = gbm_bo_map(b->bo, 0, 0, src.width, src.height,
+			GBM_BO_TRANSFER_WRITE, &stride, &map_data);
+	if (map) {
+		yuv_to_xrgb(&src, matrix,
+				cinfo->range == GST_VIDEO_COLOR_RANGE_0_255 ? YUV_FULL : YUV_LIMITED,
+				map, stride, dec->pool);
+		gbm_bo_unmap(b->bo, map_data);
+	}
+	gst_buffer_unmap(buf, &map_info);
+
+	return map ? b->image : EGL_NO_IMAGE_KHR;
 }
 
 EGLImage
@@ -503,7 +656,9 @@ video_frame(struct decoder *dec)
 	GstBuffer *buf;
 	EGLImage   frame = NULL;
 
+	trace_begin("pull sample");
 	samp = gst_app_sink_pull_sample(GST_APP_SINK(dec->sink));
+	trace_end("pull sample");
 	if (!samp) {
 		GST_DEBUG("got no appsink sample");
 		return NULL;
@@ -512,13 +667,32 @@ video_frame(struct decoder *dec)
 	buf = gst_sample_get_buffer(samp);
 
 	// TODO inline buffer_to_image??
-	frame = buffer_to_image(dec, buf);
+	if (!dec->convert) {
+		trace_begin("eglimage import");
+		frame = buffer_to_image(dec, buf);
+		trace_end("eglimage import");
+
+		if (!frame && dec->frame == 0) {
+			printf("EGL can't import the decoded frames, converting to XRGB8888 (%s)\n",
+					yuv_simd_name());
+			dec->pool = threadpool_create(0);
+			dec->convert = true;
+		}
+	}
+
+	if (dec->convert) {
+		trace_begin("yuv convert");
+		frame = convert_to_image(dec, buf);
+		trace_end("yuv convert");
+	}
 
 	// TODO in the zero-copy dmabuf case it would be nice to associate
 	// the eglimg w/ the buffer to avoid recreating it every frame..
 
 	set_last_frame(dec, frame, samp);
 
+	PROBE3(video_frame, dec->frame, frame, GST_BUFFER_PTS(buf));
+
 	dec->frame++;
 
 	return frame;
@@ -527,6 +701,9 @@ video_frame(struct decoder *dec)
 void video_deinit(struct decoder *dec)
 {
 	set_last_frame(dec, NULL, NULL);
+	destroy_convert_bufs(dec);
+	if (dec->pool)
+		threadpool_destroy(dec->pool);
 	gst_element_set_state(dec->pipeline, GST_STATE_NULL);
 	gst_object_unref(dec->sink);
 	gst_object_unref(dec->pipeline);
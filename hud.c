@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <GLES3/gl3.h>
+
+#include "common.h"
+#include "drm-common.h"
+#include "hud.h"
+
+/* 5x7 glyphs, one byte per row with the leftmost pixel in bit 4, only
+ * for the characters the HUD prints.  Anything else is drawn as a space.
+ */
+#define GLYPH_W 5
+#define GLYPH_H 7
+
+static const char glyph_chars[] = "0123456789.:/acdefgimnpsu";
+
+static const uint8_t glyphs[][GLYPH_H] = {
+	{ 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e }, /* 0 */
+	{ 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e }, /* 1 */
+	{ 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f }, /* 2 */
+	{ 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e }, /* 3 */
+	{ 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 }, /* 4 */
+	{ 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e }, /* 5 */
+	{ 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e }, /* 6 */
+	{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, /* 7 */
+	{ 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e }, /* 8 */
+	{ 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c }, /* 9 */
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c }, /* . */
+	{ 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 }, /* : */
+	{ 0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x10 }, /* / */
+	{ 0x00, 0x00, 0x0e, 0x01, 0x0f, 0x11, 0x0f }, /* a */
+	{ 0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e }, /* c */
+	{ 0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f }, /* d */
+	{ 0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e }, /* e */
+	{ 0x06, 0x09, 0x08, 0x1c, 0x08, 0x08, 0x08 }, /* f */
+	{ 0x00, 0x0f, 0x11, 0x11, 0x0f, 0x01, 0x0e }, /* g */
+	{ 0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e }, /* i */
+	{ 0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11 }, /* m */
+	{ 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 }, /* n */
+	{ 0x00, 0x00, 0x1e, 0x11, 0x1e, 0x10, 0x10 }, /* p */
+	{ 0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e }, /* s */
+	{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d }, /* u */
+};
+
+#define NUM_GLYPHS ARRAY_SIZE(glyphs)
+
+/* The atlas is a single row of cells, padded so neighbouring glyphs
+ * don't bleed into each other.  The cell after the last glyph is solid,
+ * for drawing rectangles from the same texture.
+ */
+#define CELL_W 6
+#define CELL_H 8
+#define SOLID_CELL NUM_GLYPHS
+#define ATLAS_W ((NUM_GLYPHS + 1) * CELL_W)
+
+/* Attribute locations and texture unit none of the scenes use, so the
+ * HUD's vertex arrays and atlas can be bound once at init and left in
+ * place.  ES2 has no VAOs to keep the two sets of arrays apart.
+ */
+#define HUD_ATTRIB_POSITION 4
+#define HUD_ATTRIB_TEXCOORD 5
+#define HUD_ATTRIB_COLOR    6
+#define HUD_TEXTURE_UNIT    7
+
+#define HUD_GRAPH_SAMPLES 120
+#define HUD_MAX_QUADS 256
+#define HUD_NUM_LINES 4
+/* the text is averaged over, and updated at, this interval: */
+#define HUD_UPDATE_INTERVAL (NSEC_PER_SEC / 2)
+
+struct hud_vertex {
+	GLfloat x, y;        /* in pixels, from the top left */
+	GLfloat u, v;
+	GLubyte color[4];
+};
+
+bool hud_enabled;
+bool hud_layered;
+
+static struct {
+	GLuint program, texture, vbo, vao;
+	int scale;           /* pixels per glyph pixel */
+	GLfloat x, y;        /* top left corner of the panel */
+	int64_t period_ns;   /* vblank period */
+
+	/* frame intervals for the graph, oldest at 'next': */
+	int64_t intervals[HUD_GRAPH_SAMPLES];
+	unsigned next;
+
+	/* accumulated since the text was last updated: */
+	unsigned frames;
+	int64_t elapsed_ns, cpu_ns;
+	uint64_t gpu_ns;
+	unsigned gpu_samples;
+
+	unsigned missed;
+
+	char text[HUD_NUM_LINES][24];
+
+	struct hud_vertex vertices[HUD_MAX_QUADS * 6];
+	unsigned num_vertices;
+
+	/* what the layer shows, with hud_layer(): */
+	struct hud_vertex drawn[HUD_MAX_QUADS * 6];
+	unsigned num_drawn;
+} hud;
+
+static const char *vertex_shader_source =
+		"uniform vec2 uScale;               \n"
+		"                                   \n"
+		"attribute vec2 in_position;        \n"
+		"attribute vec2 in_texcoord;        \n"
+		"attribute vec4 in_color;           \n"
+		"                                   \n"
+		"varying vec2 vTexCoord;            \n"
+		"varying vec4 vColor;               \n"
+		"                                   \n"
+		"void main()                        \n"
+		"{                                  \n"
+		"    gl_Position = vec4(in_position * uScale + vec2(-1.0, 1.0), 0.0, 1.0);\n"
+		"    vTexCoord = in_texcoord;       \n"
+		"    vColor = in_color;             \n"
+		"}                                  \n";
+
+static const char *fragment_shader_source =
+		"precision mediump float;           \n"
+		"                                   \n"
+		"uniform sampler2D uAtlas;          \n"
+		"                                   \n"
+		"varying vec2 vTexCoord;            \n"
+		"varying vec4 vColor;               \n"
+		"                                   \n"
+		"void main()                        \n"
+		"{                                  \n"
+		"    gl_FragColor = vec4(vColor.rgb, vColor.a * texture2D(uAtlas, vTexCoord).a);\n"
+		"}                                  \n";
+
+static void init_atlas(void)
+{
+	static GLubyte atlas[CELL_H][ATLAS_W];
+	GLint active;
+	unsigned i, row, col;
+
+	for (i = 0; i < NUM_GLYPHS; i++)
+		for (row = 0; row < GLYPH_H; row++)
+			for (col = 0; col < GLYPH_W; col++)
+				if (glyphs[i][row] & (1 << (GLYPH_W - 1 - col)))
+					atlas[row][i * CELL_W + col] = 0xff;
+
+	for (row = 0; row < CELL_H; row++)
+		memset(&atlas[row][SOLID_CELL * CELL_W], 0xff, CELL_W);
+
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+	glActiveTexture(GL_TEXTURE0 + HUD_TEXTURE_UNIT);
+
+	glGenTextures(1, &hud.texture);
+	glBindTexture(GL_TEXTURE_2D, hud.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, ATLAS_W, CELL_H, 0,
+				 GL_ALPHA, GL_UNSIGNED_BYTE, atlas);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glActiveTexture(active);
+}
+
+static void init_vertex_arrays(void)
+{
+	const struct hud_vertex *v = NULL;
+
+	glGenBuffers(1, &hud.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, hud.vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(hud.vertices), NULL, GL_STREAM_DRAW);
+
+	glVertexAttribPointer(HUD_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE,
+						  sizeof(*v), &v->x);
+	glEnableVertexAttribArray(HUD_ATTRIB_POSITION);
+	glVertexAttribPointer(HUD_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
+						  sizeof(*v), &v->u);
+	glEnableVertexAttribArray(HUD_ATTRIB_TEXCOORD);
+	glVertexAttribPointer(HUD_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+						  sizeof(*v), &v->color);
+	glEnableVertexAttribArray(HUD_ATTRIB_COLOR);
+}
+
+static const struct program_attrib program_attribs[] = {
+	{ HUD_ATTRIB_POSITION, "in_position" },
+	{ HUD_ATTRIB_TEXCOORD, "in_texcoord" },
+	{ HUD_ATTRIB_COLOR, "in_color" },
+};
+
+int init_hud(const struct egl *egl, int width, int height, unsigned refresh)
+{
+	GLint program, buffer, vao = 0;
+	int ret;
+
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &buffer);
+	if (egl->es3)
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+
+	ret = create_program(vertex_shader_source, fragment_shader_source,
+			program_attribs, ARRAY_SIZE(program_attribs));
+	if (ret < 0)
+		return -1;
+
+	hud.program = ret;
+
+	ret = link_program(hud.program);
+	if (ret)
+		return -1;
+
+	glUseProgram(hud.program);
+	glUniform2f(glGetUniformLocation(hud.program, "uScale"),
+				2.0f / width, -2.0f / height);
+	glUniform1i(glGetUniformLocation(hud.program, "uAtlas"), HUD_TEXTURE_UNIT);
+
+	init_atlas();
+
+	if (egl->es3) {
+		glGenVertexArrays(1, &hud.vao);
+		glBindVertexArray(hud.vao);
+	}
+	init_vertex_arrays();
+
+	if (egl->es3)
+		glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glUseProgram(program);
+
+	/* readable from across the room on a 1080p panel: */
+	hud.scale = height / 360 > 1 ? height / 360 : 1;
+	hud.x = hud.y = 8 * hud.scale;
+	hud.period_ns = NSEC_PER_SEC / (refresh ? refresh : 60);
+
+	snprintf(hud.text[0], sizeof(hud.text[0]), "fps");
+	snprintf(hud.text[1], sizeof(hud.text[1]), "cpu");
+	snprintf(hud.text[2], sizeof(hud.text[2]), "gpu");
+	snprintf(hud.text[3], sizeof(hud.text[3]), "missed 0");
+
+	hud_enabled = true;
+
+	return 0;
+}
+
+void hud_sample(int64_t interval_ns, int64_t cpu_ns, uint64_t gpu_ns)
+{
+	int64_t vblanks;
+
+	hud.intervals[hud.next] = interval_ns;
+	hud.next = (hud.next + 1) % HUD_GRAPH_SAMPLES;
+
+	/* a frame on screen for N vblank periods missed N - 1 of them: */
+	vblanks = (interval_ns + hud.period_ns / 2) / hud.period_ns;
+	if (vblanks > 1)
+		hud.missed += vblanks - 1;
+
+	hud.frames++;
+	hud.elapsed_ns += interval_ns;
+	hud.cpu_ns += cpu_ns;
+	if (gpu_ns) {
+		hud.gpu_ns += gpu_ns;
+		hud.gpu_samples++;
+	}
+
+	if (hud.elapsed_ns < HUD_UPDATE_INTERVAL)
+		return;
+
+	snprintf(hud.text[0], sizeof(hud.text[0]), "fps %6.1f",
+			 (double)hud.frames * NSEC_PER_SEC / hud.elapsed_ns);
+	snprintf(hud.text[1], sizeof(hud.text[1]), "cpu %6.2f ms",
+			 (double)hud.cpu_ns / hud.frames / 1000000.0);
+	if (hud.gpu_samples)
+		snprintf(hud.text[2], sizeof(hud.text[2]), "gpu %6.2f ms",
+				 (double)hud.gpu_ns / hud.gpu_samples / 1000000.0);
+	else
+		snprintf(hud.text[2], sizeof(hud.text[2]), "gpu    n/a");
+	snprintf(hud.text[3], sizeof(hud.text[3]), "missed %u", hud.missed);
+
+	hud.frames = 0;
+	hud.elapsed_ns = 0;
+	hud.cpu_ns = 0;
+	hud.gpu_ns = 0;
+	hud.gpu_samples = 0;
+}
+
+static void add_quad(GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1,
+					 GLfloat u0, GLfloat v0, GLfloat u1, GLfloat v1,
+					 const GLubyte color[4])
+{
+	struct hud_vertex *v = &hud.vertices[hud.num_vertices];
+	const struct hud_vertex corners[6] = {
+		{ x0, y0, u0, v0, { color[0], color[1], color[2], color[3] } },
+		{ x1, y0, u1, v0, { color[0], color[1], color[2], color[3] } },
+		{ x0, y1, u0, v1, { color[0], color[1], color[2], color[3] } },
+		{ x0, y1, u0, v1, { color[0], color[1], color[2], color[3] } },
+		{ x1, y0, u1, v0, { color[0], color[1], color[2], color[3] } },
+		{ x1, y1, u1, v1, { color[0], color[1], color[2], color[3] } },
+	};
+
+	if (hud.num_vertices + 6 > ARRAY_SIZE(hud.vertices))
+		return;
+
+	memcpy(v, corners, sizeof(corners));
+	hud.num_vertices += 6;
+}
+
+static void add_rect(GLfloat x, GLfloat y, GLfloat w, GLfloat h,
+					 const GLubyte color[4])
+{
+	/* sample the middle of the solid cell: */
+	const GLfloat u = (SOLID_CELL * CELL_W + CELL_W / 2.0f) / ATLAS_W;
+
+	add_quad(x, y, x + w, y + h, u, 0.5f, u, 0.5f, color);
+}
+
+static void add_text(GLfloat x, GLfloat y, const char *str,
+					 const GLubyte color[4])
+{
+	const int s = hud.scale;
+
+	for (; *str; str++, x += CELL_W * s) {
+		const char *c = strchr(glyph_chars, *str);
+		unsigned idx;
+
+		if (!c)
+			continue;
+
+		idx = c - glyph_chars;
+		add_quad(x, y, x + GLYPH_W * s, y + GLYPH_H * s,
+				 (GLfloat)(idx * CELL_W) / ATLAS_W, 0.0f,
+				 (GLfloat)(idx * CELL_W + GLYPH_W) / ATLAS_W,
+				 (GLfloat)GLYPH_H / CELL_H, color);
+	}
+}
+
+static void build_hud(void)
+{
+	static const GLubyte background[4] = {   0,   0,   0, 160 };
+	static const GLubyte text[4]       = { 255, 255, 255, 255 };
+	static const GLubyte on_time[4]    = {  64, 224,  64, 255 };
+	static const GLubyte late[4]       = { 240,  64,  64, 255 };
+	static const GLubyte vblank[4]     = { 255, 255, 255, 128 };
+	const int s = hud.scale;
+	const GLfloat pad = 4 * s, line = (CELL_H + 2) * s;
+	const GLfloat graph_w = HUD_GRAPH_SAMPLES * s, graph_h = 32 * s;
+	const GLfloat x = hud.x, y = hud.y;
+	const GLfloat bottom = y + pad + HUD_NUM_LINES * line + graph_h;
+	unsigned i;
+
+	hud.num_vertices = 0;
+
+	add_rect(x, y, graph_w + 2 * pad,
+			 HUD_NUM_LINES * line + graph_h + 2 * pad, background);
+
+	for (i = 0; i < HUD_NUM_LINES; i++)
+		add_text(x + pad, y + pad + i * line, hud.text[i], text);
+
+	/* frame intervals, oldest on the left.  The full graph height is two
+	 * vblank periods, anything over one and a half missed a vblank:
+	 */
+	for (i = 0; i < HUD_GRAPH_SAMPLES; i++) {
+		int64_t interval = hud.intervals[(hud.next + i) % HUD_GRAPH_SAMPLES];
+		/* in whole glyph pixels, so a steady rate draws the same graph: */
+		GLfloat h = s * (int)(graph_h * interval / (2 * hud.period_ns) / s + 0.5f);
+
+		if (h <= 0)
+			continue;
+		if (h > graph_h)
+			h = graph_h;
+
+		add_rect(x + pad + i * s, bottom - h, s, h,
+				 2 * interval > 3 * hud.period_ns ? late : on_time);
+	}
+
+	add_rect(x + pad, bottom - graph_h / 2, graph_w, s > 1 ? s / 2 : 1, vblank);
+}
+
+void draw_hud(const struct egl *egl)
+{
+	GLint program, buffer, vao = 0;
+	GLboolean blend, cull, depth;
+
+	build_hud();
+
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &buffer);
+	blend = glIsEnabled(GL_BLEND);
+	cull = glIsEnabled(GL_CULL_FACE);
+	depth = glIsEnabled(GL_DEPTH_TEST);
+
+	glUseProgram(hud.program);
+	if (egl->es3) {
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+		glBindVertexArray(hud.vao);
+	}
+
+	/* orphan the previous frame's vertices, the GPU may still be
+	 * reading them:
+	 */
+	glBindBuffer(GL_ARRAY_BUFFER, hud.vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(hud.vertices), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0,
+					hud.num_vertices * sizeof(hud.vertices[0]), hud.vertices);
+
+	/* alpha accumulates too, so drawn onto a transparent layer the
+	 * result is premultiplied, as KMS blends it by default:
+	 */
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+						GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_DEPTH_TEST);
+
+	glDrawArrays(GL_TRIANGLES, 0, hud.num_vertices);
+
+	if (!blend)
+		glDisable(GL_BLEND);
+	if (cull)
+		glEnable(GL_CULL_FACE);
+	if (depth)
+		glEnable(GL_DEPTH_TEST);
+
+	if (egl->es3)
+		glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glUseProgram(program);
+}
+
+static bool hud_layer_changed(void)
+{
+	build_hud();
+
+	return hud.num_vertices != hud.num_drawn ||
+		memcmp(hud.vertices, hud.drawn,
+			   hud.num_vertices * sizeof(hud.vertices[0])) != 0;
+}
+
+static void hud_layer_draw(const struct egl *egl)
+{
+	glClearColor(0.0, 0.0, 0.0, 0.0);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	draw_hud(egl);
+
+	memcpy(hud.drawn, hud.vertices, hud.num_vertices * sizeof(hud.vertices[0]));
+	hud.num_drawn = hud.num_vertices;
+}
+
+struct layer *hud_layer(void)
+{
+	static struct layer layer = {
+		.name = "hud",
+		.zpos = 1,
+		/* only the panel background is translucent, per pixel: */
+		.alpha = 0xffff,
+		.format = GBM_FORMAT_ARGB8888,
+		.changed = hud_layer_changed,
+		.draw = hud_layer_draw,
+	};
+	const int s = hud.scale;
+	const int w = (HUD_GRAPH_SAMPLES + 8) * s;
+	const int h = (HUD_NUM_LINES * (CELL_H + 2) + 32 + 8) * s;
+	GLint program;
+
+	layer.width = layer.src_w = layer.crtc_w = w;
+	layer.height = layer.src_h = layer.crtc_h = h;
+	layer.crtc_x = hud.x;
+	layer.crtc_y = hud.y;
+
+	/* from here on the panel is drawn at the origin of its own buffer: */
+	hud.x = hud.y = 0;
+
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	glUseProgram(hud.program);
+	glUniform2f(glGetUniformLocation(hud.program, "uScale"),
+				2.0f / w, -2.0f / h);
+	glUseProgram(program);
+
+	hud_layered = true;
+
+	return &layer;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _HUD_H
+#define _HUD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+struct layer;
+
+/* On-screen performance overlay: fps, CPU and GPU frame time, missed
+ * vblanks and a rolling graph of frame intervals, composited over the
+ * scene in one draw call from a small built-in glyph atlas.
+ */
+
+/* set once init_hud() succeeds: */
+extern bool hud_enabled;
+/* set once hud_layer() moved the HUD out of the scene: */
+extern bool hud_layered;
+
+/* refresh is the mode's vertical refresh in Hz, used to count missed
+ * vblanks (0 if unknown, 60 is assumed):
+ */
+int init_hud(const struct egl *egl, int width, int height, unsigned refresh);
+
+/* Called once per presented frame with the time since the previous one,
+ * the CPU time spent in the frame and the last GPU time sample (0 if
+ * none):
+ */
+void hud_sample(int64_t interval_ns, int64_t cpu_ns, uint64_t gpu_ns);
+
+/* Draw over whatever has been rendered this frame, GL state the scene
+ * relies on is left as it was:
+ */
+void draw_hud(const struct egl *egl);
+
+/* Move the panel out of the scene onto a layer for drm->add_layer().
+ * The layer is premultiplied ARGB8888 at full plane alpha, so only the
+ * panel background is translucent, as in the scene; where ARGB can't be
+ * drawn or scanned out it falls back to an opaque XRGB8888 panel.  It
+ * is redrawn only when the text or the graph changed:
+ */
+struct layer *hud_layer(void);
+
+#endif /* _HUD_H */
@@ -32,8 +32,17 @@
 #include <stdlib.h>
 #include <getopt.h>
 
+#include "camera.h"
+#include "capture.h"
 #include "common.h"
+#include "frames.h"
+#include "geometry.h"
+#include "hud.h"
+#include "objects.h"
+#include "pattern.h"
 #include "surface-manager.h"
+#include "trace.h"
+#include "writeback.h"
 #include "drm-common.h"
 
 #ifdef HAVE_GST
@@ -45,33 +54,121 @@ static const struct egl *egl;
 static const struct surfmgr *surfmgr;
 static const struct drm *drm;
 
-static const char *shortopts = "AD:S:M:m:V:";
+static const char *shortopts = "3AC:D:f:F:G:Hi:lr:R:S:sM:m:o:Op:P:c:t:T:u:vV:w:";
 
 static const struct option longopts[] = {
+	{"gles3",  no_argument,       0, '3'},
 	{"atomic", no_argument,       0, 'A'},
+	{"clock",  required_argument, 0, 'C'},
 	{"device", required_argument, 0, 'D'},
+	{"frames", required_argument, 0, 'f'},
+	{"frame-format", required_argument, 0, 'F'},
+	{"geometry", required_argument, 0, 'G'},
+	{"hud",    no_argument,       0, 'H'},
+	{"camera", required_argument, 0, 'i'},
+	{"layers", no_argument,       0, 'l'},
+	{"render-scale", required_argument, 0, 'r'},
+	{"readahead", required_argument, 0, 'R'},
 	{"surfmgrdev", required_argument, 0, 'S'},
+	{"software", no_argument,     0, 's'},
 	{"mode",   required_argument, 0, 'M'},
 	{"modifier", required_argument, 0, 'm'},
+	{"objects", required_argument, 0, 'o'},
+	{"outputs", no_argument,      0, 'O'},
+	{"capture", required_argument, 0, 'p'},
+	{"capture-dir", required_argument, 0, 'P'},
+	{"count",  required_argument, 0, 'c'},
+	{"trace",  required_argument, 0, 't'},
+	{"pattern", required_argument, 0, 'T'},
+	{"upload", required_argument, 0, 'u'},
+	{"verbose", no_argument,      0, 'v'},
 	{"video",  required_argument, 0, 'V'},
+	{"writeback", required_argument, 0, 'w'},
 	{0, 0, 0, 0}
 };
 
 static void usage(const char *name)
 {
-	printf("Usage: %s [-ADMmV]\n"
+	printf("Usage: %s [-3ACDfFGHilrRSsMmoOpPctTuvVw]\n"
 			"\n"
 			"options:\n"
+			"    -3, --gles3              use an OpenGL ES 3.x context, with VAOs,\n"
+			"                             a uniform buffer and instanced draws for\n"
+			"                             the smooth cube (falls back to ES 2.0)\n"
 			"    -A, --atomic             use atomic modesetting and fencing\n"
+			"    -C, --clock=CLOCK        what drives the animation, one of:\n"
+			"        present   -  predicted presentation time (default)\n"
+			"        frame     -  frame number, speed follows the frame rate\n"
+			"        fixed     -  one refresh period per frame, reproducible\n"
 			"    -D, --device=DEVICE      use the given device\n"
+			"    -f, --frames=FILE        texture the cube with frames streamed from\n"
+			"                             FILE, a .y4m (4:2:0) or raw frames, instead\n"
+			"                             of the built-in 512x512 image (installed as\n"
+			"                             frame-512x512-{RGBA,NV12}.raw in\n"
+			"                             " PKGDATADIR ", or $KMSCUBE_DATADIR)\n"
+			"    -F, --frame-format=FMT   format of raw frames, FORMAT:WxH with\n"
+			"                             FORMAT one of rgba, nv12, i420, p010\n"
+			"                             (FORMAT[:WxH] with --pattern)\n"
+			"    -G, --geometry=LAYOUT    cube vertex layout, one of:\n"
+			"        split       -  attribute per buffer region, 6 strips (default)\n"
+			"        interleaved -  interleaved floats, one indexed draw\n"
+			"        packed      -  interleaved half-float/10:10:10:2, indexed\n"
+			"    -H, --hud                overlay fps, cpu/gpu frame times, missed\n"
+			"                             vblanks and a frame time graph\n"
+			"    -i, --camera=DEVICE      live V4L2 camera textured cube, reports\n"
+			"                             capture to scanout latency (eg. vivid)\n"
+			"    -l, --layers             put the HUD on an overlay plane, blended\n"
+			"                             by the display and only redrawn when it\n"
+			"                             changes (atomic only)\n"
+			"    -r, --render-scale=S     draw the scene at S (0.25 to 1) of the mode's\n"
+			"                             size and upscale it with the plane, or\n"
+			"                             auto to follow the GPU frame time\n"
+			"                             (atomic only)\n"
+			"    -R, --readahead=N        keep N streamed frames resident ahead\n"
+			"                             of drawing (default 8)\n"
 			"    -S, --surfmgrdev=DEVICE  use the given device for surface mgr\n"
+			"                             (renders there and copies to linear\n"
+			"                             buffers for the display device)\n"
+			"    -s, --software           render on the CPU into dumb buffers,\n"
+			"                             without EGL or GL (not with --video)\n"
 			"    -M, --mode=MODE          specify mode, one of:\n"
 			"        smooth    -  smooth shaded cube (default)\n"
 			"        rgba      -  rgba textured cube\n"
 			"        nv12-2img -  yuv textured (color conversion in shader)\n"
 			"        nv12-1img -  yuv textured (single nv12 texture)\n"
 			"    -m, --modifier=MODIFIER  hardcode the selected modifier\n"
-			"    -V, --video=FILE         video textured cube\n",
+			"    -o, --objects=N          draw N independently animated cubes\n"
+			"                             (stress mode)\n"
+			"    -O, --outputs            drive every connected connector, each\n"
+			"                             with its own crtc, plane and timing\n"
+			"                             (atomic only)\n"
+			"    -p, --capture=N          read back every Nth frame and print its\n"
+			"                             hash (use with --count and --clock=fixed\n"
+			"                             for reproducible golden images), implies\n"
+			"                             --gles3\n"
+			"    -P, --capture-dir=DIR    also write captured (and written back)\n"
+			"                             frames to DIR as PPM\n"
+			"    -c, --count=N            run for N frames, then exit\n"
+			"    -t, --trace=FILE         write a Chrome trace-event JSON timeline\n"
+			"                             of the frame pipeline to FILE at exit\n"
+			"    -T, --pattern=PATTERN    texture the cube with a test pattern\n"
+			"                             generated every frame, at the display\n"
+			"                             size unless -F gives one, one of:\n"
+			"        bars        -  SMPTE color bars\n"
+			"        zoneplate   -  moving circular zone plate\n"
+			"        gradient    -  RGB ramps with a moving diagonal\n"
+			"    -u, --upload=STRATEGY    update the texture every frame, from --frames,\n"
+			"                             --pattern or a scrolling built-in image,\n"
+			"                             using:\n"
+			"        map         -  gbm_bo_map() (default with --frames/--pattern)\n"
+			"        subimage    -  glTexSubImage2D()\n"
+			"        dmabuf-sync -  persistent dmabuf mmap, DMA_BUF_IOCTL_SYNC\n"
+			"        reimport    -  as dmabuf-sync, re-creating the EGLImage\n"
+			"    -v, --verbose            print EGL/GL extension strings\n"
+			"    -V, --video=FILE         video textured cube\n"
+			"    -w, --writeback=N        capture every Nth composed output frame\n"
+			"                             through a writeback connector and print\n"
+			"                             its hash (atomic only)\n",
 			name);
 }
 
@@ -80,28 +177,103 @@ int main(int argc, char *argv[])
 	const char *device = "/dev/dri/card0";
 	const char *surfmgrdev = NULL;
 	const char *video = NULL;
+	const char *camera = NULL;
+	const char *trace = NULL;
+	const char *capture_dir = NULL;
+	const char *frames_path = NULL;
+	const char *frame_format = NULL;
+	struct frames *frames = NULL;
+	unsigned readahead = 8;
+	unsigned capture = 0;
+	unsigned writeback = 0;
 	enum mode mode = SMOOTH;
 	uint64_t modifier = DRM_FORMAT_MOD_INVALID;
 	int surfmgrfd;
 	int atomic = 0;
-	int opt;
-
-#ifdef HAVE_GST
-	gst_init(&argc, &argv);
-	GST_DEBUG_CATEGORY_INIT(kmscube_debug, "kmscube", 0, "kmscube video pipeline");
-#endif
+	int all_outputs = 0;
+	int layers = 0;
+	int hud = 0;
+	int software = 0;
+	enum frame_format fmt;
+	unsigned width, height;
+	int layout, anim, upload, pattern;
+	int opt, ret;
 
 	while ((opt = getopt_long_only(argc, argv, shortopts, longopts, NULL)) != -1) {
 		switch (opt) {
+		case '3':
+			gles_version = 3;
+			break;
 		case 'A':
 			atomic = 1;
 			break;
+		case 'C':
+			anim = parse_anim_clock(optarg);
+			if (anim < 0) {
+				printf("invalid clock: %s\n", optarg);
+				usage(argv[0]);
+				return -1;
+			}
+			anim_clock = anim;
+			break;
 		case 'D':
 			device = optarg;
 			break;
+		case 'f':
+			frames_path = optarg;
+			break;
+		case 'F':
+			if (frames_parse_format(optarg, &fmt, &width, &height)) {
+				usage(argv[0]);
+				return -1;
+			}
+			frame_format = optarg;
+			break;
+		case 'G':
+			layout = parse_geometry_layout(optarg);
+			if (layout < 0) {
+				printf("invalid geometry layout: %s\n", optarg);
+				usage(argv[0]);
+				return -1;
+			}
+			geometry_layout = layout;
+			break;
+		case 'H':
+			hud = 1;
+			break;
+		case 'i':
+			mode = VIDEO;
+			camera = optarg;
+			break;
+		case 'l':
+			layers = 1;
+			break;
+		case 'r':
+			if (strcmp(optarg, "auto") == 0) {
+				render_scale = 0.0f;
+				break;
+			}
+			render_scale = strtof(optarg, NULL);
+			if (render_scale < RENDER_SCALE_MIN || render_scale > 1.0f) {
+				printf("invalid render scale: %s\n", optarg);
+				usage(argv[0]);
+				return -1;
+			}
+			break;
+		case 'R':
+			readahead = strtoul(optarg, NULL, 0);
+			if (readahead < 1) {
+				printf("invalid readahead: %s\n", optarg);
+				usage(argv[0]);
+				return -1;
+			}
+			break;
 		case 'S':
 			surfmgrdev = optarg;
 			break;
+		case 's':
+			software = 1;
+			break;
 		case 'M':
 			if (strcmp(optarg, "smooth") == 0) {
 				mode = SMOOTH;
@@ -120,25 +292,190 @@ int main(int argc, char *argv[])
 		case 'm':
 			modifier = strtoull(optarg, NULL, 0);
 			break;
+		case 'o':
+			num_objects = strtoul(optarg, NULL, 0);
+			if (num_objects < 1) {
+				printf("invalid number of objects: %s\n", optarg);
+				usage(argv[0]);
+				return -1;
+			}
+			break;
+		case 'O':
+			all_outputs = 1;
+			break;
+		case 'p':
+			capture = strtoul(optarg, NULL, 0);
+			if (capture < 1) {
+				printf("invalid capture interval: %s\n", optarg);
+				usage(argv[0]);
+				return -1;
+			}
+			break;
+		case 'P':
+			capture_dir = optarg;
+			break;
+		case 'c':
+			frame_count = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			trace = optarg;
+			break;
+		case 'T':
+			pattern = parse_pattern(optarg);
+			if (pattern < 0) {
+				printf("invalid pattern: %s\n", optarg);
+				usage(argv[0]);
+				return -1;
+			}
+			tex_pattern.pattern = pattern;
+			break;
+		case 'u':
+			upload = parse_tex_upload(optarg);
+			if (upload < 0) {
+				printf("invalid upload strategy: %s\n", optarg);
+				usage(argv[0]);
+				return -1;
+			}
+			tex_upload = upload;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
 		case 'V':
 			mode = VIDEO;
 			video = optarg;
 			break;
+		case 'w':
+			writeback = strtoul(optarg, NULL, 0);
+			if (writeback < 1) {
+				printf("invalid writeback interval: %s\n", optarg);
+				usage(argv[0]);
+				return -1;
+			}
+			break;
 		default:
 			usage(argv[0]);
 			return -1;
 		}
 	}
 
+	if (capture_dir && !capture && !writeback)
+		capture = 1;
+
+	if (software && (hud || capture || gles_version == 3 || surfmgrdev ||
+					 modifier != DRM_FORMAT_MOD_INVALID)) {
+		printf("software rendering cannot be combined with --hud, --capture,\n"
+			   "--gles3, --surfmgrdev or --modifier\n");
+		return -1;
+	}
+
+	/* readback goes through a PBO ring, which needs ES 3.x: */
+	if (capture)
+		gles_version = 3;
+
+	if ((frames_path || tex_upload || tex_pattern.pattern >= 0) &&
+			(software || mode == VIDEO)) {
+		printf("--frames, --pattern and --upload cannot be combined with --software or --video\n");
+		return -1;
+	}
+
+	if (frames_path && tex_pattern.pattern >= 0) {
+		printf("--frames and --pattern are exclusive\n");
+		return -1;
+	}
+
+	if (tex_pattern.pattern >= 0) {
+		enum frame_format format = (mode == RGBA || mode == SMOOTH) ?
+				FRAME_RGBA : FRAME_NV12;
+
+		if (frame_format && frames_parse_format(frame_format, &format,
+				&tex_pattern.width, &tex_pattern.height))
+			return -1;
+		tex_pattern.format = format;
+
+		if (mode == SMOOTH)
+			mode = (format == FRAME_RGBA) ? RGBA : NV12_2IMG;
+	} else if (frames_path) {
+
+		frames = frames_open(frames_path, frame_format, readahead);
+		if (!frames) {
+			printf("failed to open frames\n");
+			return -1;
+		}
+
+		/* pick a textured mode to match, unless one was given: */
+		if (mode == SMOOTH)
+			mode = (frames->format == FRAME_RGBA) ? RGBA : NV12_2IMG;
+	} else if (tex_upload && mode == SMOOTH) {
+		mode = RGBA;
+	}
+
+	if (writeback && !atomic) {
+		printf("writeback requires atomic modesetting (-A)\n");
+		return -1;
+	}
+
+	if (layers && (!atomic || !hud)) {
+		printf("--layers requires atomic modesetting (-A) and --hud\n");
+		return -1;
+	}
+
+	/* the HUD layer's ARGB surface needs a context it can share with
+	 * the scene's XRGB one:
+	 */
+	egl_no_config_context = layers;
+
+	if (render_scale != 1.0f && !atomic) {
+		printf("--render-scale requires atomic modesetting (-A)\n");
+		return -1;
+	}
+
+	if (render_scale != 1.0f &&
+			(software || capture || surfmgrdev || all_outputs)) {
+		printf("--render-scale cannot be combined with --software, --capture,\n"
+				"--surfmgrdev or --outputs\n");
+		return -1;
+	}
+
+	if (all_outputs && !atomic) {
+		printf("--outputs requires atomic modesetting (-A)\n");
+		return -1;
+	}
+
+	if (all_outputs && (software || hud || capture || writeback || surfmgrdev)) {
+		printf("--outputs cannot be combined with --software, --hud, --capture,\n"
+				"--writeback or --surfmgrdev\n");
+		return -1;
+	}
+
+	if (trace && trace_init(trace)) {
+		printf("failed to set up tracing\n");
+		return -1;
+	}
+
+	init_quit_handler();
+
+	startup_begin(STARTUP_DRM);
 	if (atomic)
-		drm = init_drm_atomic(device);
+		drm = init_drm_atomic(device, all_outputs);
 	else
 		drm = init_drm_legacy(device);
+	startup_end(STARTUP_DRM);
 	if (!drm) {
 		printf("failed to initialize %s DRM\n", atomic ? "atomic" : "legacy");
 		return -1;
 	}
 
+	if (writeback && init_writeback(drm, writeback, capture_dir)) {
+		printf("failed to initialize writeback\n");
+		return -1;
+	}
+
+	/* the exact refresh period, vrefresh is rounded to whole Hz: */
+	if (drm->mode->clock)
+		init_anim_clock((int64_t)drm->mode->htotal * drm->mode->vtotal *
+						1000000 / drm->mode->clock);
+
 	if (!surfmgrdev) {
 		surfmgrfd = drm->fd;
 	} else {
@@ -150,34 +487,80 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	surfmgr = init_surfmgr(surfmgrfd, drm->fd,
-						   drm->mode->hdisplay, drm->mode->vdisplay,
-						   modifier);
+	startup_begin(STARTUP_SURFMGR);
+	if (software)
+		surfmgr = init_surfmgr_dumb(drm->fd, drm->mode->hdisplay,
+									drm->mode->vdisplay);
+	else
+		surfmgr = init_surfmgr(surfmgrfd, drm->fd,
+							   drm->mode->hdisplay, drm->mode->vdisplay,
+							   modifier);
+	startup_end(STARTUP_SURFMGR);
 	if (!surfmgr) {
 		printf("failed to initialize any surface manager APIs\n");
 		return -1;
 	}
 
-	if (!atomic && !surfmgr->gbm) {
-		printf("Legacy DRM requires GBM\n");
+	if (!atomic && !surfmgr->gbm && !surfmgr->dumb) {
+		printf("Legacy DRM requires GBM or dumb buffers\n");
 		return -1;
 	}
 
-	if (mode == SMOOTH)
+#ifdef HAVE_GST
+	/* GStreamer is only needed (and only worth its startup cost) for
+	 * video.  It is initialized after option parsing, so --gst-* options
+	 * are not available; use the GST_* environment variables instead.
+	 */
+	if (video) {
+		gst_init(NULL, NULL);
+		GST_DEBUG_CATEGORY_INIT(kmscube_debug, "kmscube", 0, "kmscube video pipeline");
+	}
+#endif
+
+	if (software)
+		egl = init_cube_software(surfmgr, mode);
+	else if (mode == SMOOTH)
 		egl = init_cube_smooth(surfmgr);
 	else if (mode == VIDEO)
-		egl = init_cube_video(surfmgr, video);
+		egl = init_cube_video(surfmgr, video, camera);
 	else
-		egl = init_cube_tex(surfmgr, mode);
+		egl = init_cube_tex(surfmgr, mode, frames);
 
 	if (!egl) {
 		printf("failed to initialize EGL\n");
 		return -1;
 	}
 
+	if (hud && init_hud(egl, surfmgr->width, surfmgr->height,
+						drm->mode->vrefresh)) {
+		printf("failed to initialize HUD\n");
+		return -1;
+	}
+
+	if (layers && drm->add_layer(hud_layer())) {
+		printf("failed to put the HUD on a plane\n");
+		return -1;
+	}
+
+	if (capture && init_capture(egl, surfmgr->width, surfmgr->height,
+								capture, capture_dir)) {
+		printf("failed to initialize frame capture\n");
+		return -1;
+	}
+
 	/* clear the color buffer */
-	glClearColor(0.5, 0.5, 0.5, 1.0);
-	glClear(GL_COLOR_BUFFER_BIT);
+	if (!software) {
+		glClearColor(0.5, 0.5, 0.5, 1.0);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+
+	ret = drm->run(surfmgr, egl);
+
+	finish_capture();
+	finish_writeback();
+	finish_camera();
+	finish_objects();
+	frames_close(frames);
 
-	return drm->run(surfmgr, egl);
+	return ret;
 }
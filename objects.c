@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES3/gl3.h>
+
+#include "common.h"
+#include "objects.h"
+#include "threadpool.h"
+
+unsigned num_objects = 1;
+
+static struct objects objects;
+static struct threadpool *pool;
+
+static void update_range(void *arg, unsigned start, unsigned end)
+{
+	struct objects *objs = arg;
+	unsigned i;
+
+	for (i = start; i < end; i++) {
+		ESMatrix *modelview = &objs->modelview[i];
+		GLfloat *normal = objs->normal[i];
+		GLfloat t = objs->time * objs->rate[i];
+		GLfloat phase = objs->phase[i];
+		GLfloat s = objs->scale[i];
+
+		esMatrixLoadIdentity(modelview);
+		esTranslate(modelview, objs->x[i], objs->y[i], -8.0f);
+		esRotate(modelview, 45.0f + (0.25f * t) + phase, 1.0f, 0.0f, 0.0f);
+		esRotate(modelview, 45.0f - (0.5f * t) - phase, 0.0f, 1.0f, 0.0f);
+		esRotate(modelview, 10.0f + (0.15f * t), 0.0f, 0.0f, 1.0f);
+
+		/* the normal matrix is taken before the (uniform) scale so
+		 * the normals stay unit length:
+		 */
+		normal[0] = modelview->m[0][0];
+		normal[1] = modelview->m[0][1];
+		normal[2] = modelview->m[0][2];
+		normal[3] = modelview->m[1][0];
+		normal[4] = modelview->m[1][1];
+		normal[5] = modelview->m[1][2];
+		normal[6] = modelview->m[2][0];
+		normal[7] = modelview->m[2][1];
+		normal[8] = modelview->m[2][2];
+
+		esScale(modelview, s, s, s);
+		esMatrixMultiply(&objs->modelviewprojection[i], modelview,
+						 (ESMatrix *)objs->projection);
+
+		if (objs->ubo)
+			pack_object_block(objects_ubo_block(objs->ubo, i), modelview,
+							  &objs->modelviewprojection[i], normal);
+	}
+}
+
+void update_objects(struct objects *objs, GLfloat time)
+{
+	objs->time = time;
+	threadpool_run(pool, update_range, objs, objs->count);
+}
+
+struct object_block * objects_ubo_block(const struct objects_ubo *ubo,
+										unsigned i)
+{
+	return (struct object_block *)(ubo->data +
+			(i / ubo->batch) * ubo->batch_stride) + (i % ubo->batch);
+}
+
+void pack_object_block(struct object_block *block, const ESMatrix *modelview,
+					   const ESMatrix *modelviewprojection,
+					   const GLfloat normal[9])
+{
+	int i;
+
+	memcpy(block->modelview, modelview->m, sizeof(block->modelview));
+	memcpy(block->modelviewprojection, modelviewprojection->m,
+		   sizeof(block->modelviewprojection));
+	for (i = 0; i < 3; i++) {
+		memcpy(block->normal[i], &normal[i * 3], 3 * sizeof(GLfloat));
+		block->normal[i][3] = 0.0f;
+	}
+}
+
+/* The batch size is baked into the shaders (as the uniform block array
+ * size), so it's fixed at init from the block size limit:
+ */
+int init_objects_ubo(struct objects_ubo *ubo, GLuint binding, unsigned count)
+{
+	GLint max_size = 16384, align = 256;
+	unsigned batches;
+
+	glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &max_size);
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+
+	ubo->binding = binding;
+	ubo->batch = max_size / sizeof(struct object_block);
+	if (ubo->batch > 256)
+		ubo->batch = 256;
+	if (ubo->batch > count)
+		ubo->batch = count;
+	ubo->batch_stride = ubo->batch * sizeof(struct object_block);
+	ubo->batch_stride = (ubo->batch_stride + align - 1) / align * align;
+
+	batches = (count + ubo->batch - 1) / ubo->batch;
+	ubo->size = batches * ubo->batch_stride;
+	ubo->data = calloc(1, ubo->size);
+	if (!ubo->data)
+		return -1;
+
+	glGenBuffers(1, &ubo->buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo->buffer);
+	glBufferData(GL_UNIFORM_BUFFER, ubo->size, NULL, GL_STREAM_DRAW);
+
+	return 0;
+}
+
+void submit_objects_ubo(const struct objects_ubo *ubo, unsigned count,
+						void (*draw_instanced)(unsigned count))
+{
+	unsigned i;
+
+	/* orphan last frame's storage rather than waiting for it: */
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo->buffer);
+	glBufferData(GL_UNIFORM_BUFFER, ubo->size, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, ubo->size, ubo->data);
+
+	for (i = 0; i < count; i += ubo->batch) {
+		unsigned n = count - i < ubo->batch ? count - i : ubo->batch;
+
+		/* always the whole block array the shaders declare, a short
+		 * last batch only draws fewer instances:
+		 */
+		glBindBufferRange(GL_UNIFORM_BUFFER, ubo->binding, ubo->buffer,
+						  (i / ubo->batch) * ubo->batch_stride,
+						  ubo->batch * sizeof(struct object_block));
+		draw_instanced(n);
+	}
+}
+
+static void report(struct objects *objs)
+{
+	static unsigned frames;
+
+	if (++frames % 120)
+		return;
+
+	printf("%u objects: %.3f ms transform (%u threads), %.3f ms draw per frame\n",
+		   objs->count,
+		   (double)objs->transform_ns / frames / 1000000.0,
+		   threadpool_size(pool),
+		   (double)objs->draw_ns / frames / 1000000.0);
+}
+
+void draw_objects(struct objects *objs, GLfloat time,
+				  GLint modelviewmatrix, GLint modelviewprojectionmatrix,
+				  GLint normalmatrix, void (*draw_geometry)(void))
+{
+	int64_t start = get_time_ns();
+	unsigned i;
+
+	update_objects(objs, time);
+	objs->transform_ns += get_time_ns() - start;
+
+	start = get_time_ns();
+	for (i = 0; i < objs->count; i++) {
+		glUniformMatrix4fv(modelviewmatrix, 1, GL_FALSE, &objs->modelview[i].m[0][0]);
+		glUniformMatrix4fv(modelviewprojectionmatrix, 1, GL_FALSE, &objs->modelviewprojection[i].m[0][0]);
+		glUniformMatrix3fv(normalmatrix, 1, GL_FALSE, objs->normal[i]);
+		draw_geometry();
+	}
+	objs->draw_ns += get_time_ns() - start;
+
+	report(objs);
+}
+
+void draw_objects_instanced(struct objects *objs, GLfloat time,
+							void (*draw_instanced)(unsigned count))
+{
+	int64_t start = get_time_ns();
+
+	update_objects(objs, time);
+	objs->transform_ns += get_time_ns() - start;
+
+	start = get_time_ns();
+	submit_objects_ubo(objs->ubo, objs->count, draw_instanced);
+	objs->draw_ns += get_time_ns() - start;
+
+	report(objs);
+}
+
+struct objects * init_objects(unsigned count, GLfloat extent, GLfloat aspect,
+							  const ESMatrix *projection)
+{
+	unsigned cols, rows, i;
+	GLfloat cell;
+
+	pool = threadpool_create(0);
+	if (!pool) {
+		printf("failed to create thread pool\n");
+		return NULL;
+	}
+
+	objects.count = count;
+	objects.projection = projection;
+	objects.x = calloc(count, sizeof(*objects.x));
+	objects.y = calloc(count, sizeof(*objects.y));
+	objects.scale = calloc(count, sizeof(*objects.scale));
+	objects.phase = calloc(count, sizeof(*objects.phase));
+	objects.rate = calloc(count, sizeof(*objects.rate));
+	objects.modelview = calloc(count, sizeof(*objects.modelview));
+	objects.modelviewprojection = calloc(count, sizeof(*objects.modelviewprojection));
+	objects.normal = calloc(count, sizeof(*objects.normal));
+
+	if (!objects.x || !objects.y || !objects.scale || !objects.phase || !objects.rate ||
+		!objects.modelview || !objects.modelviewprojection || !objects.normal) {
+		printf("failed to allocate %u objects\n", count);
+		finish_objects();
+		return NULL;
+	}
+
+	/* a grid roughly matching the aspect ratio of the screen, with the
+	 * cubes sized so they don't overlap however they are rotated:
+	 */
+	cols = ceilf(sqrtf(count / aspect));
+	rows = (count + cols - 1) / cols;
+	cell = fminf(2.0f * extent / cols, 2.0f * extent * aspect / rows);
+
+	for (i = 0; i < count; i++) {
+		/* cheap deterministic per object variation: */
+		unsigned hash = i * 2654435761u;
+
+		objects.x[i] = (i % cols + 0.5f) * cell - cols * cell / 2.0f;
+		objects.y[i] = (i / cols + 0.5f) * cell - rows * cell / 2.0f;
+		objects.scale[i] = cell * 0.28f;
+		objects.phase[i] = (hash >> 16) % 360;
+		objects.rate[i] = 0.5f + (hash & 0xffff) / 65536.0f;
+	}
+
+	printf("Drawing %u objects (%ux%u), transforms on %u threads\n",
+		   count, cols, rows, threadpool_size(pool));
+
+	return &objects;
+}
+
+void finish_objects(void)
+{
+	if (!pool)
+		return;
+
+	threadpool_destroy(pool);
+	pool = NULL;
+
+	free(objects.x);
+	free(objects.y);
+	free(objects.scale);
+	free(objects.phase);
+	free(objects.rate);
+	free(objects.modelview);
+	free(objects.modelviewprojection);
+	free(objects.normal);
+	memset(&objects, 0, sizeof(objects));
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _OBJECTS_H
+#define _OBJECTS_H
+
+#include <stdint.h>
+
+#include "esUtil.h"
+
+/* Stress mode: many independently animated cubes instead of one.
+ *
+ * The animation parameters are kept as separate arrays (structure of
+ * arrays), and the transforms for a frame are computed in one batched
+ * pass split across a thread pool.  The results are whole matrices per
+ * object, as the uniforms, the uniform blocks and the software renderer
+ * all consume them.  Drawing then only changes uniforms between objects,
+ * all other state (program, buffers, textures) is bound once by the
+ * scene.
+ */
+
+/* number of cubes to draw, set with --objects */
+extern unsigned num_objects;
+
+/* ES3: one object's matrices in a std140 uniform block, matching
+ *
+ *   struct object {
+ *       mat4 modelview;
+ *       mat4 modelviewprojection;
+ *       mat3 normal;
+ *   };
+ */
+struct object_block {
+	GLfloat modelview[16];
+	GLfloat modelviewprojection[16];
+	GLfloat normal[3][4];  /* std140 pads mat3 columns to vec4 */
+};
+
+/* ES3: per-frame object matrices, drawn in instanced batches of up to
+ * 'batch' objects, each batch bound as a range of one uniform buffer:
+ */
+struct objects_ubo {
+	GLuint buffer;
+	GLuint binding;
+	unsigned batch;         /* objects per instanced draw */
+	unsigned batch_stride;  /* bytes, honoring the UBO offset alignment */
+	unsigned size;
+	uint8_t *data;
+};
+
+struct objects {
+	unsigned count;
+
+	/* per object animation parameters: */
+	GLfloat *x, *y, *scale;
+	GLfloat *phase, *rate;
+
+	/* per object results, updated each frame: */
+	ESMatrix *modelview;
+	ESMatrix *modelviewprojection;
+	GLfloat (*normal)[9];
+
+	const ESMatrix *projection;
+
+	/* if set, update_objects() also fills the uniform block data: */
+	struct objects_ubo *ubo;
+
+	/* animation position being updated (see draw_frame()): */
+	GLfloat time;
+
+	/* stats, for the periodic report: */
+	int64_t transform_ns, draw_ns;
+};
+
+/* lay out count cubes in a grid filling +/- extent (at z = -8) */
+struct objects * init_objects(unsigned count, GLfloat extent, GLfloat aspect,
+							  const ESMatrix *projection);
+void update_objects(struct objects *objs, GLfloat time);
+void draw_objects(struct objects *objs, GLfloat time,
+				  GLint modelviewmatrix, GLint modelviewprojectionmatrix,
+				  GLint normalmatrix, void (*draw_geometry)(void));
+
+void finish_objects(void);
+
+int init_objects_ubo(struct objects_ubo *ubo, GLuint binding, unsigned count);
+struct object_block * objects_ubo_block(const struct objects_ubo *ubo,
+										unsigned i);
+void pack_object_block(struct object_block *block, const ESMatrix *modelview,
+					   const ESMatrix *modelviewprojection,
+					   const GLfloat normal[9]);
+void submit_objects_ubo(const struct objects_ubo *ubo, unsigned count,
+						void (*draw_instanced)(unsigned count));
+void draw_objects_instanced(struct objects *objs, GLfloat time,
+							void (*draw_instanced)(unsigned count));
+
+#endif /* _OBJECTS_H */
@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pattern.h"
+#include "threadpool.h"
+
+#define VEC_PIXELS 4
+
+typedef uint32_t vec4u __attribute__((vector_size(16)));
+typedef int32_t vec4i __attribute__((vector_size(16)));
+typedef uint16_t vec4s __attribute__((vector_size(8)));
+typedef uint8_t vec4b __attribute__((vector_size(4)));
+
+/* zone plate cosine, a full turn: */
+#define COS_BITS 10
+
+static uint16_t cos_table[1 << COS_BITS];
+
+/* Coefficients in 15 fractional bits, from 16 bit RGB:
+ *
+ *   Y' = (kr * R + kg * G + kb * B) >> 15
+ *   Cb = ((B - Y') * kcb) >> 15, Cr = ((R - Y') * kcr) >> 15
+ *
+ * then scaled to the output depth and range:
+ *
+ *   Y = y_offset + ((Y' * y_scale + 32768) >> 16)
+ *   C = c_offset + ((C * c_scale + 32768) >> 16)
+ */
+struct pattern_coeffs {
+	uint32_t kr, kg, kb;
+	int32_t kcb, kcr;
+	uint32_t y_offset, y_scale;
+	int32_t c_offset, c_scale;
+};
+
+struct pattern_job {
+	enum pattern pattern;
+	const struct pattern_image *dst;
+	struct pattern_coeffs coeffs;
+	unsigned frame;
+	uint32_t zone_k;      /* zone plate turns per pixel squared, 0.32 */
+};
+
+/* rows of 16 bit RGB, padded to whole vectors: */
+struct rgb_row {
+	uint32_t *r, *g, *b;
+};
+
+static const char *pattern_names[] = {
+	[PATTERN_BARS]      = "bars",
+	[PATTERN_ZONEPLATE] = "zoneplate",
+	[PATTERN_GRADIENT]  = "gradient",
+};
+
+int parse_pattern(const char *name)
+{
+	for (unsigned i = 0; i < sizeof(pattern_names) / sizeof(pattern_names[0]); i++) {
+		if (strcmp(name, pattern_names[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+const char * pattern_name(enum pattern pattern)
+{
+	return pattern_names[pattern];
+}
+
+static vec4u load4(const uint32_t *p)
+{
+	vec4u v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static void store4(uint32_t *p, vec4u v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static vec4u x_vector(unsigned x)
+{
+	vec4u v = { 0, 1, 2, 3 };
+	return v + x;
+}
+
+/* SMPTE ECR 1-1978 layout: 75% bars, the reverse blue castellations, and
+ * -I, white, +Q, black and PLUGE.  In units of 1/84 of the width, so a
+ * bar is 12.  Blacker than black can't be represented in RGB, so the
+ * PLUGE is 0, 0 and +4%.
+ */
+struct bar {
+	uint8_t units, r, g, b;
+};
+
+static const struct bar bars_top[] = {
+	{ 12, 191, 191, 191 }, { 12, 191, 191,   0 }, { 12,   0, 191, 191 },
+	{ 12,   0, 191,   0 }, { 12, 191,   0, 191 }, { 12, 191,   0,   0 },
+	{ 12,   0,   0, 191 },
+};
+
+static const struct bar bars_middle[] = {
+	{ 12,   0,   0, 191 }, { 12,   0,   0,   0 }, { 12, 191,   0, 191 },
+	{ 12,   0,   0,   0 }, { 12,   0, 191, 191 }, { 12,   0,   0,   0 },
+	{ 12, 191, 191, 191 },
+};
+
+static const struct bar bars_bottom[] = {
+	{ 15,   0,  33,  76 }, { 15, 255, 255, 255 }, { 15,  50,   0, 106 },
+	{ 15,   0,   0,   0 }, {  4,   0,   0,   0 }, {  4,   0,   0,   0 },
+	{  4,  10,  10,  10 }, { 12,   0,   0,   0 },
+};
+
+static void fill_bars(const struct pattern_job *job, unsigned y,
+					  const struct rgb_row *row)
+{
+	const struct pattern_image *dst = job->dst;
+	const struct bar *bars;
+	unsigned num_bars, units = 0, x = 0;
+
+	if (y < dst->height * 7 / 12) {
+		bars = bars_top;
+		num_bars = sizeof(bars_top) / sizeof(bars_top[0]);
+	} else if (y < dst->height * 8 / 12) {
+		bars = bars_middle;
+		num_bars = sizeof(bars_middle) / sizeof(bars_middle[0]);
+	} else {
+		bars = bars_bottom;
+		num_bars = sizeof(bars_bottom) / sizeof(bars_bottom[0]);
+	}
+
+	for (unsigned i = 0; i < num_bars; i++) {
+		unsigned end;
+
+		units += bars[i].units;
+		end = (i == num_bars - 1) ? dst->width : units * dst->width / 84;
+
+		/* 8 bit to 16 bit is * 257: */
+		for (; x < end; x++) {
+			row->r[x] = bars[i].r * 257;
+			row->g[x] = bars[i].g * 257;
+			row->b[x] = bars[i].b * 257;
+		}
+	}
+}
+
+static void fill_zoneplate(const struct pattern_job *job, unsigned y,
+						   const struct rgb_row *row)
+{
+	const struct pattern_image *dst = job->dst;
+	/* the rings move out by a full period every 120 frames: */
+	uint32_t phase = (uint32_t)((UINT64_C(1) << 32) / 120 * job->frame);
+	uint32_t dy = y - dst->height / 2;
+	uint32_t row_phase = dy * dy * job->zone_k - phase;
+
+	/* all mod 2^32, which is a full turn: */
+	for (unsigned x = 0; x < dst->width; x += VEC_PIXELS) {
+		vec4u dx = x_vector(x) - dst->width / 2;
+		vec4u t = (dx * dx * job->zone_k + row_phase) >> (32 - COS_BITS);
+		vec4u v;
+
+		for (unsigned i = 0; i < VEC_PIXELS; i++)
+			v[i] = cos_table[t[i]];
+
+		store4(&row->r[x], v);
+		store4(&row->g[x], v);
+		store4(&row->b[x], v);
+	}
+}
+
+static void fill_gradient(const struct pattern_job *job, unsigned y,
+						  const struct rgb_row *row)
+{
+	const struct pattern_image *dst = job->dst;
+	/* 16.16 steps per pixel: */
+	uint32_t x_step = UINT32_C(0xffff0000) / (dst->width > 1 ? dst->width - 1 : 1);
+	uint32_t y_step = UINT32_C(0xffff0000) / (dst->height > 1 ? dst->height - 1 : 1);
+	uint32_t g = (y * y_step) >> 16;
+	/* a triangle wave over twice the width, moving 8 pixels a frame: */
+	uint32_t b_step = UINT32_C(0x1ffff) / dst->width;
+	uint32_t b_start = (y + job->frame * 8) * b_step;
+
+	for (unsigned x = 0; x < dst->width; x += VEC_PIXELS) {
+		vec4u xv = x_vector(x);
+		vec4u b = (xv * b_step + b_start) & 0x1ffff;
+
+		store4(&row->r[x], (xv * x_step) >> 16);
+		store4(&row->g[x], (vec4u){} + g);
+		/* b > 0xffff ? 0x1ffff - b : b, as a mask from bit 16: */
+		store4(&row->b[x], b ^ ((0 - (b >> 16)) & 0x1ffff));
+	}
+}
+
+static void fill_rgb(const struct pattern_job *job, unsigned y,
+					 const struct rgb_row *row)
+{
+	switch (job->pattern) {
+	case PATTERN_BARS:
+		fill_bars(job, y, row);
+		break;
+	case PATTERN_ZONEPLATE:
+		fill_zoneplate(job, y, row);
+		break;
+	case PATTERN_GRADIENT:
+		fill_gradient(job, y, row);
+		break;
+	}
+}
+
+/* DRM_FORMAT_ABGR8888, bytes R, G, B, A: */
+static void write_rgba(const struct pattern_image *dst, unsigned y,
+					   const struct rgb_row *row)
+{
+	uint32_t *out = (uint32_t *)(dst->planes[0] + y * dst->strides[0]);
+	unsigned x;
+
+	for (x = 0; x + VEC_PIXELS <= dst->width; x += VEC_PIXELS) {
+		vec4u r = load4(&row->r[x]) >> 8;
+		vec4u g = load4(&row->g[x]) >> 8;
+		vec4u b = load4(&row->b[x]) >> 8;
+
+		store4(&out[x], r | g << 8 | b << 16 | 0xff000000);
+	}
+	for (; x < dst->width; x++)
+		out[x] = row->r[x] >> 8 | (row->g[x] >> 8) << 8 |
+				(row->b[x] >> 8) << 16 | 0xff000000;
+}
+
+static uint32_t luma(const struct pattern_coeffs *c, uint32_t r, uint32_t g, uint32_t b)
+{
+	return (c->kr * r + c->kg * g + c->kb * b) >> 15;
+}
+
+static void write_luma(const struct pattern_image *dst, const struct pattern_coeffs *coeffs,
+					   unsigned y, const struct rgb_row *row)
+{
+	/* local copies, the byte stores could alias them otherwise: */
+	const struct pattern_coeffs c = *coeffs;
+	const uint32_t *r = row->r, *g = row->g, *b = row->b;
+	const unsigned width = dst->width;
+	uint8_t *out = dst->planes[0] + y * dst->strides[0];
+	bool p010 = dst->format == FRAME_P010;
+	unsigned x;
+
+	for (x = 0; x + VEC_PIXELS <= width; x += VEC_PIXELS) {
+		vec4u l = (c.kr * load4(&r[x]) + c.kg * load4(&g[x]) +
+				   c.kb * load4(&b[x])) >> 15;
+
+		l = c.y_offset + ((l * c.y_scale + 32768) >> 16);
+		if (p010) {
+			/* 10 bits, in the high bits of each 16: */
+			vec4s v = __builtin_convertvector(l << 6, vec4s);
+			memcpy(&out[x * 2], &v, sizeof(v));
+		} else {
+			vec4b v = __builtin_convertvector(l, vec4b);
+			memcpy(&out[x], &v, sizeof(v));
+		}
+	}
+	for (; x < width; x++) {
+		uint32_t l = luma(&c, r[x], g[x], b[x]);
+
+		l = c.y_offset + ((l * c.y_scale + 32768) >> 16);
+		if (p010) {
+			uint16_t v = l << 6;
+			memcpy(&out[x * 2], &v, sizeof(v));
+		} else {
+			out[x] = l;
+		}
+	}
+}
+
+/* sums of the 2x2 blocks of pixels x to x + 7 in rows a and b: */
+static vec4u block_sums(const uint32_t *a, const uint32_t *b, unsigned x)
+{
+	vec4u lo = load4(&a[x]) + load4(&b[x]);
+	vec4u hi = load4(&a[x + 4]) + load4(&b[x + 4]);
+
+	return (vec4u){ lo[0] + lo[1], lo[2] + lo[3], hi[0] + hi[1], hi[2] + hi[3] };
+}
+
+static void write_chroma(const struct pattern_image *dst, const struct pattern_coeffs *coeffs,
+						 unsigned y, const struct rgb_row *a, const struct rgb_row *b)
+{
+	const struct pattern_coeffs c = *coeffs;
+	uint8_t *uv = dst->planes[1] + y / 2 * dst->strides[1];
+
+	/* 4 chroma samples at a time, the rows are padded to match: */
+	for (unsigned x = 0; x < dst->width; x += 2 * VEC_PIXELS) {
+		vec4u r = (block_sums(a->r, b->r, x) + 2) >> 2;
+		vec4u g = (block_sums(a->g, b->g, x) + 2) >> 2;
+		vec4u bl = (block_sums(a->b, b->b, x) + 2) >> 2;
+		vec4i l = (vec4i)((c.kr * r + c.kg * g + c.kb * bl) >> 15);
+		vec4i cb = (((vec4i)bl - l) * c.kcb) >> 15;
+		vec4i cr = (((vec4i)r - l) * c.kcr) >> 15;
+		unsigned j = x / 2, n = (dst->width - x) / 2;
+
+		cb = c.c_offset + ((cb * c.c_scale + 32768) >> 16);
+		cr = c.c_offset + ((cr * c.c_scale + 32768) >> 16);
+		if (n > VEC_PIXELS)
+			n = VEC_PIXELS;
+
+		switch (dst->format) {
+		case FRAME_NV12: {
+			uint8_t p[2 * VEC_PIXELS] = {
+				cb[0], cr[0], cb[1], cr[1], cb[2], cr[2], cb[3], cr[3],
+			};
+			memcpy(&uv[2 * j], p, 2 * n);
+			break;
+		}
+		case FRAME_I420: {
+			vec4b u = __builtin_convertvector(cb, vec4b);
+			vec4b v = __builtin_convertvector(cr, vec4b);
+			memcpy(&uv[j], &u, n);
+			memcpy(&dst->planes[2][y / 2 * dst->strides[2] + j], &v, n);
+			break;
+		}
+		case FRAME_P010: {
+			uint16_t p[2 * VEC_PIXELS] = {
+				cb[0] << 6, cr[0] << 6, cb[1] << 6, cr[1] << 6,
+				cb[2] << 6, cr[2] << 6, cb[3] << 6, cr[3] << 6,
+			};
+			memcpy(&uv[4 * j], p, 4 * n);
+			break;
+		}
+		case FRAME_RGBA:
+			break;
+		}
+	}
+}
+
+static void fill_rows(void *arg, unsigned start, unsigned end)
+{
+	const struct pattern_job *job = arg;
+	const struct pattern_image *dst = job->dst;
+	unsigned padded = (dst->width + 2 * VEC_PIXELS - 1) & ~(2 * VEC_PIXELS - 1);
+	uint32_t *buf = malloc(padded * 6 * sizeof(*buf));
+	struct rgb_row rows[2];
+
+	if (!buf)
+		return;
+
+	for (unsigned i = 0; i < 2; i++) {
+		rows[i].r = &buf[padded * (3 * i + 0)];
+		rows[i].g = &buf[padded * (3 * i + 1)];
+		rows[i].b = &buf[padded * (3 * i + 2)];
+	}
+
+	for (unsigned i = start; i < end; i++) {
+		if (dst->format == FRAME_RGBA) {
+			fill_rgb(job, i, &rows[0]);
+			write_rgba(dst, i, &rows[0]);
+			continue;
+		}
+
+		/* row pairs, for the subsampled chroma: */
+		fill_rgb(job, 2 * i, &rows[0]);
+		fill_rgb(job, 2 * i + 1, &rows[1]);
+		write_luma(dst, &job->coeffs, 2 * i, &rows[0]);
+		write_luma(dst, &job->coeffs, 2 * i + 1, &rows[1]);
+		write_chroma(dst, &job->coeffs, 2 * i, &rows[0], &rows[1]);
+	}
+
+	free(buf);
+}
+
+static void get_coeffs(enum yuv_matrix matrix, enum yuv_range range,
+					   bool ten_bit, struct pattern_coeffs *c)
+{
+	static const double kr[] = { [YUV_BT601] = 0.299, [YUV_BT709] = 0.2126, [YUV_BT2020] = 0.2627 };
+	static const double kb[] = { [YUV_BT601] = 0.114, [YUV_BT709] = 0.0722, [YUV_BT2020] = 0.0593 };
+	unsigned max = ten_bit ? 1023 : 255;
+	unsigned scale = ten_bit ? 4 : 1;
+
+	c->kr = lround(kr[matrix] * 32768);
+	c->kb = lround(kb[matrix] * 32768);
+	c->kg = 32768 - c->kr - c->kb;
+	c->kcb = lround(32768 / (2 * (1 - kb[matrix])));
+	c->kcr = lround(32768 / (2 * (1 - kr[matrix])));
+
+	c->c_offset = 128 * scale;
+	if (range == YUV_LIMITED) {
+		c->y_offset = 16 * scale;
+		c->y_scale = 219 * scale;
+		c->c_scale = 224 * scale;
+	} else {
+		c->y_offset = 0;
+		c->y_scale = max;
+		c->c_scale = max;
+	}
+}
+
+void pattern_fill(enum pattern pattern, const struct pattern_image *dst,
+				  enum yuv_matrix matrix, enum yuv_range range,
+				  unsigned frame, struct threadpool *pool)
+{
+	struct pattern_job job = {
+		.pattern = pattern,
+		.dst = dst,
+		.frame = frame,
+	};
+	unsigned count = dst->format == FRAME_RGBA ? dst->height : dst->height / 2;
+	unsigned radius = (dst->width < dst->height ? dst->width : dst->height) / 2;
+
+	/* 0.5 + 0.5 cos(), 16 bit: */
+	if (!cos_table[0]) {
+		for (unsigned i = 0; i < (1 << COS_BITS); i++)
+			cos_table[i] = lround(32767.5 + 32767.5 * cos(2 * M_PI * i / (1 << COS_BITS)));
+	}
+
+	/* the ring frequency, 2 * k * r turns per pixel, reaches 1/2 at
+	 * the radius:
+	 */
+	job.zone_k = (UINT64_C(1) << 30) / (radius ? radius : 1);
+
+	get_coeffs(matrix, range, dst->format == FRAME_P010, &job.coeffs);
+
+	if (pool)
+		threadpool_run(pool, fill_rows, &job, count);
+	else
+		fill_rows(&job, 0, count);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PATTERN_H
+#define _PATTERN_H
+
+#include <stdint.h>
+
+#include "frames.h"
+#include "yuv.h"
+
+/* Procedural test patterns, generated straight into (mapped) buffers of
+ * any size, so texture bandwidth can be exercised at realistic frame
+ * sizes and sampling/scaling checked against known content.
+ *
+ * Patterns are computed as 16 bit RGB rows, 4 pixels at a time with GCC
+ * vector extensions, then packed or converted to YUV (chroma averaged
+ * over 2x2 pixels).  Rows are split across a threadpool.
+ */
+
+enum pattern {
+	PATTERN_BARS,        /* SMPTE style color bars */
+	PATTERN_ZONEPLATE,   /* circular zone plate, Nyquist at the inscribed
+	                      * circle, rings moving with the frame number */
+	PATTERN_GRADIENT,    /* horizontal red, vertical green ramps and a
+	                      * moving diagonal blue one */
+};
+
+struct pattern_image {
+	enum frame_format format;
+	unsigned width, height;     /* even for the YUV formats */
+	uint8_t *planes[3];
+	unsigned strides[3];        /* in bytes */
+};
+
+struct threadpool;
+
+int parse_pattern(const char *name);
+const char * pattern_name(enum pattern pattern);
+
+/* matrix and range only matter for YUV, pool may be NULL: */
+void pattern_fill(enum pattern pattern, const struct pattern_image *dst,
+				  enum yuv_matrix matrix, enum yuv_range range,
+				  unsigned frame, struct threadpool *pool);
+
+#endif /* _PATTERN_H */
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PROBES_H
+#define _PROBES_H
+
+/* USDT (statically defined tracing) probes in the render and present
+ * loop, for bpftrace / perf / systemtap on a running kmscube:
+ *
+ *   bpftrace -e 'usdt:./kmscube:kmscube:commit_end { printf("%d\n", arg1); }'
+ *
+ * An unattached probe is a single nop, its arguments are only described
+ * in an ELF note.  Without sys/sdt.h they compile away entirely.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define PROBE(name)                  DTRACE_PROBE(kmscube, name)
+#define PROBE1(name, a)              DTRACE_PROBE1(kmscube, name, a)
+#define PROBE2(name, a, b)           DTRACE_PROBE2(kmscube, name, a, b)
+#define PROBE3(name, a, b, c)        DTRACE_PROBE3(kmscube, name, a, b, c)
+#define PROBE4(name, a, b, c, d)     DTRACE_PROBE4(kmscube, name, a, b, c, d)
+#else
+#define PROBE(name)                  do { } while (0)
+#define PROBE1(name, a)              do { } while (0)
+#define PROBE2(name, a, b)           do { } while (0)
+#define PROBE3(name, a, b, c)        do { } while (0)
+#define PROBE4(name, a, b, c, d)     do { } while (0)
+#endif
+
+#endif /* _PROBES_H */
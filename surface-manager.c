@@ -24,20 +24,29 @@
  */
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "common.h"
 #include "drm-common.h"
+#include "probes.h"
 #include "surface-manager.h"
+#include "trace.h"
 
 static struct gbm gbm;
+static struct prime prime;
+static struct dumb dumb;
 #ifdef HAVE_ALLOCATOR
 static struct allocator allocator;
 #endif
 static struct surfmgr surfmgr;
 
+/* as requested for the main surface, for the ones of further outputs: */
+static uint64_t gbm_modifier = DRM_FORMAT_MOD_INVALID;
+
 #ifdef HAVE_GBM_MODIFIERS
 static int
 get_modifiers(uint64_t **mods)
@@ -49,17 +58,16 @@ get_modifiers(uint64_t **mods)
 }
 #endif
 
-static const struct gbm * init_gbm(int drm_fd, int w, int h, uint64_t modifier)
+/* a swapchain KMS can scan out of directly: */
+static struct gbm_surface * create_scanout_surface(int w, int h, uint32_t format,
+												   uint64_t modifier)
 {
-	gbm.dev = gbm_create_device(drm_fd);
-
 #ifndef HAVE_GBM_MODIFIERS
 	if (modifier != DRM_FORMAT_MOD_INVALID) {
 		fprintf(stderr, "Modifiers requested but support isn't available\n");
 		return NULL;
 	}
-	gbm.surface = gbm_surface_create(gbm.dev, w, h,
-			GBM_FORMAT_XRGB8888,
+	return gbm_surface_create(gbm.dev, w, h, format,
 			GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING);
 #else
 	uint64_t *mods;
@@ -70,9 +78,31 @@ static const struct gbm * init_gbm(int drm_fd, int w, int h, uint64_t modifier)
 	} else {
 		count = get_modifiers(&mods);
 	}
-	gbm.surface = gbm_surface_create_with_modifiers(gbm.dev, w, h,
-			GBM_FORMAT_XRGB8888, mods, count);
+	return gbm_surface_create_with_modifiers(gbm.dev, w, h,
+			format, mods, count);
 #endif
+}
+
+static const struct gbm * init_gbm(int drm_fd, int w, int h, uint64_t modifier,
+								   bool prime)
+{
+	gbm.dev = gbm_create_device(drm_fd);
+
+	if (prime) {
+		/* Never scanned out directly, so let the driver pick its
+		 * preferred layout and leave the linear copy to prime_blit():
+		 */
+		if (modifier != DRM_FORMAT_MOD_INVALID) {
+			fprintf(stderr, "Modifiers cannot be combined with PRIME offload\n");
+			return NULL;
+		}
+		gbm.surface = gbm_surface_create(gbm.dev, w, h,
+				GBM_FORMAT_XRGB8888, GBM_BO_USE_RENDERING);
+	} else {
+		gbm.surface = create_scanout_surface(w, h, GBM_FORMAT_XRGB8888,
+				modifier);
+		gbm_modifier = modifier;
+	}
 
 	if (!gbm.surface) {
 		printf("failed to create gbm surface\n");
@@ -82,8 +112,490 @@ static const struct gbm * init_gbm(int drm_fd, int w, int h, uint64_t modifier)
 	return &gbm;
 }
 
+static const char *prime_blit_vs =
+		"attribute vec2 in_position;        \n"
+		"                                   \n"
+		"varying vec2 vTexCoord;            \n"
+		"                                   \n"
+		"void main()                        \n"
+		"{                                  \n"
+		"    gl_Position = vec4(in_position, 0.0, 1.0);\n"
+		"    vTexCoord = 0.5 * (in_position + 1.0);\n"
+		"}                                  \n";
+
+static const char *prime_blit_fs =
+		"precision mediump float;           \n"
+		"                                   \n"
+		"uniform sampler2D uTex;            \n"
+		"                                   \n"
+		"varying vec2 vTexCoord;            \n"
+		"                                   \n"
+		"void main()                        \n"
+		"{                                  \n"
+		"    gl_FragColor = texture2D(uTex, vTexCoord);\n"
+		"}                                  \n";
+
+/* Render buffers of the gbm surface, imported once for sampling: */
+struct prime_source {
+	EGLDisplay display;
+	PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR;
+	EGLImage image;
+	GLuint texture;
+};
+
+static void prime_source_destroy(struct gbm_bo *bo, void *data)
+{
+	struct prime_source *src = data;
+
+	(void)bo;
+
+	/* The texture goes away with the private context; the image is
+	 * display-wide:
+	 */
+	src->eglDestroyImageKHR(src->display, src->image);
+	free(src);
+}
+
+static struct prime_source *prime_get_source(const struct egl *egl,
+											 struct gbm_bo *bo)
+{
+	struct prime_source *src = gbm_bo_get_user_data(bo);
+
+	if (src)
+		return src;
+
+	src = calloc(1, sizeof(*src));
+	if (!src)
+		return NULL;
+
+	src->display = egl->display;
+	src->eglDestroyImageKHR = egl->eglDestroyImageKHR;
+	src->image = egl->eglCreateImageKHR(egl->display, EGL_NO_CONTEXT,
+			EGL_NATIVE_PIXMAP_KHR, (EGLClientBuffer)bo, NULL);
+	if (src->image == EGL_NO_IMAGE_KHR) {
+		printf("failed to import render buffer\n");
+		free(src);
+		return NULL;
+	}
+
+	glGenTextures(1, &src->texture);
+	glBindTexture(GL_TEXTURE_2D, src->texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	egl->glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, src->image);
+
+	gbm_bo_set_user_data(bo, src, prime_source_destroy);
+
+	return src;
+}
+
+static int init_prime_buffers(int drm_fd, int w, int h)
+{
+	uint32_t i;
+
+	prime.drm_fd = drm_fd;
+
+	for (i = 0; i < ARRAY_SIZE(prime.buffers); i++) {
+		struct prime_buffer *buf = &prime.buffers[i];
+		struct drm_gem_close closeParams;
+		uint32_t gemHandle;
+		int fd, res;
+
+		buf->bo = gbm_bo_create(gbm.dev, w, h, GBM_FORMAT_XRGB8888,
+				GBM_BO_USE_LINEAR | GBM_BO_USE_RENDERING);
+		if (!buf->bo) {
+			printf("failed to allocate linear PRIME buffer\n");
+			return -1;
+		}
+
+		fd = gbm_bo_get_fd(buf->bo);
+		res = drmPrimeFDToHandle(drm_fd, fd, &gemHandle);
+		close(fd);
+
+		if (res) {
+			printf("display device cannot import PRIME buffer\n");
+			return -1;
+		}
+
+		buf->fb = drm_fb_get_from_gem(drm_fd, gemHandle, w, h,
+									  gbm_bo_get_stride(buf->bo),
+									  DRM_FORMAT_MOD_LINEAR);
+
+		memset(&closeParams, 0, sizeof(closeParams));
+		closeParams.handle = gemHandle;
+		drmIoctl(drm_fd, DRM_IOCTL_GEM_CLOSE, &closeParams);
+
+		if (!buf->fb)
+			return -1;
+
+		buf->fb->bo = buf->bo;
+	}
+
+	return 0;
+}
+
+static const struct program_attrib prime_attribs[] = {
+	{ 0, "in_position" },
+};
+
+static int init_prime_egl(const struct surfmgr *surfmgr, const struct egl *egl)
+{
+	static const EGLint context_attribs[] = {
+		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_NONE
+	};
+	static const GLfloat quad[] = {
+		-1.0f, -1.0f,
+		+1.0f, -1.0f,
+		-1.0f, +1.0f,
+		+1.0f, +1.0f,
+	};
+	uint32_t i;
+	int ret;
+
+	if (egl_check(egl, eglCreateImageKHR) ||
+	    egl_check(egl, eglDestroyImageKHR) ||
+	    egl_check(egl, glEGLImageTargetTexture2DOES) ||
+	    egl_check(egl, glEGLImageTargetRenderbufferStorageOES))
+		return -1;
+
+	/* The copy runs in its own context so it cannot disturb the
+	 * scene's GL state:
+	 */
+	prime.context = eglCreateContext(egl->display, egl->config,
+			egl->context, context_attribs);
+	if (prime.context == EGL_NO_CONTEXT) {
+		printf("failed to create PRIME copy context\n");
+		return -1;
+	}
+
+	if (!eglMakeCurrent(egl->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+						prime.context)) {
+		printf("PRIME offload requires EGL_KHR_surfaceless_context\n");
+		return -1;
+	}
+
+	/* query objects aren't shared, so the copy's live in its context: */
+	if (!gpu_timer_init(&prime.timer, egl))
+		printf("no GPU timer queries, PRIME copy GPU time not reported\n");
+
+	ret = create_program(prime_blit_vs, prime_blit_fs,
+			prime_attribs, ARRAY_SIZE(prime_attribs));
+	if (ret < 0)
+		return -1;
+
+	prime.program = ret;
+
+	ret = link_program(prime.program);
+	if (ret)
+		return -1;
+
+	glUseProgram(prime.program);
+	prime.texture = glGetUniformLocation(prime.program, "uTex");
+	glUniform1i(prime.texture, 0);
+
+	glGenBuffers(1, &prime.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, prime.vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(0);
+
+	glViewport(0, 0, surfmgr->width, surfmgr->height);
+	glActiveTexture(GL_TEXTURE0);
+
+	for (i = 0; i < ARRAY_SIZE(prime.buffers); i++) {
+		struct prime_buffer *buf = &prime.buffers[i];
+
+		buf->image = egl->eglCreateImageKHR(egl->display, EGL_NO_CONTEXT,
+				EGL_NATIVE_PIXMAP_KHR, (EGLClientBuffer)buf->bo, NULL);
+		if (buf->image == EGL_NO_IMAGE_KHR) {
+			printf("failed to import PRIME buffer\n");
+			return -1;
+		}
+
+		glGenRenderbuffers(1, &buf->renderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, buf->renderbuffer);
+		egl->glEGLImageTargetRenderbufferStorageOES(GL_RENDERBUFFER,
+													buf->image);
+
+		glGenFramebuffers(1, &buf->framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, buf->framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+								  GL_RENDERBUFFER, buf->renderbuffer);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+			GL_FRAMEBUFFER_COMPLETE) {
+			printf("PRIME buffer is not renderable\n");
+			return -1;
+		}
+	}
+
+	eglMakeCurrent(egl->display, egl->surface, egl->surface, egl->context);
+
+	return 0;
+}
+
+/*
+ * Copy the frame just swapped on the render device into a free linear
+ * buffer.  Returns the sync object signaled when the copy completes.
+ */
+static EGLSyncKHR prime_blit(const struct egl *egl, EGLenum sync_type)
+{
+	struct prime_buffer *dst = NULL;
+	struct prime_source *src;
+	struct gbm_bo *bo;
+	EGLSyncKHR fence = EGL_NO_SYNC_KHR;
+	int64_t start = get_time_ns();
+	uint32_t i;
+
+	/* Round-robin, so that with a nonblocking commit still pending we
+	 * skip both the buffer being flipped to and the one still on screen:
+	 */
+	for (i = 1; i <= ARRAY_SIZE(prime.buffers) && !dst; i++) {
+		uint32_t n = (prime.last + i) % ARRAY_SIZE(prime.buffers);
+
+		if (!prime.buffers[n].busy) {
+			dst = &prime.buffers[n];
+			prime.last = n;
+		}
+	}
+	assert(dst);
+
+	bo = gbm_surface_lock_front_buffer(gbm.surface);
+	if (!bo) {
+		printf("Failed to lock frontbuffer\n");
+		return EGL_NO_SYNC_KHR;
+	}
+
+	eglMakeCurrent(egl->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+				   prime.context);
+
+	src = prime_get_source(egl, bo);
+	if (src) {
+		glBindFramebuffer(GL_FRAMEBUFFER, dst->framebuffer);
+		glBindTexture(GL_TEXTURE_2D, src->texture);
+		gpu_timer_begin(&prime.timer, egl);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		gpu_timer_end(&prime.timer, egl);
+
+		if (sync_type && egl->eglCreateSyncKHR)
+			fence = egl->eglCreateSyncKHR(egl->display, sync_type, NULL);
+		glFlush();
+
+		prime.next = dst;
+	}
+
+	eglMakeCurrent(egl->display, egl->surface, egl->surface, egl->context);
+
+	/* Commands are ordered on the render device, so the buffer can go
+	 * back to the surface as soon as the copy is queued:
+	 */
+	gbm_surface_release_buffer(gbm.surface, bo);
+
+	prime.submit_ns += get_time_ns() - start;
+
+	return fence;
+}
+
+static void prime_report(void)
+{
+	char gpu[32] = "n/a", wait[32] = "";
+
+	if (++prime.frames % 120)
+		return;
+
+	/* the copy's own cost is its GPU time, submit is CPU queueing: */
+	if (prime.timer.samples)
+		snprintf(gpu, sizeof(gpu), "%.3f ms",
+				 (double)prime.timer.total_ns / prime.timer.samples / 1000000.0);
+	if (prime.waits)
+		snprintf(wait, sizeof(wait), ", %.3f ms CPU wait",
+				 (double)prime.wait_ns / prime.frames / 1000000.0);
+
+	printf("PRIME copy: %s GPU, %.3f ms CPU submit%s per frame\n", gpu,
+		   (double)prime.submit_ns / prime.frames / 1000000.0, wait);
+}
+
 #ifdef HAVE_ALLOCATOR
-static const struct allocator * init_allocator(int dev_fd, int drm_fd, int w, int h)
+#define ALIGN(v, a) (((v) + (a) - 1) / (a) * (a))
+
+static bool capability_set_is_linear(const capability_set_t *set)
+{
+	uint32_t i;
+
+	for (i = 0; i < set->num_capabilities; i++) {
+		const capability_header_t *cap = set->capabilities[i];
+
+		if (cap->common.vendor == VENDOR_BASE &&
+			cap->common.name == CAP_BASE_PITCH_LINEAR)
+			return true;
+	}
+
+	return false;
+}
+
+static uint32_t capability_set_pitch_alignment(const capability_set_t *set)
+{
+	uint32_t i;
+
+	for (i = 0; i < set->num_constraints; i++) {
+		if (set->constraints[i].name == CONSTRAINT_PITCH_ALIGNMENT &&
+			set->constraints[i].u.pitch_alignment.value)
+			return set->constraints[i].u.pitch_alignment.value;
+	}
+
+	return 1;
+}
+
+/*
+ * Higher is better.  Every set returned by the allocator satisfies all of
+ * the requested usages, so the ranking only expresses preference: tiled
+ * layouts over pitch-linear, then the set carrying the most vendor
+ * capabilities (tiling, compression, ...), then the least pitch padding.
+ */
+static int64_t rank_capability_set(const capability_set_t *set)
+{
+	int64_t score = 0;
+	uint32_t i;
+
+	if (!capability_set_is_linear(set))
+		score += 1 << 24;
+
+	for (i = 0; i < set->num_capabilities; i++) {
+		if (set->capabilities[i]->common.vendor != VENDOR_BASE)
+			score += 1 << 16;
+	}
+
+	score -= capability_set_pitch_alignment(set) & 0xffff;
+
+	return score;
+}
+
+/*
+ * The allocation metadata is opaque to us, but the capability set it was
+ * allocated from tells us what KMS needs to know.  Pitch-linear maps
+ * directly to a modifier; vendor tiled layouts have no generic mapping, so
+ * leave those to the kernel driver's implicit layout unless the user
+ * hardcoded a modifier.
+ */
+static uint64_t capability_set_to_modifier(const capability_set_t *set,
+										   uint64_t modifier)
+{
+	if (modifier != DRM_FORMAT_MOD_INVALID)
+		return modifier;
+
+	if (capability_set_is_linear(set))
+		return DRM_FORMAT_MOD_LINEAR;
+
+	return DRM_FORMAT_MOD_INVALID;
+}
+
+static void destroy_allocations(int drm_fd)
+{
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(allocator.allocations); i++) {
+		struct allocation *alloc = &allocator.allocations[i];
+
+		if (alloc->fb)
+			drm_fb_destroy(drm_fd, alloc->fb);
+
+		if (alloc->alloc)
+			device_destroy_allocation(allocator.dev, alloc->alloc);
+	}
+
+	memset(allocator.allocations, 0, sizeof(allocator.allocations));
+}
+
+static int create_allocations(int drm_fd, const assertion_t *assertion,
+							  const capability_set_t *set, uint64_t modifier)
+{
+	uint32_t allocs;
+
+	allocator.modifier = capability_set_to_modifier(set, modifier);
+	allocator.tiling = capability_set_is_linear(set) ?
+		GL_LINEAR_TILING_EXT : GL_OPTIMAL_TILING_EXT;
+	allocator.stride = ALIGN(assertion->width * 4,
+							 capability_set_pitch_alignment(set));
+
+	memset(allocator.allocations, 0, sizeof(allocator.allocations));
+	for (allocs = 0; allocs < ARRAY_SIZE(allocator.allocations); allocs++) {
+		struct allocation *alloc = &allocator.allocations[allocs];
+		struct drm_gem_close closeParams;
+		uint64_t allocation_size;
+		void *metadata;
+		size_t metadata_size;
+		int fd, res;
+		uint32_t gemHandle;
+
+		if (device_create_allocation(allocator.dev,
+									 assertion,
+									 set,
+									 &alloc->alloc)) {
+			printf("Failed to create an allocation\n");
+			goto fail;
+		}
+
+		if (device_export_allocation(allocator.dev,
+									 alloc->alloc,
+									 &allocation_size,
+									 &metadata_size,
+									 &metadata,
+									 &fd)) {
+			printf("Failed to export an allocation\n");
+			goto fail;
+		}
+
+		/* Never describe more memory to KMS than was allocated, and
+		 * every allocation has to share the set's pitch:
+		 */
+		if ((uint64_t)allocator.stride * assertion->height > allocation_size) {
+			printf("Allocation of %" PRIu64 " bytes is too small for "
+				   "stride %u\n", allocation_size, allocator.stride);
+			close(fd);
+			free(metadata);
+			goto fail;
+		}
+		alloc->stride = allocator.stride;
+
+		res = drmPrimeFDToHandle(drm_fd,
+								 fd,
+								 &gemHandle);
+
+		close(fd);
+		free(metadata);
+
+		if (res) {
+			goto fail;
+		}
+
+		alloc->fb = drm_fb_get_from_gem(drm_fd,
+										gemHandle,
+										assertion->width,
+										assertion->height,
+										alloc->stride,
+										allocator.modifier);
+
+		memset(&closeParams, 0, sizeof(closeParams));
+		closeParams.handle = gemHandle;
+		drmIoctl(drm_fd, DRM_IOCTL_GEM_CLOSE, &closeParams);
+
+		if (!alloc->fb) {
+			goto fail;
+		}
+	}
+
+	return 0;
+
+fail:
+	destroy_allocations(drm_fd);
+	return -1;
+}
+
+static const struct allocator * init_allocator(int dev_fd, int drm_fd,
+											   int w, int h, uint64_t modifier)
 {
 	assertion_t assertion = {
 		w,			/* width */
@@ -123,8 +635,8 @@ static const struct allocator * init_allocator(int dev_fd, int drm_fd, int w, in
 
 	capability_set_t *capability_sets;
 	uint32_t num_capability_sets;
-	uint32_t i;
-	uint32_t allocs = 0;
+	uint32_t *order = NULL;
+	uint32_t i, j;
 
 	allocator.dev = device_create(dev_fd);
 
@@ -147,59 +659,40 @@ static const struct allocator * init_allocator(int dev_fd, int drm_fd, int w, in
 		goto fail;
 	}
 
-	memset(allocator.allocations, 0, sizeof(allocator.allocations));
-	for (; allocs < ARRAY_SIZE(allocator.allocations); allocs++) {
-		struct allocation *alloc = &allocator.allocations[allocs];
-		struct drm_gem_close closeParams;
-		uint64_t allocation_size;
-		void *metadata;
-		size_t metadata_size;
-		int fd, res;
-		uint32_t gemHandle;
-
-		if (device_create_allocation(allocator.dev,
-									 &assertion,
-									 &capability_sets[0],
-									 &alloc->alloc)) {
-			printf("Failed to create an allocation\n");
-			goto fail;
-		}
+	/* Sort the capability sets best-first (insertion sort, there are
+	 * only ever a handful of them):
+	 */
+	order = calloc(num_capability_sets, sizeof(*order));
+	if (!order)
+		goto fail;
 
-		if (device_export_allocation(allocator.dev,
-									 alloc->alloc,
-									 &allocation_size,
-									 &metadata_size,
-									 &metadata,
-									 &fd)) {
-			printf("Failed to export an allocation\n");
-			goto fail;
-		}
+	for (i = 0; i < num_capability_sets; i++) {
+		int64_t score = rank_capability_set(&capability_sets[i]);
 
-		res = drmPrimeFDToHandle(drm_fd,
-								 fd,
-								 &gemHandle);
+		for (j = i; j > 0 &&
+			 rank_capability_set(&capability_sets[order[j - 1]]) < score; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
 
-		close(fd);
+	/* Fall back to the next best set if KMS rejects a layout: */
+	for (i = 0; i < num_capability_sets; i++) {
+		const capability_set_t *set = &capability_sets[order[i]];
 
-		if (res) {
-			free(metadata);
-			goto fail;
+		if (create_allocations(drm_fd, &assertion, set, modifier) == 0) {
+			printf("Using allocator capability set %u of %u (%s, stride %u)\n",
+				   order[i], num_capability_sets,
+				   capability_set_is_linear(set) ? "linear" : "tiled",
+				   allocator.stride);
+			break;
 		}
+	}
 
-		alloc->fb = drm_fb_get_from_gem(drm_fd,
-										gemHandle,
-										w, h,
-										metadata_size,
-										metadata);
-
-		memset(&closeParams, 0, sizeof(closeParams));
-		closeParams.handle = gemHandle;
-		drmIoctl(drm_fd, DRM_IOCTL_GEM_CLOSE, &closeParams);
-		free(metadata);
+	free(order);
 
-		if (!alloc->fb) {
-			goto fail;
-		}
+	if (i == num_capability_sets) {
+		printf("No capability set could be allocated and scanned out\n");
+		goto fail;
 	}
 
 	allocator.next_allocation = 0;
@@ -207,19 +700,6 @@ static const struct allocator * init_allocator(int dev_fd, int drm_fd, int w, in
 	return &allocator;
 
 fail:
-	if (allocator.dev) {
-		for (i = 0; i <= allocs; i++) {
-			struct allocation *alloc = &allocator.allocations[i];
-
-			if (alloc->fb) {
-				drm_fb_destroy(drm_fd, alloc->fb);
-			}
-
-			device_destroy_allocation(allocator.dev,
-									  alloc->alloc);
-		}
-	}
-
 	device_destroy(allocator.dev);
 	allocator.dev = NULL;
 
@@ -230,32 +710,79 @@ fail:
 const struct surfmgr * init_surfmgr(int dev_fd, int drm_fd,
 									int w, int h, uint64_t modifier)
 {
+	surfmgr.fd = dev_fd;
 	surfmgr.width = w;
 	surfmgr.height = h;
 
 #ifdef HAVE_ALLOCATOR
-	surfmgr.allocator = init_allocator(dev_fd, drm_fd, w, h);
+	surfmgr.allocator = init_allocator(dev_fd, drm_fd, w, h, modifier);
 
 	if (surfmgr.allocator)
 		return &surfmgr;
-#else
-	(void)dev_fd;
 #endif
 
-	surfmgr.gbm = init_gbm(drm_fd, w, h, modifier);
+	/* A render node or a second open of the display device is still the
+	 * same GPU, which can scan out of what it renders without a copy:
+	 */
+	if (dev_fd != drm_fd && drm_same_device(dev_fd, drm_fd)) {
+		printf("Surface manager device is the display device, no PRIME offload\n");
+		dev_fd = surfmgr.fd = drm_fd;
+	}
 
-	if (surfmgr.gbm)
-		return &surfmgr;
+	if (dev_fd != drm_fd) {
+		/* Render on dev_fd, scan out of linear copies on drm_fd: */
+		surfmgr.gbm = init_gbm(dev_fd, w, h, modifier, true);
+
+		if (surfmgr.gbm && init_prime_buffers(drm_fd, w, h) == 0) {
+			printf("Using PRIME offload to the display device\n");
+			surfmgr.prime = &prime;
+			return &surfmgr;
+		}
+
+		surfmgr.gbm = NULL;
+	} else {
+		surfmgr.gbm = init_gbm(drm_fd, w, h, modifier, false);
+
+		if (surfmgr.gbm)
+			return &surfmgr;
+	}
 
 	/* Initialization failed. */
+	surfmgr.fd = -1;
 	surfmgr.width = 0;
 	surfmgr.height = 0;
 
 	return NULL;
 }
 
+const struct surfmgr * init_surfmgr_dumb(int drm_fd, int w, int h)
+{
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(dumb.buffers); i++) {
+		dumb.buffers[i] = drm_dumb_create(drm_fd, w, h);
+		if (!dumb.buffers[i]) {
+			printf("failed to create dumb buffer\n");
+			return NULL;
+		}
+	}
+
+	dumb.back = 0;
+	dumb.next = -1;
+
+	surfmgr.fd = drm_fd;
+	surfmgr.width = w;
+	surfmgr.height = h;
+	surfmgr.dumb = &dumb;
+
+	return &surfmgr;
+}
+
 int init_surfmgr_egl(const struct surfmgr *surfmgr, const struct egl *egl)
 {
+	if (surfmgr->prime)
+		return init_prime_egl(surfmgr, egl);
+
 #ifdef HAVE_ALLOCATOR
 	if (surfmgr->allocator) {
 		uint32_t i;
@@ -293,7 +820,7 @@ int init_surfmgr_egl(const struct surfmgr *surfmgr, const struct egl *egl)
                           alloc->texture);
 			glTexParameteri(GL_TEXTURE_2D,
 							GL_TEXTURE_TILING_EXT,
-							GL_OPTIMAL_TILING_EXT);
+							surfmgr->allocator->tiling);
 			egl->glTexParametervNVX(GL_TEXTURE_2D,
 									GL_SURFACE_METADATA_NVX,
 									metadata_size,
@@ -323,11 +850,37 @@ int init_surfmgr_egl(const struct surfmgr *surfmgr, const struct egl *egl)
 	return 0;
 }
 
+struct gbm_surface * surfmgr_create_surface(const struct surfmgr *surfmgr,
+											int w, int h, uint32_t format)
+{
+	struct gbm_surface *surface;
+
+	if (!surfmgr->gbm || surfmgr->prime) {
+		printf("additional surfaces need GBM on the display device\n");
+		return NULL;
+	}
+
+	surface = create_scanout_surface(w, h, format, gbm_modifier);
+	if (!surface)
+		printf("failed to create gbm surface\n");
+
+	return surface;
+}
+
 struct drm_fb *surfmgr_get_next_fb(const struct surfmgr *surfmgr)
 {
 	struct drm_fb *fb = NULL;
 
-	if (surfmgr->gbm) {
+	if (surfmgr->prime) {
+		if (!prime.next) {
+			printf("No PRIME buffer was copied\n");
+			return NULL;
+		}
+
+		prime.next->busy = 1;
+		fb = prime.next->fb;
+		prime.next = NULL;
+	} else if (surfmgr->gbm) {
 		struct gbm_bo *bo;
 
 		bo = gbm_surface_lock_front_buffer(surfmgr->gbm->surface);
@@ -338,6 +891,15 @@ struct drm_fb *surfmgr_get_next_fb(const struct surfmgr *surfmgr)
 		}
 
 		fb = drm_fb_get_from_bo(bo);
+	} else if (surfmgr->dumb) {
+		if (dumb.next < 0) {
+			printf("No dumb buffer was drawn\n");
+			return NULL;
+		}
+
+		dumb.busy[dumb.next] = 1;
+		fb = dumb.buffers[dumb.next]->fb;
+		dumb.next = -1;
 	}
 #ifdef HAVE_ALLOCATOR
 	else if (surfmgr->allocator) {
@@ -353,8 +915,25 @@ struct drm_fb *surfmgr_get_next_fb(const struct surfmgr *surfmgr)
 
 void surfmgr_release_fb(const struct surfmgr *surfmgr, struct drm_fb *fb)
 {
-	if (surfmgr->gbm) {
+	if (!fb)
+		return;
+
+	if (surfmgr->prime) {
+		uint32_t i;
+
+		for (i = 0; i < ARRAY_SIZE(prime.buffers); i++) {
+			if (prime.buffers[i].fb == fb)
+				prime.buffers[i].busy = 0;
+		}
+	} else if (surfmgr->gbm) {
 		gbm_surface_release_buffer(surfmgr->gbm->surface, fb->bo);
+	} else if (surfmgr->dumb) {
+		uint32_t i;
+
+		for (i = 0; i < ARRAY_SIZE(dumb.buffers); i++) {
+			if (dumb.buffers[i]->fb == fb)
+				dumb.busy[i] = 0;
+		}
 	}
 #ifdef HAVE_ALLOCATOR
 	else if (surfmgr->allocator) {
@@ -363,16 +942,84 @@ void surfmgr_release_fb(const struct surfmgr *surfmgr, struct drm_fb *fb)
 #endif
 }
 
+struct drm_dumb *surfmgr_get_dumb_back(const struct surfmgr *surfmgr)
+{
+	return surfmgr->dumb->buffers[surfmgr->dumb->back];
+}
+
 void surfmgr_end_frame(const struct surfmgr *surfmgr,
 					   const struct egl *egl,
 					   int *fence_fd)
 {
-	/* insert fence to be signaled in cmdstream.. this fence will be
-	 * signaled when gpu rendering done
-	 */
-	EGLSyncKHR gpu_fence = create_fence(egl, EGL_NO_NATIVE_FENCE_FD_ANDROID);
+	EGLSyncKHR gpu_fence = EGL_NO_SYNC_KHR;
+
+	PROBE2(end_frame, surfmgr->prime != NULL, fence_fd != NULL);
+
+	if (surfmgr->dumb) {
+		uint32_t i, n = dumb.back;
+
+		/* the CPU is done with it by now, so there's nothing to
+		 * fence; draw next into one neither on screen nor queued:
+		 */
+		dumb.next = dumb.back;
+		for (i = 1; i < ARRAY_SIZE(dumb.buffers); i++) {
+			n = (dumb.back + i) % ARRAY_SIZE(dumb.buffers);
+			if (!dumb.busy[n])
+				break;
+		}
+		assert(n != dumb.back && !dumb.busy[n]);
+		dumb.back = n;
 
-	if (surfmgr->gbm) {
+		if (fence_fd)
+			*fence_fd = -1;
+		return;
+	}
+
+	if (surfmgr->prime) {
+		eglSwapBuffers(egl->display, egl->surface);
+
+		trace_begin("prime copy");
+		if (!fence_fd)
+			gpu_fence = prime_blit(egl, EGL_SYNC_FENCE_KHR);
+		else if (egl->eglDupNativeFenceFDANDROID)
+			gpu_fence = prime_blit(egl, EGL_SYNC_NATIVE_FENCE_ANDROID);
+		else
+			gpu_fence = prime_blit(egl, 0);
+		trace_end("prime copy");
+
+		if (!fence_fd) {
+			/* There is no implicit synchronization across devices,
+			 * so the copy has to land before the flip is queued:
+			 */
+			int64_t start = get_time_ns();
+
+			trace_begin("prime fence wait");
+			if (gpu_fence) {
+				egl->eglClientWaitSyncKHR(egl->display, gpu_fence,
+						EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+				egl->eglDestroySyncKHR(egl->display, gpu_fence);
+			} else {
+				glFinish();
+			}
+			trace_end("prime fence wait");
+
+			prime.wait_ns += get_time_ns() - start;
+			prime.waits = true;
+			prime_report();
+			return;
+		}
+
+		prime_report();
+	} else if (fence_fd) {
+		/* insert fence to be signaled in cmdstream.. this fence will be
+		 * signaled when gpu rendering done
+		 */
+		gpu_fence = create_fence(egl, EGL_NO_NATIVE_FENCE_FD_ANDROID);
+	}
+
+	if (surfmgr->prime) {
+		/* already swapped and copied above */
+	} else if (surfmgr->gbm) {
 		eglSwapBuffers(egl->display, egl->surface);
 	}
 #ifdef HAVE_ALLOCATOR
@@ -386,6 +1033,10 @@ void surfmgr_end_frame(const struct surfmgr *surfmgr,
 	}
 #endif
 
+	/* legacy page flips rely on implicit synchronization: */
+	if (!fence_fd)
+		return;
+
 	if (gpu_fence) {
 		/* after swapbuffers, gpu_fence should be flushed, so safe
 		 * to get fd:
@@ -397,4 +1048,6 @@ void surfmgr_end_frame(const struct surfmgr *surfmgr,
 		glFinish();
 		*fence_fd = -1;
 	}
+
+	PROBE1(end_frame_fence, *fence_fd);
 }
@@ -26,9 +26,16 @@
 
 const struct surfmgr * init_surfmgr(int dev_fd, int drm_fd,
 									int w, int h, uint64_t modifier);
+const struct surfmgr * init_surfmgr_dumb(int drm_fd, int w, int h);
 int init_surfmgr_egl(const struct surfmgr *surfmgr, const struct egl *egl);
+/* another swapchain on the device of the GBM surface manager, same
+ * modifiers, for driving a further output or plane:
+ */
+struct gbm_surface * surfmgr_create_surface(const struct surfmgr *surfmgr,
+											int w, int h, uint32_t format);
 struct drm_fb *surfmgr_get_next_fb(const struct surfmgr *surfmgr);
 void surfmgr_release_fb(const struct surfmgr *surfmgr, struct drm_fb *fb);
+struct drm_dumb *surfmgr_get_dumb_back(const struct surfmgr *surfmgr);
 void surfmgr_end_frame(const struct surfmgr *surfmgr,
 					   const struct egl *egl,
 					   int *fence_fd);
@@ -0,0 +1,544 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "drm-common.h"
+#include "swrender.h"
+#include "threadpool.h"
+
+/* Four pixels of a row.  GCC vector extensions rather than intrinsics, so
+ * the same code compiles to SSE, NEON, ... (or plain scalar code):
+ */
+typedef float vec4f __attribute__((vector_size(16)));
+typedef int32_t vec4i __attribute__((vector_size(16)));
+
+/* interpolated divided by w, for perspective correction: */
+enum {
+	VARYING_R,
+	VARYING_G,
+	VARYING_B,
+	VARYING_U,
+	VARYING_V,
+	NUM_VARYINGS,
+};
+
+/* a * x + b * y + c, over window coordinates: */
+struct sw_plane {
+	float a, b, c;
+};
+
+struct sw_triangle {
+	struct sw_plane edge[3];   /* barycentric coordinates */
+	struct sw_plane q;         /* 1 / w */
+	struct sw_plane varying[NUM_VARYINGS];
+	int x0, y0, x1, y1;     /* bounding box, x1/y1 exclusive */
+};
+
+struct swrender {
+	unsigned width, height;
+	unsigned tiles_x, tiles_y;
+	struct threadpool *pool;
+
+	const uint32_t *texels;
+	unsigned tex_width, tex_height;
+	int tex_shift[3];       /* of red, green and blue in a texel */
+
+	/* the frame being recorded: */
+	uint32_t clear;
+	struct sw_triangle *triangles;
+	unsigned num_triangles, max_triangles;
+	int64_t start;
+
+	/* tile t draws triangles bin[bin_start[t] .. bin_start[t + 1]): */
+	unsigned *bin_start, *bin_next;
+	unsigned *bin, max_bin;
+
+	struct drm_dumb *target;
+
+	/* stats, for the periodic report: */
+	unsigned frames;
+	uint64_t triangles_drawn;
+	int64_t setup_ns, raster_ns;
+};
+
+static inline vec4f splatf(float f)
+{
+	return (vec4f){ f, f, f, f };
+}
+
+static inline vec4i splati(int32_t i)
+{
+	return (vec4i){ i, i, i, i };
+}
+
+static inline vec4f selectf(vec4i mask, vec4f a, vec4f b)
+{
+	return (vec4f)(((vec4i)a & mask) | ((vec4i)b & ~mask));
+}
+
+/* NaN (from lanes outside the triangle) compares false, so clamps to b: */
+static inline vec4f maxf(vec4f a, vec4f b)
+{
+	return selectf(a > b, a, b);
+}
+
+static inline vec4f minf(vec4f a, vec4f b)
+{
+	return selectf(a < b, a, b);
+}
+
+static inline vec4i clampi(vec4i v, int32_t lo, int32_t hi)
+{
+	vec4i mask;
+
+	mask = v > splati(lo);
+	v = (v & mask) | (splati(lo) & ~mask);
+	mask = v < splati(hi);
+	return (v & mask) | (splati(hi) & ~mask);
+}
+
+static inline bool any(vec4i mask)
+{
+	return (mask[0] | mask[1] | mask[2] | mask[3]) != 0;
+}
+
+static inline vec4f plane_eval(const struct sw_plane *p, vec4f x, float y)
+{
+	return splatf(p->a) * x + splatf(p->b * y + p->c);
+}
+
+static void plane_interpolate(struct sw_plane *p, const struct sw_plane edge[3],
+							  const float f[3])
+{
+	p->a = f[0] * edge[0].a + f[1] * edge[1].a + f[2] * edge[2].a;
+	p->b = f[0] * edge[0].b + f[1] * edge[1].b + f[2] * edge[2].b;
+	p->c = f[0] * edge[0].c + f[1] * edge[1].c + f[2] * edge[2].c;
+}
+
+static bool setup_triangle(const struct swrender *sw, struct sw_triangle *tri,
+						   const struct sw_vertex *v[3])
+{
+	float x[3], y[3], q[3], area;
+	float minx, miny, maxx, maxy;
+	unsigned i, j;
+
+	for (i = 0; i < 3; i++) {
+		if (!(v[i]->w > 0.0f))
+			return false;
+
+		/* viewport transform, with y pointing down as in the buffer: */
+		q[i] = 1.0f / v[i]->w;
+		x[i] = (v[i]->x * q[i] + 1.0f) * 0.5f * sw->width;
+		y[i] = (1.0f - v[i]->y * q[i]) * 0.5f * sw->height;
+	}
+
+	/* counter-clockwise with y up is clockwise here, negative area;
+	 * this also drops degenerate and NaN triangles:
+	 */
+	area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area < 0.0f))
+		return false;
+
+	minx = fmaxf(fminf(x[0], fminf(x[1], x[2])), 0.0f);
+	miny = fmaxf(fminf(y[0], fminf(y[1], y[2])), 0.0f);
+	maxx = fminf(fmaxf(x[0], fmaxf(x[1], x[2])), sw->width);
+	maxy = fminf(fmaxf(y[0], fmaxf(y[1], y[2])), sw->height);
+	if (minx >= maxx || miny >= maxy)
+		return false;
+
+	tri->x0 = floorf(minx);
+	tri->y0 = floorf(miny);
+	tri->x1 = ceilf(maxx);
+	tri->y1 = ceilf(maxy);
+
+	/* edge functions scaled by the area, which makes them barycentric
+	 * coordinates, positive inside:
+	 */
+	for (i = 0; i < 3; i++) {
+		unsigned a = (i + 1) % 3, b = (i + 2) % 3;
+
+		tri->edge[i].a = (y[a] - y[b]) / area;
+		tri->edge[i].b = (x[b] - x[a]) / area;
+		tri->edge[i].c = (x[a] * y[b] - y[a] * x[b]) / area;
+	}
+
+	plane_interpolate(&tri->q, tri->edge, q);
+
+	for (j = 0; j < NUM_VARYINGS; j++) {
+		float f[3];
+
+		for (i = 0; i < 3; i++) {
+			const float varyings[NUM_VARYINGS] = {
+				v[i]->r, v[i]->g, v[i]->b, v[i]->u, v[i]->v,
+			};
+			f[i] = varyings[j] * q[i];
+		}
+		plane_interpolate(&tri->varying[j], tri->edge, f);
+	}
+
+	return true;
+}
+
+static inline vec4i fetch(const struct swrender *sw, vec4i x, vec4i y)
+{
+	vec4i texel;
+	int i;
+
+	/* no gather on most SIMD ISAs: */
+	for (i = 0; i < 4; i++)
+		texel[i] = sw->texels[y[i] * sw->tex_width + x[i]];
+
+	return texel;
+}
+
+static inline vec4f channel(vec4i texel, int shift)
+{
+	return __builtin_convertvector((texel >> shift) & splati(0xff), vec4f);
+}
+
+static inline vec4f lerp(vec4f a, vec4f b, vec4f t)
+{
+	return a + (b - a) * t;
+}
+
+/* bilinear, clamp to edge, channels in [0, 1]: */
+static void sample(const struct swrender *sw, vec4f u, vec4f v,
+				   vec4f rgb[3])
+{
+	vec4f fx = maxf(u * splatf(sw->tex_width) - splatf(0.5f), splatf(0.0f));
+	vec4f fy = maxf(v * splatf(sw->tex_height) - splatf(0.5f), splatf(0.0f));
+	vec4i x0 = clampi(__builtin_convertvector(fx, vec4i), 0, sw->tex_width - 1);
+	vec4i y0 = clampi(__builtin_convertvector(fy, vec4i), 0, sw->tex_height - 1);
+	vec4i x1 = clampi(x0 + splati(1), 0, sw->tex_width - 1);
+	vec4i y1 = clampi(y0 + splati(1), 0, sw->tex_height - 1);
+	vec4f ax = minf(fx - __builtin_convertvector(x0, vec4f), splatf(1.0f));
+	vec4f ay = minf(fy - __builtin_convertvector(y0, vec4f), splatf(1.0f));
+	vec4i t00 = fetch(sw, x0, y0), t01 = fetch(sw, x1, y0);
+	vec4i t10 = fetch(sw, x0, y1), t11 = fetch(sw, x1, y1);
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		int shift = sw->tex_shift[i];
+		vec4f top = lerp(channel(t00, shift), channel(t01, shift), ax);
+		vec4f bottom = lerp(channel(t10, shift), channel(t11, shift), ax);
+
+		rgb[i] = lerp(top, bottom, ay) * splatf(1.0f / 255.0f);
+	}
+}
+
+static inline vec4i unorm8(vec4f v)
+{
+	v = minf(maxf(v, splatf(0.0f)), splatf(1.0f));
+	return __builtin_convertvector(v * splatf(255.0f) + splatf(0.5f), vec4i);
+}
+
+static void shade(const struct swrender *sw, uint32_t *dst, vec4i mask,
+				  vec4f q, const vec4f varying[NUM_VARYINGS])
+{
+	vec4f w = splatf(1.0f) / q;
+	vec4f r = varying[VARYING_R] * w;
+	vec4f g = varying[VARYING_G] * w;
+	vec4f b = varying[VARYING_B] * w;
+	vec4i pixel, old;
+
+	if (sw->texels) {
+		vec4f texel[3];
+
+		sample(sw, varying[VARYING_U] * w, varying[VARYING_V] * w, texel);
+		r *= texel[0];
+		g *= texel[1];
+		b *= texel[2];
+	}
+
+	pixel = unorm8(r) << 16 | unorm8(g) << 8 | unorm8(b);
+
+	memcpy(&old, dst, sizeof(old));
+	pixel = (pixel & mask) | (old & ~mask);
+	memcpy(dst, &pixel, sizeof(pixel));
+}
+
+/* draw the part of tri inside the tile at tx, ty into color: */
+static void raster_triangle(const struct swrender *sw,
+							const struct sw_triangle *tri, uint32_t *color,
+							int tx, int ty, int tw, int th)
+{
+	const vec4f lanes = { 0.5f, 1.5f, 2.5f, 3.5f };
+	const vec4f zero = splatf(0.0f);
+	/* tiles are a multiple of 4 wide, so this never leaves the tile: */
+	int x0 = (tri->x0 > tx ? tri->x0 - tx : 0) & ~3;
+	int x1 = tri->x1 - tx < tw ? tri->x1 - tx : tw;
+	int y0 = tri->y0 > ty ? tri->y0 - ty : 0;
+	int y1 = tri->y1 - ty < th ? tri->y1 - ty : th;
+	vec4f edge_step[3], q_step, varying_step[NUM_VARYINGS];
+	vec4i top_left[3];
+	int x, y, i;
+
+	/* pixel centers exactly on an edge belong to the triangle on its
+	 * right, or below if horizontal, so shared edges are drawn once:
+	 */
+	for (i = 0; i < 3; i++) {
+		const struct sw_plane *e = &tri->edge[i];
+
+		top_left[i] = splati(e->a > 0.0f || (e->a == 0.0f && e->b > 0.0f) ? -1 : 0);
+		edge_step[i] = splatf(4.0f * e->a);
+	}
+	q_step = splatf(4.0f * tri->q.a);
+	for (i = 0; i < NUM_VARYINGS; i++)
+		varying_step[i] = splatf(4.0f * tri->varying[i].a);
+
+	for (y = y0; y < y1; y++) {
+		uint32_t *row = &color[y * SW_TILE_SIZE];
+		vec4f px = splatf(tx + x0) + lanes;
+		float py = ty + y + 0.5f;
+		vec4f edge[3], q, varying[NUM_VARYINGS];
+
+		for (i = 0; i < 3; i++)
+			edge[i] = plane_eval(&tri->edge[i], px, py);
+		q = plane_eval(&tri->q, px, py);
+		for (i = 0; i < NUM_VARYINGS; i++)
+			varying[i] = plane_eval(&tri->varying[i], px, py);
+
+		for (x = x0; x < x1; x += 4) {
+			vec4i inside = splati(-1);
+
+			for (i = 0; i < 3; i++)
+				inside &= (edge[i] > zero) |
+						  ((edge[i] == zero) & top_left[i]);
+
+			if (any(inside))
+				shade(sw, &row[x], inside, q, varying);
+
+			for (i = 0; i < 3; i++)
+				edge[i] += edge_step[i];
+			q += q_step;
+			for (i = 0; i < NUM_VARYINGS; i++)
+				varying[i] += varying_step[i];
+		}
+	}
+}
+
+static void raster_tiles(void *arg, unsigned start, unsigned end)
+{
+	const struct swrender *sw = arg;
+	const struct drm_dumb *target = sw->target;
+	uint32_t color[SW_TILE_SIZE * SW_TILE_SIZE] __attribute__((aligned(16)));
+	unsigned t, n, y;
+
+	for (t = start; t < end; t++) {
+		unsigned tx = t % sw->tiles_x * SW_TILE_SIZE;
+		unsigned ty = t / sw->tiles_x * SW_TILE_SIZE;
+		unsigned tw = sw->width - tx < SW_TILE_SIZE ? sw->width - tx : SW_TILE_SIZE;
+		unsigned th = sw->height - ty < SW_TILE_SIZE ? sw->height - ty : SW_TILE_SIZE;
+
+		for (n = 0; n < th * SW_TILE_SIZE; n++)
+			color[n] = sw->clear;
+
+		for (n = sw->bin_start[t]; n < sw->bin_start[t + 1]; n++)
+			raster_triangle(sw, &sw->triangles[sw->bin[n]], color,
+							tx, ty, tw, th);
+
+		/* whole rows, the scanout buffer is write-combined: */
+		for (y = 0; y < th; y++)
+			memcpy(target->map + (ty + y) * target->pitch + tx * 4,
+				   &color[y * SW_TILE_SIZE], tw * 4);
+	}
+}
+
+static int bin_triangles(struct swrender *sw)
+{
+	unsigned num_tiles = sw->tiles_x * sw->tiles_y;
+	unsigned i, t;
+	int x, y;
+
+	/* count the triangles in each tile's bounding box overlap: */
+	memset(sw->bin_next, 0, num_tiles * sizeof(*sw->bin_next));
+	for (i = 0; i < sw->num_triangles; i++) {
+		const struct sw_triangle *tri = &sw->triangles[i];
+
+		for (y = tri->y0 / SW_TILE_SIZE; y <= (tri->y1 - 1) / SW_TILE_SIZE; y++)
+			for (x = tri->x0 / SW_TILE_SIZE; x <= (tri->x1 - 1) / SW_TILE_SIZE; x++)
+				sw->bin_next[y * sw->tiles_x + x]++;
+	}
+
+	sw->bin_start[0] = 0;
+	for (t = 0; t < num_tiles; t++) {
+		sw->bin_start[t + 1] = sw->bin_start[t] + sw->bin_next[t];
+		sw->bin_next[t] = sw->bin_start[t];
+	}
+
+	if (sw->bin_start[num_tiles] > sw->max_bin) {
+		unsigned max = sw->bin_start[num_tiles] * 2;
+		unsigned *bin = realloc(sw->bin, max * sizeof(*bin));
+
+		if (!bin)
+			return -1;
+		sw->bin = bin;
+		sw->max_bin = max;
+	}
+
+	/* in submission order within each tile: */
+	for (i = 0; i < sw->num_triangles; i++) {
+		const struct sw_triangle *tri = &sw->triangles[i];
+
+		for (y = tri->y0 / SW_TILE_SIZE; y <= (tri->y1 - 1) / SW_TILE_SIZE; y++)
+			for (x = tri->x0 / SW_TILE_SIZE; x <= (tri->x1 - 1) / SW_TILE_SIZE; x++)
+				sw->bin[sw->bin_next[y * sw->tiles_x + x]++] = i;
+	}
+
+	return 0;
+}
+
+static void report(struct swrender *sw)
+{
+	if (++sw->frames % 120)
+		return;
+
+	printf("software: %.3f ms setup, %.3f ms raster (%u threads) per frame, %"PRIu64" triangles\n",
+		   (double)sw->setup_ns / sw->frames / 1000000.0,
+		   (double)sw->raster_ns / sw->frames / 1000000.0,
+		   threadpool_size(sw->pool),
+		   sw->triangles_drawn / sw->frames);
+}
+
+struct swrender * swrender_create(unsigned width, unsigned height,
+								  unsigned threads)
+{
+	struct swrender *sw;
+
+	sw = calloc(1, sizeof(*sw));
+	if (!sw)
+		return NULL;
+
+	sw->width = width;
+	sw->height = height;
+	sw->tiles_x = (width + SW_TILE_SIZE - 1) / SW_TILE_SIZE;
+	sw->tiles_y = (height + SW_TILE_SIZE - 1) / SW_TILE_SIZE;
+	sw->bin_start = calloc(sw->tiles_x * sw->tiles_y + 1, sizeof(*sw->bin_start));
+	sw->bin_next = calloc(sw->tiles_x * sw->tiles_y, sizeof(*sw->bin_next));
+	sw->pool = threadpool_create(threads);
+
+	if (!sw->bin_start || !sw->bin_next || !sw->pool) {
+		swrender_destroy(sw);
+		return NULL;
+	}
+
+	return sw;
+}
+
+void swrender_destroy(struct swrender *sw)
+{
+	if (!sw)
+		return;
+
+	threadpool_destroy(sw->pool);
+	free(sw->bin);
+	free(sw->bin_next);
+	free(sw->bin_start);
+	free(sw->triangles);
+	free(sw);
+}
+
+unsigned swrender_threads(const struct swrender *sw)
+{
+	return threadpool_size(sw->pool);
+}
+
+void swrender_texture(struct swrender *sw, const uint32_t *texels,
+					  unsigned width, unsigned height, uint32_t format)
+{
+	bool xrgb = format == DRM_FORMAT_XRGB8888;
+
+	sw->texels = texels;
+	sw->tex_width = width;
+	sw->tex_height = height;
+	sw->tex_shift[0] = xrgb ? 16 : 0;
+	sw->tex_shift[1] = 8;
+	sw->tex_shift[2] = xrgb ? 0 : 16;
+}
+
+void swrender_begin(struct swrender *sw, uint32_t clear)
+{
+	sw->clear = clear;
+	sw->num_triangles = 0;
+	sw->start = get_time_ns();
+}
+
+void swrender_triangles(struct swrender *sw, const struct sw_vertex *vertices,
+						const uint16_t *indices, unsigned count)
+{
+	unsigned i;
+
+	for (i = 0; i + 2 < count; i += 3) {
+		const struct sw_vertex *v[3] = {
+			&vertices[indices[i]],
+			&vertices[indices[i + 1]],
+			&vertices[indices[i + 2]],
+		};
+
+		if (sw->num_triangles == sw->max_triangles) {
+			unsigned max = sw->max_triangles ? sw->max_triangles * 2 : 256;
+			struct sw_triangle *triangles;
+
+			triangles = realloc(sw->triangles, max * sizeof(*triangles));
+			if (!triangles) {
+				printf("failed to allocate %u triangles\n", max);
+				return;
+			}
+			sw->triangles = triangles;
+			sw->max_triangles = max;
+		}
+
+		if (setup_triangle(sw, &sw->triangles[sw->num_triangles], v))
+			sw->num_triangles++;
+	}
+}
+
+void swrender_end(struct swrender *sw, struct drm_dumb *target)
+{
+	int64_t start;
+
+	if (bin_triangles(sw)) {
+		printf("failed to bin %u triangles\n", sw->num_triangles);
+		sw->num_triangles = 0;
+		memset(sw->bin_start, 0, (sw->tiles_x * sw->tiles_y + 1) *
+			   sizeof(*sw->bin_start));
+	}
+
+	start = get_time_ns();
+	sw->setup_ns += start - sw->start;
+
+	sw->target = target;
+	threadpool_run(sw->pool, raster_tiles, sw, sw->tiles_x * sw->tiles_y);
+	sw->target = NULL;
+
+	sw->raster_ns += get_time_ns() - start;
+	sw->triangles_drawn += sw->num_triangles;
+	report(sw);
+}
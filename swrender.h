@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _SWRENDER_H
+#define _SWRENDER_H
+
+#include <stdint.h>
+
+/* A tile based software rasterizer, for rendering the cube scenes on the
+ * CPU straight into KMS dumb buffers.
+ *
+ * Triangles are set up and binned into SW_TILE_SIZE square tiles on the
+ * calling thread.  The tiles are then rasterized in parallel on a thread
+ * pool, each into a private color buffer that stays in cache, which is
+ * copied out to the (write-combined) scanout buffer in whole rows once
+ * the tile is done.  Edge functions, interpolation, shading and texture
+ * filtering each handle four pixels of a row at a time.
+ *
+ * Like the GL scenes there is no depth buffer: triangles are drawn in
+ * submission order with back faces culled.
+ */
+
+#define SW_TILE_SIZE 64
+
+/* output of the vertex stage: */
+struct sw_vertex {
+	float x, y, z, w;   /* clip space */
+	float r, g, b;      /* color, or lighting if textured */
+	float u, v;         /* texture coordinate */
+};
+
+struct swrender;
+struct drm_dumb;
+
+/* threads == 0 picks one thread per online CPU */
+struct swrender * swrender_create(unsigned width, unsigned height,
+								  unsigned threads);
+void swrender_destroy(struct swrender *sw);
+unsigned swrender_threads(const struct swrender *sw);
+
+/* Texture modulated by the vertex color, bilinear filtered with clamp to
+ * edge.  format is DRM_FORMAT_ABGR8888 or DRM_FORMAT_XRGB8888; texels
+ * NULL for untextured.
+ */
+void swrender_texture(struct swrender *sw, const uint32_t *texels,
+					  unsigned width, unsigned height, uint32_t format);
+
+/* clear is XRGB8888 */
+void swrender_begin(struct swrender *sw, uint32_t clear);
+/* indexed triangle list, counter-clockwise front faces.  Triangles with
+ * a vertex behind the eye are dropped rather than clipped.
+ */
+void swrender_triangles(struct swrender *sw, const struct sw_vertex *vertices,
+						const uint16_t *indices, unsigned count);
+void swrender_end(struct swrender *sw, struct drm_dumb *target);
+
+#endif /* _SWRENDER_H */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "threadpool.h"
+
+struct threadpool {
+	pthread_mutex_t lock;
+	pthread_cond_t work, done;
+	pthread_t *threads;
+	unsigned num_threads;   /* including the calling thread */
+	bool quit;
+
+	/* the current job: */
+	unsigned generation;
+	threadpool_fn fn;
+	void *arg;
+	unsigned count, chunk, next, pending;
+};
+
+/* grab and run chunks of the current job until there are none left,
+ * called with the lock held:
+ */
+static void run_chunks(struct threadpool *pool)
+{
+	while (pool->next < pool->count) {
+		unsigned start = pool->next;
+		unsigned end = start + pool->chunk;
+
+		if (end > pool->count)
+			end = pool->count;
+		pool->next = end;
+
+		pthread_mutex_unlock(&pool->lock);
+		pool->fn(pool->arg, start, end);
+		pthread_mutex_lock(&pool->lock);
+
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->done);
+	}
+}
+
+static void *worker(void *data)
+{
+	struct threadpool *pool = data;
+	unsigned generation = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->quit) {
+		if (generation == pool->generation) {
+			pthread_cond_wait(&pool->work, &pool->lock);
+			continue;
+		}
+		generation = pool->generation;
+		run_chunks(pool);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+struct threadpool * threadpool_create(unsigned threads)
+{
+	struct threadpool *pool;
+	unsigned i;
+
+	if (!threads) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = n > 0 ? n : 1;
+	}
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return NULL;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	pool->threads = calloc(threads, sizeof(*pool->threads));
+	if (!pool->threads) {
+		threadpool_destroy(pool);
+		return NULL;
+	}
+
+	/* the calling thread does its share of the work too: */
+	pool->num_threads = 1;
+	for (i = 1; i < threads; i++) {
+		if (pthread_create(&pool->threads[i], NULL, worker, pool)) {
+			printf("failed to create worker thread, using %u\n",
+				   pool->num_threads);
+			break;
+		}
+		pool->num_threads++;
+	}
+
+	return pool;
+}
+
+void threadpool_destroy(struct threadpool *pool)
+{
+	unsigned i;
+
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 1; i < pool->num_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool);
+}
+
+unsigned threadpool_size(const struct threadpool *pool)
+{
+	return pool->num_threads;
+}
+
+void threadpool_run(struct threadpool *pool, threadpool_fn fn, void *arg,
+					unsigned count)
+{
+	if (!count)
+		return;
+
+	/* not worth waking anyone up for: */
+	if (pool->num_threads == 1 || count == 1) {
+		fn(arg, 0, count);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+
+	/* a few chunks per thread, so one slow thread doesn't hold up the
+	 * rest of the frame:
+	 */
+	pool->fn = fn;
+	pool->arg = arg;
+	pool->count = count;
+	pool->next = 0;
+	pool->chunk = count / (pool->num_threads * 4);
+	if (pool->chunk == 0)
+		pool->chunk = 1;
+	pool->pending = (count + pool->chunk - 1) / pool->chunk;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->work);
+
+	run_chunks(pool);
+
+	while (pool->pending)
+		pthread_cond_wait(&pool->done, &pool->lock);
+
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+/* A minimal fork/join pool for splitting per-frame CPU work (transforms,
+ * software rendering, color conversion) across cores.  threadpool_run()
+ * calls fn on disjoint [start, end) sub-ranges of [0, count) from the
+ * worker threads and the calling thread, and returns once all of them
+ * are done.
+ */
+
+struct threadpool;
+
+typedef void (*threadpool_fn)(void *arg, unsigned start, unsigned end);
+
+/* threads == 0 picks one thread per online CPU */
+struct threadpool * threadpool_create(unsigned threads);
+void threadpool_destroy(struct threadpool *pool);
+unsigned threadpool_size(const struct threadpool *pool);
+void threadpool_run(struct threadpool *pool, threadpool_fn fn, void *arg,
+					unsigned count);
+
+#endif /* _THREADPOOL_H */
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "trace.h"
+
+#define TRACE_CHUNK_EVENTS 4096
+
+struct trace_event {
+	int64_t ts;
+	const char *name;
+	int64_t arg;
+	char phase;
+};
+
+struct trace_chunk {
+	struct trace_chunk *next;
+	unsigned count;
+	struct trace_event events[TRACE_CHUNK_EVENTS];
+};
+
+/* One per thread that recorded something.  Only the owning thread
+ * appends; the count and chunk links are published with release stores
+ * so trace_flush() can walk them from another thread.
+ */
+struct trace_thread {
+	struct trace_thread *next;
+	pid_t tid;
+	const char *name;
+	struct trace_chunk *head, *tail;
+};
+
+bool trace_enabled;
+
+static const char *trace_filename;
+static struct trace_thread *threads;
+static __thread struct trace_thread *self;
+
+static struct trace_thread *trace_self(void)
+{
+	struct trace_thread *t = self;
+
+	if (t)
+		return t;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+
+	t->tid = syscall(SYS_gettid);
+	t->head = t->tail = calloc(1, sizeof(*t->head));
+	if (!t->head) {
+		free(t);
+		return NULL;
+	}
+
+	/* lock-free push onto the global list: */
+	t->next = __atomic_load_n(&threads, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&threads, &t->next, t, true,
+										__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+
+	self = t;
+	return t;
+}
+
+void trace_thread_name(const char *name)
+{
+	struct trace_thread *t;
+
+	if (!trace_is_enabled())
+		return;
+
+	t = trace_self();
+	if (t && !t->name)
+		__atomic_store_n(&t->name, name, __ATOMIC_RELEASE);
+}
+
+void trace_event_slow(const char *name, char phase, int64_t arg)
+{
+	struct trace_thread *t = trace_self();
+	struct trace_chunk *c;
+	struct trace_event *ev;
+
+	if (!t)
+		return;
+
+	c = t->tail;
+	if (c->count == TRACE_CHUNK_EVENTS) {
+		struct trace_chunk *next = calloc(1, sizeof(*next));
+		if (!next)
+			return;
+		__atomic_store_n(&c->next, next, __ATOMIC_RELEASE);
+		t->tail = c = next;
+	}
+
+	ev = &c->events[c->count];
+	ev->ts = get_time_ns();
+	ev->name = name;
+	ev->arg = arg;
+	ev->phase = phase;
+	__atomic_store_n(&c->count, c->count + 1, __ATOMIC_RELEASE);
+}
+
+static void trace_flush(void)
+{
+	struct trace_thread *t;
+	bool first = true;
+	pid_t pid = getpid();
+	FILE *f;
+
+	/* stop recording, threads still running just drop their events: */
+	__atomic_store_n(&trace_enabled, false, __ATOMIC_RELEASE);
+
+	f = fopen(trace_filename, "w");
+	if (!f) {
+		printf("could not write trace to %s\n", trace_filename);
+		return;
+	}
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	for (t = __atomic_load_n(&threads, __ATOMIC_ACQUIRE); t; t = t->next) {
+		const char *name = __atomic_load_n(&t->name, __ATOMIC_ACQUIRE);
+		struct trace_chunk *c;
+
+		if (name) {
+			fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+					"\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+					first ? "" : ",", pid, t->tid, name);
+			first = false;
+		}
+
+		for (c = t->head; c; c = __atomic_load_n(&c->next, __ATOMIC_ACQUIRE)) {
+			unsigned i, count = __atomic_load_n(&c->count, __ATOMIC_ACQUIRE);
+
+			for (i = 0; i < count; i++) {
+				const struct trace_event *ev = &c->events[i];
+
+				fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+						"\"pid\":%d,\"tid\":%d",
+						first ? "" : ",", ev->name, ev->phase,
+						ev->ts / 1000.0, pid, t->tid);
+				if (ev->phase == 'i')
+					fprintf(f, ",\"s\":\"t\"");
+				if (ev->arg != TRACE_NO_ARG)
+					fprintf(f, ",\"args\":{\"value\":%lld}", (long long)ev->arg);
+				fprintf(f, "}");
+				first = false;
+			}
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+	fclose(f);
+
+	printf("wrote trace to %s\n", trace_filename);
+}
+
+int trace_init(const char *filename)
+{
+	trace_filename = filename;
+	__atomic_store_n(&trace_enabled, true, __ATOMIC_RELEASE);
+
+	if (atexit(trace_flush)) {
+		__atomic_store_n(&trace_enabled, false, __ATOMIC_RELEASE);
+		return -1;
+	}
+
+	trace_thread_name("render");
+
+	return 0;
+}
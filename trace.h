@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Chrome trace-event JSON export of the frame pipeline (--trace=FILE),
+ * loadable in chrome://tracing or ui.perfetto.dev.
+ *
+ * Events are appended to a buffer owned by the calling thread (no locks
+ * on the recording side) and written out at exit.  Event names must be
+ * string literals, only the pointer is recorded.
+ */
+
+extern bool trace_enabled;
+
+int trace_init(const char *filename);
+void trace_thread_name(const char *name);
+void trace_event_slow(const char *name, char phase, int64_t arg);
+
+#define TRACE_NO_ARG INT64_MIN
+
+/* Read by the decoder, writeback and camera threads while trace_flush()
+ * clears it at exit, so always go through atomics:
+ */
+static inline bool trace_is_enabled(void)
+{
+	return __atomic_load_n(&trace_enabled, __ATOMIC_ACQUIRE);
+}
+
+static inline void trace_begin(const char *name)
+{
+	if (trace_is_enabled())
+		trace_event_slow(name, 'B', TRACE_NO_ARG);
+}
+
+static inline void trace_end(const char *name)
+{
+	if (trace_is_enabled())
+		trace_event_slow(name, 'E', TRACE_NO_ARG);
+}
+
+static inline void trace_instant(const char *name, int64_t arg)
+{
+	if (trace_is_enabled())
+		trace_event_slow(name, 'i', arg);
+}
+
+#endif /* _TRACE_H */
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "common.h"
+#include "drm-common.h"
+#include "trace.h"
+#include "writeback.h"
+
+#ifndef DRM_CLIENT_CAP_WRITEBACK_CONNECTORS
+#define DRM_CLIENT_CAP_WRITEBACK_CONNECTORS 5
+#endif
+
+#ifndef DRM_MODE_CONNECTOR_WRITEBACK
+#define DRM_MODE_CONNECTOR_WRITEBACK 18
+#endif
+
+#define VOID2U64(x) ((uint64_t)(unsigned long)(x))
+
+/* a job completes at the vblank after its commit, three buffers leave
+ * the writer a couple of frames to keep up:
+ */
+#define NUM_WRITEBACK_BUFFERS 3
+
+enum job_state {
+	JOB_FREE,
+	JOB_PENDING,         /* committed, out-fence not signaled yet */
+	JOB_QUEUED,          /* written back, waiting for the writer */
+	JOB_DONE,            /* writer is finished with the buffer */
+};
+
+struct writeback_job {
+	enum job_state state;
+	unsigned frame;
+	struct drm_dumb *dumb;
+	int32_t fence_fd;    /* filled in through WRITEBACK_OUT_FENCE_PTR */
+};
+
+bool writeback_enabled;
+
+static struct {
+	int fd;
+	uint32_t crtc_id;
+	uint32_t connector_id;
+	struct connector connector;
+
+	unsigned interval;
+	const char *dir;
+
+	struct writeback_job jobs[NUM_WRITEBACK_BUFFERS];
+	struct writeback_job *job;  /* in the commit being built */
+	unsigned next;       /* buffer the next job writes into */
+	unsigned retire;     /* oldest pending job */
+	unsigned pending;    /* jobs in flight, from 'retire' on */
+	unsigned work;       /* next job for the writer */
+	unsigned commits;
+
+	/* job state is shared with the writer once queued: */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool quit;
+
+	/* stats, for finish_writeback(): */
+	unsigned frames, dropped;
+} wb;
+
+static int find_property(const char *name)
+{
+	unsigned i;
+
+	for (i = 0; i < wb.connector.props->count_props; i++)
+		if (strcmp(wb.connector.props_info[i]->name, name) == 0)
+			return i;
+
+	printf("no writeback connector property: %s\n", name);
+	return -1;
+}
+
+static int add_property(drmModeAtomicReq *req, const char *name, uint64_t value)
+{
+	int idx = find_property(name);
+
+	if (idx < 0)
+		return -EINVAL;
+
+	return drmModeAtomicAddProperty(req, wb.connector_id,
+			wb.connector.props_info[idx]->prop_id, value);
+}
+
+/* a writeback connector that can be fed from the CRTC being driven: */
+static uint32_t find_writeback_connector(const struct drm *drm)
+{
+	drmModeRes *resources;
+	uint32_t connector_id = 0;
+	int i, j;
+
+	resources = drmModeGetResources(drm->fd);
+	if (!resources)
+		return 0;
+
+	for (i = 0; i < resources->count_connectors && !connector_id; i++) {
+		drmModeConnector *connector =
+			drmModeGetConnectorCurrent(drm->fd, resources->connectors[i]);
+
+		if (!connector)
+			continue;
+
+		for (j = 0; j < connector->count_encoders &&
+				connector->connector_type == DRM_MODE_CONNECTOR_WRITEBACK; j++) {
+			drmModeEncoder *encoder =
+				drmModeGetEncoder(drm->fd, connector->encoders[j]);
+
+			if (!encoder)
+				continue;
+
+			if (encoder->possible_crtcs & (1 << drm->crtc_index))
+				connector_id = connector->connector_id;
+
+			drmModeFreeEncoder(encoder);
+		}
+
+		drmModeFreeConnector(connector);
+	}
+
+	drmModeFreeResources(resources);
+
+	return connector_id;
+}
+
+static bool supports_xrgb8888(void)
+{
+	drmModePropertyBlobPtr blob;
+	const uint32_t *formats;
+	bool found = false;
+	unsigned i;
+	int idx;
+
+	idx = find_property("WRITEBACK_PIXEL_FORMATS");
+	if (idx < 0)
+		return false;
+
+	blob = drmModeGetPropertyBlob(wb.fd, wb.connector.props->prop_values[idx]);
+	if (!blob)
+		return false;
+
+	formats = blob->data;
+	for (i = 0; i < blob->length / sizeof(*formats); i++)
+		if (formats[i] == DRM_FORMAT_XRGB8888)
+			found = true;
+
+	drmModeFreePropertyBlob(blob);
+
+	return found;
+}
+
+/* XRGB8888 is B, G, R, X in memory: */
+static void writeback_write(const struct writeback_job *job)
+{
+	static const int rgb[3] = { 2, 1, 0 };
+	char path[PATH_MAX];
+	uint64_t hash;
+
+	if (wb.dir)
+		snprintf(path, sizeof(path), "%s/writeback-%06u.ppm", wb.dir, job->frame);
+
+	hash = write_frame(wb.dir ? path : NULL, job->dumb->map,
+					   job->dumb->width, job->dumb->height,
+					   job->dumb->pitch, rgb);
+
+	printf("writeback: frame %u hash %016" PRIx64 "\n", job->frame, hash);
+}
+
+static void *writer(void *arg)
+{
+	(void)arg;
+
+	trace_thread_name("writeback");
+
+	pthread_mutex_lock(&wb.lock);
+	for (;;) {
+		struct writeback_job *job = &wb.jobs[wb.work];
+
+		if (job->state == JOB_QUEUED) {
+			pthread_mutex_unlock(&wb.lock);
+
+			trace_begin("write frame");
+			writeback_write(job);
+			trace_end("write frame");
+
+			pthread_mutex_lock(&wb.lock);
+			job->state = JOB_DONE;
+			wb.work = (wb.work + 1) % NUM_WRITEBACK_BUFFERS;
+			pthread_cond_broadcast(&wb.cond);
+			continue;
+		}
+
+		/* queued jobs are still written after quit: */
+		if (wb.quit)
+			break;
+
+		pthread_cond_wait(&wb.cond, &wb.lock);
+	}
+	pthread_mutex_unlock(&wb.lock);
+
+	return NULL;
+}
+
+/* Hand completed jobs to the writer, oldest first, waiting for them if
+ * wait is set:
+ */
+static void retire_jobs(bool wait)
+{
+	while (wb.pending) {
+		struct writeback_job *job = &wb.jobs[wb.retire];
+		struct pollfd pfd = {
+			.fd = job->fence_fd,
+			.events = POLLIN,
+		};
+
+		if (job->fence_fd >= 0) {
+			int ret = poll(&pfd, 1, wait ? -1 : 0);
+
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret == 0)
+				break;
+
+			close(job->fence_fd);
+			job->fence_fd = -1;
+		}
+
+		pthread_mutex_lock(&wb.lock);
+		job->state = JOB_QUEUED;
+		pthread_cond_broadcast(&wb.cond);
+		pthread_mutex_unlock(&wb.lock);
+
+		wb.retire = (wb.retire + 1) % NUM_WRITEBACK_BUFFERS;
+		wb.pending--;
+	}
+}
+
+int writeback_add_properties(drmModeAtomicReq *req, bool modeset)
+{
+	struct writeback_job *job = &wb.jobs[wb.next];
+	bool available;
+
+	retire_jobs(false);
+
+	if (modeset && add_property(req, "CRTC_ID", wb.crtc_id) < 0)
+		return -1;
+
+	wb.job = NULL;
+	if (wb.commits++ % wb.interval)
+		return 0;
+
+	/* never hold up the display, skip the frame if the writer is
+	 * behind:
+	 */
+	pthread_mutex_lock(&wb.lock);
+	if (job->state == JOB_DONE)
+		job->state = JOB_FREE;
+	available = job->state == JOB_FREE;
+	pthread_mutex_unlock(&wb.lock);
+
+	if (!available) {
+		wb.dropped++;
+		return 0;
+	}
+
+	job->frame = wb.commits - 1;
+	job->fence_fd = -1;
+
+	if (add_property(req, "WRITEBACK_FB_ID", job->dumb->fb->fb_id) < 0 ||
+	    add_property(req, "WRITEBACK_OUT_FENCE_PTR", VOID2U64(&job->fence_fd)) < 0)
+		return -1;
+
+	wb.job = job;
+
+	return 0;
+}
+
+void writeback_committed(int ret)
+{
+	struct writeback_job *job = wb.job;
+
+	wb.job = NULL;
+	if (!job)
+		return;
+
+	if (ret) {
+		wb.dropped++;
+		return;
+	}
+
+	pthread_mutex_lock(&wb.lock);
+	job->state = JOB_PENDING;
+	pthread_mutex_unlock(&wb.lock);
+
+	wb.pending++;
+	wb.next = (wb.next + 1) % NUM_WRITEBACK_BUFFERS;
+	wb.frames++;
+}
+
+int init_writeback(const struct drm *drm, unsigned interval, const char *dir)
+{
+	unsigned i;
+
+	wb.fd = drm->fd;
+	wb.crtc_id = drm->crtc_id;
+	wb.interval = interval ? interval : 1;
+	wb.dir = dir;
+
+	if (drmSetClientCap(drm->fd, DRM_CLIENT_CAP_WRITEBACK_CONNECTORS, 1)) {
+		printf("no writeback connector support: %s\n", strerror(errno));
+		return -1;
+	}
+
+	wb.connector_id = find_writeback_connector(drm);
+	if (!wb.connector_id) {
+		printf("no writeback connector for crtc %u\n", drm->crtc_id);
+		return -1;
+	}
+
+	wb.connector.props = drmModeObjectGetProperties(drm->fd,
+			wb.connector_id, DRM_MODE_OBJECT_CONNECTOR);
+	if (!wb.connector.props) {
+		printf("could not get writeback connector %u properties: %s\n",
+			   wb.connector_id, strerror(errno));
+		return -1;
+	}
+
+	wb.connector.props_info = calloc(wb.connector.props->count_props,
+									 sizeof(*wb.connector.props_info));
+	if (!wb.connector.props_info) {
+		printf("could not allocate writeback connector properties\n");
+		return -1;
+	}
+	for (i = 0; i < wb.connector.props->count_props; i++)
+		wb.connector.props_info[i] = drmModeGetProperty(drm->fd,
+				wb.connector.props->props[i]);
+
+	if (!supports_xrgb8888()) {
+		printf("writeback connector %u can't write XRGB8888\n",
+			   wb.connector_id);
+		return -1;
+	}
+
+	for (i = 0; i < NUM_WRITEBACK_BUFFERS; i++) {
+		wb.jobs[i].fence_fd = -1;
+		wb.jobs[i].dumb = drm_dumb_create(drm->fd, drm->mode->hdisplay,
+										  drm->mode->vdisplay);
+		if (!wb.jobs[i].dumb)
+			return -1;
+	}
+
+	pthread_mutex_init(&wb.lock, NULL);
+	pthread_cond_init(&wb.cond, NULL);
+	if (pthread_create(&wb.thread, NULL, writer, NULL)) {
+		printf("could not create writeback thread\n");
+		return -1;
+	}
+
+	printf("writing back every %u frame(s) through connector %u%s%s\n",
+		   wb.interval, wb.connector_id, dir ? " to " : "", dir ? dir : "");
+
+	writeback_enabled = true;
+
+	return 0;
+}
+
+void finish_writeback(void)
+{
+	if (!writeback_enabled)
+		return;
+
+	retire_jobs(true);
+
+	pthread_mutex_lock(&wb.lock);
+	wb.quit = true;
+	pthread_cond_broadcast(&wb.cond);
+	pthread_mutex_unlock(&wb.lock);
+	pthread_join(wb.thread, NULL);
+
+	printf("writeback: %u frames, %u skipped\n", wb.frames, wb.dropped);
+
+	writeback_enabled = false;
+}
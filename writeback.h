@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _WRITEBACK_H
+#define _WRITEBACK_H
+
+#include <stdbool.h>
+
+#include <xf86drmMode.h>
+
+struct drm;
+
+/* Capture of the composed display output through a KMS writeback
+ * connector (atomic only).  Every Nth commit also writes the CRTC's
+ * output into one of a few preallocated dumb buffers.  Once a job's
+ * out-fence signals, a background thread hashes the buffer and
+ * optionally writes it out, as --capture does for the GL side.  No GPU
+ * work is involved, so this also works on vkms.
+ */
+
+/* set once init_writeback() succeeds: */
+extern bool writeback_enabled;
+
+/* dir may be NULL to only print hashes */
+int init_writeback(const struct drm *drm, unsigned interval, const char *dir);
+
+/* Add the writeback connector to an atomic commit, and a writeback job
+ * if this commit is to be captured.  The connector is only attached to
+ * the CRTC on the modeset.
+ */
+int writeback_add_properties(drmModeAtomicReq *req, bool modeset);
+
+/* result of the commit the properties were added to: */
+void writeback_committed(int ret);
+
+/* wait for outstanding jobs and print a summary: */
+void finish_writeback(void);
+
+#endif /* _WRITEBACK_H */
@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "threadpool.h"
+#include "yuv.h"
+
+/* On x86 every version is built with target attributes and the best one
+ * the CPU has is picked at runtime, so a default build still gets AVX2.
+ * NEON is part of the ARM target or it isn't.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define YUV_X86 1
+#define TARGET(isa) __attribute__((target(isa)))
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* Fixed point (6 fractional bits) conversion, per pixel:
+ *
+ *   y' = (Y - y_offset) * y
+ *   R = (y' + rv * (V - 128) + 32) >> 6
+ *   G = (y' - gu * (U - 128) - gv * (V - 128) + 32) >> 6
+ *   B = (y' + bu * (U - 128) + 32) >> 6
+ *
+ * which is within 3 of the exact result.  Every product fits in 16 bits,
+ * so the SIMD versions work on 16 bit lanes.  Sums that would overflow
+ * them are far out of [0, 255] either way, so saturating there gives the
+ * same result as the scalar version.
+ */
+struct yuv_coeffs {
+	int16_t y_offset, y;
+	int16_t rv, gu, gv, bu;
+};
+
+/* one row of the source, pixel x is y[x * y_step], u[x / 2 * c_step]
+ * and v[x / 2 * c_step]:
+ */
+struct yuv_row {
+	const uint8_t *y, *u, *v;
+	unsigned y_step, c_step;
+};
+
+typedef unsigned (*convert_simd_fn)(const struct yuv_row *row,
+								   enum yuv_format format,
+								   const struct yuv_coeffs *c,
+								   uint32_t *dst, unsigned width);
+
+struct yuv_job {
+	const struct yuv_image *src;
+	convert_simd_fn convert;	/* NULL for scalar only */
+	struct yuv_coeffs coeffs;
+	uint8_t *dst;
+	unsigned dst_stride;
+};
+
+static void get_coeffs(enum yuv_matrix matrix, enum yuv_range range,
+					   struct yuv_coeffs *c)
+{
+	/* luma weights of red and blue: */
+	static const float weights[][2] = {
+		[YUV_BT601]  = { 0.299f,  0.114f  },
+		[YUV_BT709]  = { 0.2126f, 0.0722f },
+		[YUV_BT2020] = { 0.2627f, 0.0593f },
+	};
+	float kr = weights[matrix][0], kb = weights[matrix][1];
+	float kg = 1.0f - kr - kb;
+	float ys = range == YUV_FULL ? 1.0f : 255.0f / 219.0f;
+	float cs = range == YUV_FULL ? 1.0f : 255.0f / 224.0f;
+
+	c->y_offset = range == YUV_FULL ? 0 : 16;
+	c->y = lroundf(64.0f * ys);
+	c->rv = lroundf(64.0f * cs * 2.0f * (1.0f - kr));
+	c->gu = lroundf(64.0f * cs * 2.0f * kb * (1.0f - kb) / kg);
+	c->gv = lroundf(64.0f * cs * 2.0f * kr * (1.0f - kr) / kg);
+	c->bu = lroundf(64.0f * cs * 2.0f * (1.0f - kb));
+}
+
+static void get_row(const struct yuv_image *src, unsigned i, struct yuv_row *row)
+{
+	const uint8_t *y = src->planes[0] + i * src->strides[0];
+
+	switch (src->format) {
+	case YUV_NV12:
+		row->y = y;
+		row->u = src->planes[1] + i / 2 * src->strides[1];
+		row->v = row->u + 1;
+		row->y_step = 1;
+		row->c_step = 2;
+		break;
+	case YUV_I420:
+		row->y = y;
+		row->u = src->planes[1] + i / 2 * src->strides[1];
+		row->v = src->planes[2] + i / 2 * src->strides[2];
+		row->y_step = 1;
+		row->c_step = 1;
+		break;
+	case YUV_YUYV:
+	default:
+		row->y = y;
+		row->u = y + 1;
+		row->v = y + 3;
+		row->y_step = 2;
+		row->c_step = 4;
+		break;
+	}
+}
+
+static inline uint32_t clamp8(int v)
+{
+	return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+static void convert_scalar(const struct yuv_row *row,
+						   const struct yuv_coeffs *c,
+						   uint32_t *dst, unsigned x, unsigned width)
+{
+	for (; x < width; x++) {
+		int y = (row->y[x * row->y_step] - c->y_offset) * c->y;
+		int u = row->u[x / 2 * row->c_step] - 128;
+		int v = row->v[x / 2 * row->c_step] - 128;
+
+		dst[x] = 0xff000000 |
+				 clamp8((y + c->rv * v + 32) >> 6) << 16 |
+				 clamp8((y - c->gu * u - c->gv * v + 32) >> 6) << 8 |
+				 clamp8((y + c->bu * u + 32) >> 6);
+	}
+}
+
+#ifdef YUV_X86
+/* u and v replicated to each pixel, from 16 bit u0 v0 u1 v1 ... lanes: */
+static inline TARGET("avx2") void
+split_uv_avx2(__m256i uv, __m256i *u, __m256i *v)
+{
+	*u = _mm256_and_si256(uv, _mm256_set1_epi32(0xffff));
+	*u = _mm256_or_si256(*u, _mm256_slli_epi32(*u, 16));
+	*v = _mm256_srli_epi32(uv, 16);
+	*v = _mm256_or_si256(*v, _mm256_slli_epi32(*v, 16));
+}
+
+static inline TARGET("avx2") void
+load_avx2(const struct yuv_row *row, enum yuv_format format,
+		  unsigned x, __m256i *y, __m256i *u, __m256i *v)
+{
+	__m256i yuyv;
+	__m128i c;
+
+	switch (format) {
+	case YUV_NV12:
+		*y = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)&row->y[x]));
+		split_uv_avx2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)&row->u[x])), u, v);
+		break;
+	case YUV_I420:
+		*y = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)&row->y[x]));
+		c = _mm_loadl_epi64((const __m128i *)&row->u[x / 2]);
+		*u = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(c, c));
+		c = _mm_loadl_epi64((const __m128i *)&row->v[x / 2]);
+		*v = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(c, c));
+		break;
+	case YUV_YUYV:
+	default:
+		yuyv = _mm256_loadu_si256((const __m256i *)&row->y[x * 2]);
+		*y = _mm256_and_si256(yuyv, _mm256_set1_epi16(0xff));
+		split_uv_avx2(_mm256_srli_epi16(yuyv, 8), u, v);
+		break;
+	}
+}
+
+static inline TARGET("avx2") __m256i descale_avx2(__m256i v)
+{
+	return _mm256_srai_epi16(_mm256_adds_epi16(v, _mm256_set1_epi16(32)), 6);
+}
+
+static TARGET("avx2") unsigned
+convert_avx2(const struct yuv_row *row, enum yuv_format format,
+			 const struct yuv_coeffs *c, uint32_t *dst, unsigned width)
+{
+	const __m256i y_offset = _mm256_set1_epi16(c->y_offset);
+	const __m256i cy = _mm256_set1_epi16(c->y);
+	const __m256i rv = _mm256_set1_epi16(c->rv), gu = _mm256_set1_epi16(c->gu);
+	const __m256i gv = _mm256_set1_epi16(c->gv), bu = _mm256_set1_epi16(c->bu);
+	const __m256i half = _mm256_set1_epi16(128);
+	const __m256i opaque = _mm256_set1_epi8(-1);
+	unsigned x;
+
+	for (x = 0; x + 16 <= width; x += 16) {
+		__m256i y, u, v, r, g, b, bg, ra, lo, hi;
+
+		load_avx2(row, format, x, &y, &u, &v);
+
+		y = _mm256_mullo_epi16(_mm256_sub_epi16(y, y_offset), cy);
+		u = _mm256_sub_epi16(u, half);
+		v = _mm256_sub_epi16(v, half);
+
+		r = descale_avx2(_mm256_adds_epi16(y, _mm256_mullo_epi16(v, rv)));
+		g = descale_avx2(_mm256_subs_epi16(_mm256_subs_epi16(y,
+				_mm256_mullo_epi16(u, gu)), _mm256_mullo_epi16(v, gv)));
+		b = descale_avx2(_mm256_adds_epi16(y, _mm256_mullo_epi16(u, bu)));
+
+		/* packing works within 128 bit halves, pixels 0-3 and 8-11
+		 * end up in lo, 4-7 and 12-15 in hi:
+		 */
+		r = _mm256_packus_epi16(r, r);
+		g = _mm256_packus_epi16(g, g);
+		b = _mm256_packus_epi16(b, b);
+		bg = _mm256_unpacklo_epi8(b, g);
+		ra = _mm256_unpacklo_epi8(r, opaque);
+		lo = _mm256_unpacklo_epi16(bg, ra);
+		hi = _mm256_unpackhi_epi16(bg, ra);
+
+		_mm256_storeu_si256((__m256i *)&dst[x],
+							_mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)&dst[x + 8],
+							_mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	return x;
+}
+
+static inline TARGET("sse2") void
+split_uv_sse2(__m128i uv, __m128i *u, __m128i *v)
+{
+	*u = _mm_and_si128(uv, _mm_set1_epi32(0xffff));
+	*u = _mm_or_si128(*u, _mm_slli_epi32(*u, 16));
+	*v = _mm_srli_epi32(uv, 16);
+	*v = _mm_or_si128(*v, _mm_slli_epi32(*v, 16));
+}
+
+static inline TARGET("sse2") void
+load_sse2(const struct yuv_row *row, enum yuv_format format,
+		  unsigned x, __m128i *y, __m128i *u, __m128i *v)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i yuyv, c;
+	int32_t c4;
+
+	switch (format) {
+	case YUV_NV12:
+		*y = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)&row->y[x]), zero);
+		split_uv_sse2(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)&row->u[x]), zero), u, v);
+		break;
+	case YUV_I420:
+		*y = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)&row->y[x]), zero);
+		memcpy(&c4, &row->u[x / 2], sizeof(c4));
+		c = _mm_cvtsi32_si128(c4);
+		*u = _mm_unpacklo_epi8(_mm_unpacklo_epi8(c, c), zero);
+		memcpy(&c4, &row->v[x / 2], sizeof(c4));
+		c = _mm_cvtsi32_si128(c4);
+		*v = _mm_unpacklo_epi8(_mm_unpacklo_epi8(c, c), zero);
+		break;
+	case YUV_YUYV:
+	default:
+		yuyv = _mm_loadu_si128((const __m128i *)&row->y[x * 2]);
+		*y = _mm_and_si128(yuyv, _mm_set1_epi16(0xff));
+		split_uv_sse2(_mm_srli_epi16(yuyv, 8), u, v);
+		break;
+	}
+}
+
+/* SSE4.1 (with SSSE3's pshufb) widens and replicates in one shuffle
+ * instead of SSE2's unpack/shift/or sequences:
+ */
+#define Z -1	/* pshufb: zero this byte */
+
+static inline TARGET("sse4.1") void
+load_sse41(const struct yuv_row *row, enum yuv_format format,
+		   unsigned x, __m128i *y, __m128i *u, __m128i *v)
+{
+	__m128i yuyv, c;
+	int32_t c4;
+
+	switch (format) {
+	case YUV_NV12:
+		*y = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)&row->y[x]));
+		c = _mm_loadl_epi64((const __m128i *)&row->u[x]);
+		*u = _mm_shuffle_epi8(c, _mm_setr_epi8(0, Z, 0, Z, 2, Z, 2, Z,
+				4, Z, 4, Z, 6, Z, 6, Z));
+		*v = _mm_shuffle_epi8(c, _mm_setr_epi8(1, Z, 1, Z, 3, Z, 3, Z,
+				5, Z, 5, Z, 7, Z, 7, Z));
+		break;
+	case YUV_I420:
+		*y = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)&row->y[x]));
+		memcpy(&c4, &row->u[x / 2], sizeof(c4));
+		*u = _mm_shuffle_epi8(_mm_cvtsi32_si128(c4), _mm_setr_epi8(
+				0, Z, 0, Z, 1, Z, 1, Z, 2, Z, 2, Z, 3, Z, 3, Z));
+		memcpy(&c4, &row->v[x / 2], sizeof(c4));
+		*v = _mm_shuffle_epi8(_mm_cvtsi32_si128(c4), _mm_setr_epi8(
+				0, Z, 0, Z, 1, Z, 1, Z, 2, Z, 2, Z, 3, Z, 3, Z));
+		break;
+	case YUV_YUYV:
+	default:
+		yuyv = _mm_loadu_si128((const __m128i *)&row->y[x * 2]);
+		*y = _mm_shuffle_epi8(yuyv, _mm_setr_epi8(0, Z, 2, Z, 4, Z, 6, Z,
+				8, Z, 10, Z, 12, Z, 14, Z));
+		*u = _mm_shuffle_epi8(yuyv, _mm_setr_epi8(1, Z, 1, Z, 5, Z, 5, Z,
+				9, Z, 9, Z, 13, Z, 13, Z));
+		*v = _mm_shuffle_epi8(yuyv, _mm_setr_epi8(3, Z, 3, Z, 7, Z, 7, Z,
+				11, Z, 11, Z, 15, Z, 15, Z));
+		break;
+	}
+}
+
+#undef Z
+
+static inline TARGET("sse2") __m128i descale_sse2(__m128i v)
+{
+	return _mm_srai_epi16(_mm_adds_epi16(v, _mm_set1_epi16(32)), 6);
+}
+
+/* Shared by the SSE2 and SSE4.1 versions, which differ in load only: */
+static inline __attribute__((always_inline)) TARGET("sse2") unsigned
+convert_128(const struct yuv_row *row, enum yuv_format format,
+			const struct yuv_coeffs *c, uint32_t *dst, unsigned width,
+			bool sse41)
+{
+	const __m128i y_offset = _mm_set1_epi16(c->y_offset);
+	const __m128i cy = _mm_set1_epi16(c->y);
+	const __m128i rv = _mm_set1_epi16(c->rv), gu = _mm_set1_epi16(c->gu);
+	const __m128i gv = _mm_set1_epi16(c->gv), bu = _mm_set1_epi16(c->bu);
+	const __m128i half = _mm_set1_epi16(128);
+	const __m128i opaque = _mm_set1_epi8(-1);
+	unsigned x;
+
+	for (x = 0; x + 8 <= width; x += 8) {
+		__m128i y, u, v, r, g, b, bg, ra;
+
+		if (sse41)
+			load_sse41(row, format, x, &y, &u, &v);
+		else
+			load_sse2(row, format, x, &y, &u, &v);
+
+		y = _mm_mullo_epi16(_mm_sub_epi16(y, y_offset), cy);
+		u = _mm_sub_epi16(u, half);
+		v = _mm_sub_epi16(v, half);
+
+		r = descale_sse2(_mm_adds_epi16(y, _mm_mullo_epi16(v, rv)));
+		g = descale_sse2(_mm_subs_epi16(_mm_subs_epi16(y,
+				_mm_mullo_epi16(u, gu)), _mm_mullo_epi16(v, gv)));
+		b = descale_sse2(_mm_adds_epi16(y, _mm_mullo_epi16(u, bu)));
+
+		r = _mm_packus_epi16(r, r);
+		g = _mm_packus_epi16(g, g);
+		b = _mm_packus_epi16(b, b);
+		bg = _mm_unpacklo_epi8(b, g);
+		ra = _mm_unpacklo_epi8(r, opaque);
+
+		_mm_storeu_si128((__m128i *)&dst[x], _mm_unpacklo_epi16(bg, ra));
+		_mm_storeu_si128((__m128i *)&dst[x + 4], _mm_unpackhi_epi16(bg, ra));
+	}
+
+	return x;
+}
+
+static TARGET("sse4.1") unsigned
+convert_sse41(const struct yuv_row *row, enum yuv_format format,
+			  const struct yuv_coeffs *c, uint32_t *dst, unsigned width)
+{
+	return convert_128(row, format, c, dst, width, true);
+}
+
+static TARGET("sse2") unsigned
+convert_sse2(const struct yuv_row *row, enum yuv_format format,
+			 const struct yuv_coeffs *c, uint32_t *dst, unsigned width)
+{
+	return convert_128(row, format, c, dst, width, false);
+}
+#elif defined(__ARM_NEON)
+
+static inline void split_uv(int16x8_t uv, int16x8_t *u, int16x8_t *v)
+{
+	uint32x4_t c = vreinterpretq_u32_s16(uv);
+	uint32x4_t cu = vandq_u32(c, vdupq_n_u32(0xffff));
+	uint32x4_t cv = vshrq_n_u32(c, 16);
+
+	*u = vreinterpretq_s16_u32(vorrq_u32(cu, vshlq_n_u32(cu, 16)));
+	*v = vreinterpretq_s16_u32(vorrq_u32(cv, vshlq_n_u32(cv, 16)));
+}
+
+static inline void load(const struct yuv_row *row, enum yuv_format format,
+						unsigned x, int16x8_t *y, int16x8_t *u, int16x8_t *v)
+{
+	uint16x8_t yuyv;
+	uint8x8_t c;
+	uint32_t c4;
+
+	switch (format) {
+	case YUV_NV12:
+		*y = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&row->y[x])));
+		split_uv(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&row->u[x]))), u, v);
+		break;
+	case YUV_I420:
+		*y = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&row->y[x])));
+		memcpy(&c4, &row->u[x / 2], sizeof(c4));
+		c = vreinterpret_u8_u32(vdup_n_u32(c4));
+		*u = vreinterpretq_s16_u16(vmovl_u8(vzip_u8(c, c).val[0]));
+		memcpy(&c4, &row->v[x / 2], sizeof(c4));
+		c = vreinterpret_u8_u32(vdup_n_u32(c4));
+		*v = vreinterpretq_s16_u16(vmovl_u8(vzip_u8(c, c).val[0]));
+		break;
+	case YUV_YUYV:
+	default:
+		yuyv = vreinterpretq_u16_u8(vld1q_u8(&row->y[x * 2]));
+		*y = vreinterpretq_s16_u16(vandq_u16(yuyv, vdupq_n_u16(0xff)));
+		split_uv(vreinterpretq_s16_u16(vshrq_n_u16(yuyv, 8)), u, v);
+		break;
+	}
+}
+
+static inline uint8x8_t descale(int16x8_t v)
+{
+	return vqmovun_s16(vshrq_n_s16(vqaddq_s16(v, vdupq_n_s16(32)), 6));
+}
+
+static unsigned convert_neon(const struct yuv_row *row,
+							 enum yuv_format format,
+							 const struct yuv_coeffs *c,
+							 uint32_t *dst, unsigned width)
+{
+	const int16x8_t y_offset = vdupq_n_s16(c->y_offset);
+	const int16x8_t half = vdupq_n_s16(128);
+	unsigned x;
+
+	for (x = 0; x + 8 <= width; x += 8) {
+		int16x8_t y, u, v;
+		uint8x8x4_t bgra;
+
+		load(row, format, x, &y, &u, &v);
+
+		y = vmulq_n_s16(vsubq_s16(y, y_offset), c->y);
+		u = vsubq_s16(u, half);
+		v = vsubq_s16(v, half);
+
+		bgra.val[0] = descale(vqaddq_s16(y, vmulq_n_s16(u, c->bu)));
+		bgra.val[1] = descale(vqsubq_s16(vqsubq_s16(y, vmulq_n_s16(u, c->gu)),
+										 vmulq_n_s16(v, c->gv)));
+		bgra.val[2] = descale(vqaddq_s16(y, vmulq_n_s16(v, c->rv)));
+		bgra.val[3] = vdup_n_u8(0xff);
+
+		vst4_u8((uint8_t *)&dst[x], bgra);
+	}
+
+	return x;
+}
+#endif
+
+struct yuv_simd {
+	const char *name;
+	convert_simd_fn convert;
+};
+
+static const struct yuv_simd *simd;	/* best one supported, if any */
+static bool use_simd = true;
+static pthread_once_t simd_once = PTHREAD_ONCE_INIT;
+
+static void select_simd(void)
+{
+#if defined(YUV_X86)
+	static const struct yuv_simd avx2 = { "avx2", convert_avx2 };
+	static const struct yuv_simd sse41 = { "sse4.1", convert_sse41 };
+	static const struct yuv_simd sse2 = { "sse2", convert_sse2 };
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		simd = &avx2;
+	else if (__builtin_cpu_supports("sse4.1"))
+		simd = &sse41;
+	else if (__builtin_cpu_supports("sse2"))
+		simd = &sse2;
+#elif defined(__ARM_NEON)
+	static const struct yuv_simd neon = { "neon", convert_neon };
+
+	simd = &neon;
+#endif
+}
+
+static const struct yuv_simd *get_simd(void)
+{
+	pthread_once(&simd_once, select_simd);
+	return use_simd ? simd : NULL;
+}
+
+static void convert_rows(void *arg, unsigned start, unsigned end)
+{
+	const struct yuv_job *job = arg;
+	const struct yuv_image *src = job->src;
+	unsigned i;
+
+	for (i = start; i < end; i++) {
+		uint32_t *dst = (uint32_t *)(job->dst + i * job->dst_stride);
+		struct yuv_row row;
+		unsigned x = 0;
+
+		get_row(src, i, &row);
+		if (job->convert)
+			x = job->convert(&row, src->format, &job->coeffs, dst, src->width);
+		convert_scalar(&row, &job->coeffs, dst, x, src->width);
+	}
+}
+
+void yuv_to_xrgb(const struct yuv_image *src, enum yuv_matrix matrix,
+				 enum yuv_range range, uint8_t *dst, unsigned dst_stride,
+				 struct threadpool *pool)
+{
+	const struct yuv_simd *impl = get_simd();
+	struct yuv_job job = {
+		.src = src,
+		.convert = impl ? impl->convert : NULL,
+		.dst = dst,
+		.dst_stride = dst_stride,
+	};
+
+	get_coeffs(matrix, range, &job.coeffs);
+
+	if (pool)
+		threadpool_run(pool, convert_rows, &job, src->height);
+	else
+		convert_rows(&job, 0, src->height);
+}
+
+bool yuv_set_simd(bool enable)
+{
+	use_simd = enable;
+	return get_simd() != NULL;
+}
+
+const char *yuv_simd_name(void)
+{
+	const struct yuv_simd *impl = get_simd();
+
+	return impl ? impl->name : "scalar";
+}
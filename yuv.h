@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _YUV_H
+#define _YUV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* CPU YUV to XRGB8888 conversion, for the software renderer and anywhere
+ * else a frame can't be handed to the GPU as is.
+ *
+ * Integer math with 6 fractional bits, vectorized with AVX2, SSE4.1 or
+ * SSE2 picked by what the CPU supports at runtime, or NEON when building
+ * for it (see yuv_set_simd()), with a scalar version for everything else.
+ * Chroma is upsampled by replication.
+ */
+
+enum yuv_format {
+	YUV_NV12,       /* Y plane, interleaved UV plane, 2x2 subsampled */
+	YUV_I420,       /* Y, U and V planes, 2x2 subsampled */
+	YUV_YUYV,       /* packed Y0 U Y1 V, 2x1 subsampled */
+};
+
+enum yuv_matrix {
+	YUV_BT601,
+	YUV_BT709,
+	YUV_BT2020,
+};
+
+enum yuv_range {
+	YUV_LIMITED,    /* Y in [16, 235], UV in [16, 240] */
+	YUV_FULL,
+};
+
+struct yuv_image {
+	enum yuv_format format;
+	unsigned width, height;
+	const uint8_t *planes[3];
+	unsigned strides[3];
+};
+
+struct threadpool;
+
+/* Rows are split across pool if it is not NULL.  dst_stride is in bytes. */
+void yuv_to_xrgb(const struct yuv_image *src, enum yuv_matrix matrix,
+				 enum yuv_range range, uint8_t *dst, unsigned dst_stride,
+				 struct threadpool *pool);
+
+/* Select the SIMD (default) or scalar version; returns whether SIMD is
+ * now used, which it can't be if neither the build nor the CPU has it.
+ */
+bool yuv_set_simd(bool enable);
+const char *yuv_simd_name(void);
+
+#endif /* _YUV_H */